@@ -0,0 +1,187 @@
+#include "GreenhouseSim.h"
+
+// Volumetric heat capacity of air, J/m3/C
+#define AIR_HEAT_CAPACITY 1206.0
+// Latent heat of vaporisation, J/g
+#define LATENT_HEAT 2450.0
+
+// Inside light per W/m2 of sunlight outside, and the TSL2591 counts per lux at medium gain and
+// 300ms integration with the IR share of daylight
+#define LUX_PER_W_M2 90.0
+#define TSL_COUNTS_PER_LUX 37.6
+#define TSL_IR_SHARE 0.3
+
+// The DS18B20 probes sit lower down than the DHT22 and read a little cooler
+#define PROBE_OFFSET_C (-0.5)
+
+GreenhouseSim::GreenhouseSim(const SimParams &params, const SimWeather &weather, const SimPins &pins)
+	: _params(params), _weather(weather), _pins(pins) {
+	_last_us = NativeHal::now_us();
+
+	// Start at equilibrium with the night outside
+	_outside_c = outside_c(_last_us / 1e6);
+	_temp_c = _outside_c + 2;
+	_water = saturation_water(_weather.outside_dew_point_c);
+
+	_publish_sensors();
+}
+
+void GreenhouseSim::set_band(float target_f, float min_f, float max_f, float target_humidity) {
+	_target_f = target_f;
+	_min_f = min_f;
+	_max_f = max_f;
+	_target_humidity = target_humidity;
+}
+
+float GreenhouseSim::saturation_water(float temp_c) {
+	// Magnus formula for vapour pressure (hPa), then to g/m3
+	float pressure = 6.112 * exp(17.62 * temp_c / (243.12 + temp_c));
+	return 216.7 * pressure / (temp_c + 273.15);
+}
+
+float GreenhouseSim::humidity() const {
+	return std::min(100.0f, 100 * _water / saturation_water(_temp_c));
+}
+
+float GreenhouseSim::outside_c(double t_s) const {
+	// Coldest just before sunrise, warmest mid afternoon
+	double hours = fmod(t_s / 3600, 24);
+	double phase = (hours - _weather.sunrise_hour - 9) / 24 * 2 * M_PI;
+	return _weather.outside_mean_c + _weather.outside_swing_c * cos(phase);
+}
+
+float GreenhouseSim::_cloud_cover(double t_s) const {
+	// Cloud cover changes hourly; hash the hour so a run is repeatable for a given seed
+	uint32_t hour = (uint32_t) (t_s / 3600);
+	uint32_t x = (hour + 1) * 2654435761u ^ _weather.seed * 40503u;
+	x ^= x >> 15;
+	x *= 2246822519u;
+	x ^= x >> 13;
+	float random = (x & 0xFFFF) / 65535.0f;
+
+	return std::min(1.0f, random * 2 * _weather.cloudiness);
+}
+
+float GreenhouseSim::solar(double t_s) const {
+	double hours = fmod(t_s / 3600, 24) - _weather.sunrise_hour;
+	if (hours < 0 || hours > _weather.day_length_h) {
+		return 0;
+	}
+
+	float clear = _weather.peak_solar * sin(M_PI * hours / _weather.day_length_h);
+	return clear * (1 - 0.75 * _cloud_cover(t_s));
+}
+
+void GreenhouseSim::update() {
+	uint64_t now_us = NativeHal::now_us();
+	double remaining = (now_us - _last_us) / 1e6;
+	double t_s = _last_us / 1e6;
+
+	while (remaining > 0) {
+		double dt = std::min(remaining, (double) SIM_MAX_STEP_S);
+		_step(t_s, dt);
+		_update_stats(dt);
+		t_s += dt;
+		remaining -= dt;
+	}
+
+	_last_us = now_us;
+	_publish_sensors();
+}
+
+void GreenhouseSim::_step(double t_s, double dt) {
+	bool fan_on = NativeHal::pin_state(_pins.fan) == HIGH;
+	bool mist_on = NativeHal::pin_state(_pins.mist) == HIGH;
+
+	// The window motor runs while either pin is held
+	if (NativeHal::pin_state(_pins.window_open) == HIGH) {
+		_window_position = std::min(1.0, _window_position + dt / _params.window_travel_s);
+	} else if (NativeHal::pin_state(_pins.window_close) == HIGH) {
+		_window_position = std::max(0.0, _window_position - dt / _params.window_travel_s);
+	}
+
+	_outside_c = outside_c(t_s);
+	_solar = solar(t_s);
+
+	float flow = _params.leak_flow + _window_position * _params.window_flow + (fan_on ? _params.fan_flow : 0);
+	float outside_water = saturation_water(std::min(_outside_c, _weather.outside_dew_point_c));
+
+	// Water: transpiration and misting in, ventilation out.  Anything past saturation condenses.
+	float solar_w = _solar * _params.solar_gain_m2;
+	float transpiration = _params.transpiration_fraction * solar_w / LATENT_HEAT;
+	float mist = mist_on ? _params.mist_rate : 0;
+	float evaporated = transpiration + mist;
+
+	float water = _water + dt * (evaporated - flow * (_water - outside_water)) / _params.volume_m3;
+	float saturated = saturation_water(_temp_c);
+	if (water > saturated) {
+		evaporated = std::max(0.0f, evaporated - (water - saturated) * _params.volume_m3 / (float) dt);
+		water = saturated;
+	}
+	_water = std::max(0.0f, water);
+
+	// Heat: the sun in, the envelope and ventilation out, and evaporation takes its latent heat
+	float watts = solar_w
+		- _params.envelope_loss * (_temp_c - _outside_c)
+		- AIR_HEAT_CAPACITY * flow * (_temp_c - _outside_c)
+		- LATENT_HEAT * evaporated;
+	_temp_c += dt * watts / _params.heat_capacity;
+}
+
+void GreenhouseSim::_update_stats(double dt) {
+	bool fan_on = NativeHal::pin_state(_pins.fan) == HIGH;
+	bool window_open = _window_position > 0.5;
+	bool mist_on = NativeHal::pin_state(_pins.mist) == HIGH;
+
+	_stats.fan.cycles += fan_on && !_fan_was_on;
+	_stats.window.cycles += window_open && !_window_was_open;
+	_stats.mist.cycles += mist_on && !_mist_was_on;
+	_stats.fan.on_s += fan_on ? dt : 0;
+	_stats.window.on_s += window_open ? dt : 0;
+	_stats.mist.on_s += mist_on ? dt : 0;
+	_fan_was_on = fan_on;
+	_window_was_open = window_open;
+	_mist_was_on = mist_on;
+
+	float temp_f = this->temp_f();
+	_stats.elapsed_s += dt;
+	_stats.above_max_s += temp_f > _max_f ? dt : 0;
+	_stats.below_min_s += temp_f < _min_f ? dt : 0;
+	_stats.below_humidity_s += humidity() < _target_humidity ? dt : 0;
+	_stats.deviation_fs += fabs(temp_f - _target_f) * dt;
+	_stats.min_temp_f = std::min(_stats.min_temp_f, temp_f);
+	_stats.max_temp_f = std::max(_stats.max_temp_f, temp_f);
+}
+
+void GreenhouseSim::_publish_sensors() {
+	NativeHal::set_dht(_temp_c, humidity());
+
+	for (size_t i = 0; i < NativeHal::state().onewire_devices.size(); i++) {
+		NativeHal::set_onewire_temp(i, _temp_c + PROBE_OFFSET_C);
+	}
+
+	// The sensor saturates in bright sun, just like the real one
+	float full = std::min(65534.0, _solar * LUX_PER_W_M2 * TSL_COUNTS_PER_LUX);
+	NativeHal::set_light(full, full * TSL_IR_SHARE);
+}
+
+String GreenhouseSim::report() const {
+	double hours = _stats.elapsed_s / 3600;
+	double days = std::max(hours / 24, 1.0 / 24);
+
+	char buffer[512];
+	snprintf(buffer, sizeof(buffer),
+		"simulated %.1f days\n"
+		"temperature: %.1fF to %.1fF, mean deviation from target %.2fF\n"
+		"out of band: %.1fh above max, %.1fh below min, %.1fh below target humidity\n"
+		"fan: %u cycles (%.1f/day), on %.1fh\n"
+		"window: %u cycles (%.1f/day), open %.1fh\n"
+		"mist: %u cycles (%.1f/day), on %.1fh\n",
+		hours / 24,
+		_stats.min_temp_f, _stats.max_temp_f, _stats.deviation_fs / std::max(_stats.elapsed_s, 1.0),
+		_stats.above_max_s / 3600, _stats.below_min_s / 3600, _stats.below_humidity_s / 3600,
+		_stats.fan.cycles, _stats.fan.cycles / days, _stats.fan.on_s / 3600,
+		_stats.window.cycles, _stats.window.cycles / days, _stats.window.on_s / 3600,
+		_stats.mist.cycles, _stats.mist.cycles / days, _stats.mist.on_s / 3600);
+	return String(buffer);
+}
@@ -0,0 +1,135 @@
+#ifndef GREENHOUSESIM_H
+#define GREENHOUSESIM_H
+
+// A lumped model of the greenhouse for the native build.  Air temperature and absolute humidity
+// are integrated from solar gain, losses through the glazing, ventilation through the window and
+// fan, and evaporation from the plants and misters.  The actuators are read back from the pins the
+// real FanControl, WindowControl and MistControl drive, and the result is fed to the fake DHT22,
+// DS18B20 and TSL2591 through NativeHal, so ClimateControl runs unchanged against it.
+
+#include <Arduino.h>
+#include <NativeHal.h>
+
+#include "ExternalSettings.h"
+#include "WindowControl.h"
+
+// Integration step; the greenhouse time constant is tens of minutes so this is plenty
+#define SIM_MAX_STEP_S 1.0
+
+struct SimParams {
+	// Sized for a 3m x 4m hobby greenhouse
+	float volume_m3 = 30;
+	// Air plus benches, pots and soil, J/C
+	float heat_capacity = 3.5e5;
+	// Glazing and frame losses with everything shut, W/C
+	float envelope_loss = 240;
+	// Solar gain per W/m2 outside (floor area times transmittance)
+	float solar_gain_m2 = 8.5;
+	// Air exchange, m3/s
+	float leak_flow = 0.01;
+	float window_flow = 0.3;
+	float fan_flow = 0.8;
+	// Seconds for the window to travel fully open or closed
+	float window_travel_s = WINDOW_MOVE_TIME_S;
+	// Fraction of the solar gain that goes into transpiration rather than heating the air
+	float transpiration_fraction = 0.25;
+	// Water the misters put into the air, g/s
+	float mist_rate = 2.0;
+};
+
+struct SimWeather {
+	float outside_mean_c = 16;
+	float outside_swing_c = 7;
+	float outside_dew_point_c = 8;
+	float peak_solar = 850;
+	float sunrise_hour = 6;
+	float day_length_h = 14;
+	// 0 is always clear, 1 is heavily overcast on average
+	float cloudiness = 0.3;
+	uint32_t seed = 1;
+};
+
+struct ActuatorStats {
+	uint32_t cycles = 0;
+	double on_s = 0;
+};
+
+struct SimStats {
+	double elapsed_s = 0;
+	double above_max_s = 0;
+	double below_min_s = 0;
+	double below_humidity_s = 0;
+	float min_temp_f = 1000;
+	float max_temp_f = -1000;
+	// Integral of |temp - target|, for the mean deviation
+	double deviation_fs = 0;
+
+	ActuatorStats fan;
+	ActuatorStats window;
+	ActuatorStats mist;
+};
+
+struct SimPins {
+	uint8_t fan;
+	uint8_t window_open;
+	uint8_t window_close;
+	uint8_t mist;
+};
+
+class GreenhouseSim {
+    private:
+	SimParams _params;
+	SimWeather _weather;
+	SimPins _pins;
+
+	float _temp_c;
+	// Absolute humidity, g/m3
+	float _water;
+	float _window_position = 0;
+	float _solar = 0;
+	float _outside_c = 0;
+
+	float _target_f = DEFAULT_TARGET_TEMP_F;
+	float _max_f = DEFAULT_MAX_TEMP_F;
+	float _min_f = DEFAULT_MIN_TEMP_F;
+	float _target_humidity = DEFAULT_TARGET_HUMIDITY;
+
+	uint64_t _last_us = 0;
+	bool _fan_was_on = false;
+	bool _window_was_open = false;
+	bool _mist_was_on = false;
+
+	SimStats _stats;
+
+	float _cloud_cover(double t_s) const;
+	void _step(double t_s, double dt);
+	void _update_stats(double dt);
+	void _publish_sensors();
+
+    public:
+	GreenhouseSim(const SimParams &params, const SimWeather &weather, const SimPins &pins);
+
+	// Score the run against these, normally the same values the controller is given
+	void set_band(float target_f, float min_f, float max_f, float target_humidity);
+
+	// Integrate up to NativeHal's current time and update the fake sensors
+	void update();
+
+	float outside_c(double t_s) const;
+	float solar(double t_s) const;
+
+	float temp_c() const { return _temp_c; }
+	float temp_f() const { return _temp_c * 1.8 + 32; }
+	float humidity() const;
+	float window_position() const { return _window_position; }
+	float current_solar() const { return _solar; }
+	float current_outside_c() const { return _outside_c; }
+
+	const SimStats &stats() const { return _stats; }
+	String report() const;
+
+	// Water vapour at saturation, g/m3
+	static float saturation_water(float temp_c);
+};
+
+#endif
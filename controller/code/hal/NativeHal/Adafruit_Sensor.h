@@ -0,0 +1,17 @@
+#ifndef NATIVEHAL_ADAFRUIT_SENSOR_H
+#define NATIVEHAL_ADAFRUIT_SENSOR_H
+
+#include <Arduino.h>
+
+typedef struct {
+	char name[12];
+	int32_t version;
+	int32_t sensor_id;
+	int32_t type;
+	float max_value;
+	float min_value;
+	float resolution;
+	int32_t min_delay;
+} sensor_t;
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef NATIVEHAL_ADAFRUIT_TSL2591_H
+#define NATIVEHAL_ADAFRUIT_TSL2591_H
+
+// Fake TSL2591.  Channel values come from NativeHal::set_light(); like the real part, a reading is
+// only valid once an integration period has passed since the sensor was enabled.
+
+#include <Arduino.h>
+#include <Adafruit_Sensor.h>
+
+#define TSL2591_ADDR (0x29)
+#define TSL2591_COMMAND_BIT (0xA0)
+#define TSL2591_REGISTER_DEVICE_STATUS 0x13
+#define TSL2591_REGISTER_CHAN0_LOW 0x14
+
+#define TSL2591_VISIBLE (2)
+#define TSL2591_INFRARED (1)
+#define TSL2591_FULLSPECTRUM (0)
+
+#define TSL2591_LUX_DF (408.0F)
+
+typedef enum {
+	TSL2591_INTEGRATIONTIME_100MS = 0x00,
+	TSL2591_INTEGRATIONTIME_200MS = 0x01,
+	TSL2591_INTEGRATIONTIME_300MS = 0x02,
+	TSL2591_INTEGRATIONTIME_400MS = 0x03,
+	TSL2591_INTEGRATIONTIME_500MS = 0x04,
+	TSL2591_INTEGRATIONTIME_600MS = 0x05,
+} tsl2591IntegrationTime_t;
+
+typedef enum {
+	TSL2591_GAIN_LOW = 0x00,
+	TSL2591_GAIN_MED = 0x10,
+	TSL2591_GAIN_HIGH = 0x20,
+	TSL2591_GAIN_MAX = 0x30,
+} tsl2591Gain_t;
+
+class Adafruit_TSL2591 {
+    private:
+	tsl2591IntegrationTime_t _integration = TSL2591_INTEGRATIONTIME_100MS;
+	tsl2591Gain_t _gain = TSL2591_GAIN_MED;
+	bool _enabled = false;
+	uint64_t _enabled_us = 0;
+
+	uint32_t _integration_us() const {
+		return (_integration + 1) * 100000UL;
+	}
+
+    public:
+	Adafruit_TSL2591(int32_t sensor_id = -1) {}
+
+	bool begin() {
+		return NativeHal::state().light_present;
+	}
+
+	void enable() {
+		_enabled = true;
+		_enabled_us = NativeHal::now_us();
+	}
+
+	void disable() {
+		_enabled = false;
+	}
+
+	void setGain(tsl2591Gain_t gain) { _gain = gain; }
+	tsl2591Gain_t getGain() { return _gain; }
+	void setTiming(tsl2591IntegrationTime_t integration) { _integration = integration; }
+	tsl2591IntegrationTime_t getTiming() { return _integration; }
+
+	uint8_t getStatus() {
+		// AVALID, bit 0
+		return _enabled && NativeHal::now_us() - _enabled_us >= _integration_us() ? 0x01 : 0x00;
+	}
+
+	uint32_t getFullLuminosity() {
+		// The library enables the part and blocks for a full integration
+		enable();
+		NativeHal::advance_us(_integration_us() + 20000);
+		disable();
+
+		const NativeHal::State &hal = NativeHal::state();
+		return ((uint32_t) hal.light_ir << 16) | hal.light_full;
+	}
+
+	uint16_t getLuminosity(uint8_t channel) {
+		uint32_t x = getFullLuminosity();
+		if (channel == TSL2591_FULLSPECTRUM) {
+			return x & 0xFFFF;
+		} else if (channel == TSL2591_INFRARED) {
+			return x >> 16;
+		}
+		return (x & 0xFFFF) - (x >> 16);
+	}
+
+	float calculateLux(uint16_t ch0, uint16_t ch1) {
+		if (ch0 == 0xFFFF || ch1 == 0xFFFF) {
+			return -1;
+		}
+		if (ch0 == 0) {
+			return 0;
+		}
+
+		float atime = (_integration + 1) * 100.0F;
+		float again;
+		switch (_gain) {
+			case TSL2591_GAIN_LOW: again = 1.0F; break;
+			case TSL2591_GAIN_MED: again = 25.0F; break;
+			case TSL2591_GAIN_HIGH: again = 428.0F; break;
+			default: again = 9876.0F; break;
+		}
+
+		float cpl = (atime * again) / TSL2591_LUX_DF;
+		return (((float) ch0 - (float) ch1)) * (1.0F - ((float) ch1 / (float) ch0)) / cpl;
+	}
+
+	void getSensor(sensor_t *sensor) {
+		memset(sensor, 0, sizeof(sensor_t));
+		strlcpy(sensor->name, "TSL2591", sizeof(sensor->name));
+		sensor->version = 1;
+		sensor->max_value = 88000.0;
+		sensor->min_value = 0.0;
+		sensor->resolution = 0.001;
+	}
+};
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef NATIVEHAL_ALLOCATION_COUNTER_H
+#define NATIVEHAL_ALLOCATION_COUNTER_H
+
+// Counts heap traffic in the native benchmarks by replacing the global operator new and delete.
+// These are definitions, so include this from one file of a program only, the benchmark itself.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <new>
+
+static size_t ALLOCATIONS = 0;
+static size_t ALLOCATED_BYTES = 0;
+
+void *operator new(size_t size) {
+	ALLOCATIONS++;
+	ALLOCATED_BYTES += size;
+	void *p = malloc(size ? size : 1);
+	if (!p) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void operator delete(void *p) noexcept {
+	free(p);
+}
+
+void operator delete(void *p, size_t size) noexcept {
+	free(p);
+}
+
+#endif
@@ -0,0 +1,238 @@
+#include "Arduino.h"
+
+HardwareSerial Serial;
+EspClass ESP;
+
+unsigned long millis() {
+	// Truncate like the 32-bit ESP32 counter so wraparound behaves the same
+	return (uint32_t) (NativeHal::now_us() / 1000);
+}
+
+unsigned long micros() {
+	return (uint32_t) NativeHal::now_us();
+}
+
+void delay(uint32_t ms) {
+	NativeHal::advance_ms(ms);
+}
+
+void delayMicroseconds(uint32_t us) {
+	NativeHal::advance_us(us);
+}
+
+void yield() {}
+
+bool IPAddress::fromString(const char *address) {
+	unsigned int octets[4];
+	char extra;
+	if (sscanf(address, "%u.%u.%u.%u%c", &octets[0], &octets[1], &octets[2], &octets[3], &extra) != 4) {
+		return false;
+	}
+
+	for (int i = 0; i < 4; i++) {
+		if (octets[i] > 255) {
+			return false;
+		}
+		_octets[i] = octets[i];
+	}
+	return true;
+}
+
+String IPAddress::toString() const {
+	char buffer[16];
+	snprintf(buffer, sizeof(buffer), "%u.%u.%u.%u", _octets[0], _octets[1], _octets[2], _octets[3]);
+	return String(buffer);
+}
+
+uint32_t getCpuFrequencyMhz() {
+	return NativeHal::state().cpu_mhz;
+}
+
+bool setCpuFrequencyMhz(uint32_t mhz) {
+	NativeHal::state().cpu_mhz = mhz;
+	return true;
+}
+
+uint32_t EspClass::getHeapSize() {
+	return NativeHal::state().heap_size;
+}
+
+uint32_t EspClass::getFreeHeap() {
+	return NativeHal::state().heap_free;
+}
+
+uint32_t EspClass::getMinFreeHeap() {
+	return NativeHal::state().heap_min_free;
+}
+
+uint32_t EspClass::getMaxAllocHeap() {
+	return NativeHal::state().heap_max_alloc;
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+	NativeHal::state().pin_states[pin] = val;
+	NativeHal::state().pin_writes[pin]++;
+}
+
+int digitalRead(uint8_t pin) {
+	return NativeHal::pin_state(pin);
+}
+
+// Replaces the C library's time() so wall clock time moves with the virtual clock
+extern "C" time_t time(time_t *out) {
+	time_t now = NativeHal::state().epoch_s + NativeHal::now_us() / 1000000;
+	if (out) {
+		*out = now;
+	}
+	return now;
+}
+
+void configTzTime(const char *tz, const char *server1, const char *server2, const char *server3) {
+	setenv("TZ", tz, 1);
+	tzset();
+}
+
+bool getLocalTime(struct tm *info, uint32_t ms) {
+	time_t now = time(nullptr);
+	localtime_r(&now, info);
+	return true;
+}
+
+// String
+
+std::string String::_from_unsigned(unsigned long long value, unsigned char base) {
+	if (value == 0) {
+		return "0";
+	}
+
+	std::string digits;
+	while (value > 0) {
+		digits += "0123456789abcdefghijklmnopqrstuvwxyz"[value % base];
+		value /= base;
+	}
+	std::reverse(digits.begin(), digits.end());
+	return digits;
+}
+
+std::string String::_from_signed(long long value, unsigned char base) {
+	if (value < 0 && base == 10) {
+		return "-" + _from_unsigned(-(unsigned long long) value, base);
+	}
+	return _from_unsigned((unsigned long long) value, base);
+}
+
+std::string String::_from_double(double value, unsigned int decimals) {
+	char buffer[64];
+	snprintf(buffer, sizeof(buffer), "%.*f", decimals, value);
+	return buffer;
+}
+
+int String::indexOf(char c, unsigned int from) const {
+	size_t pos = _s.find(c, from);
+	return pos == std::string::npos ? -1 : (int) pos;
+}
+
+int String::indexOf(const char *s, unsigned int from) const {
+	size_t pos = _s.find(s, from);
+	return pos == std::string::npos ? -1 : (int) pos;
+}
+
+bool String::endsWith(const String &suffix) const {
+	return _s.length() >= suffix._s.length() &&
+		_s.compare(_s.length() - suffix._s.length(), suffix._s.length(), suffix._s) == 0;
+}
+
+String String::substring(unsigned int from, unsigned int to) const {
+	if (from > to) {
+		std::swap(from, to);
+	}
+	if (from >= _s.length()) {
+		return String();
+	}
+	return String(_s.substr(from, to - from));
+}
+
+void String::trim() {
+	size_t start = _s.find_first_not_of(" \t\r\n");
+	size_t end = _s.find_last_not_of(" \t\r\n");
+	_s = start == std::string::npos ? "" : _s.substr(start, end - start + 1);
+}
+
+void String::toLowerCase() {
+	for (auto &c : _s) {
+		c = tolower(c);
+	}
+}
+
+void String::toUpperCase() {
+	for (auto &c : _s) {
+		c = toupper(c);
+	}
+}
+
+// Print and Stream
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+	size_t n = 0;
+	while (size--) {
+		n += write(*buffer++);
+	}
+	return n;
+}
+
+size_t Print::printf(const char *format, ...) {
+	char buffer[256];
+	va_list args;
+	va_start(args, format);
+	int len = vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+
+	if (len < 0) {
+		return 0;
+	}
+	if ((size_t) len >= sizeof(buffer)) {
+		std::string large(len + 1, '\0');
+		va_start(args, format);
+		vsnprintf(&large[0], large.size(), format, args);
+		va_end(args);
+		return write((const uint8_t *) large.c_str(), len);
+	}
+	return write((const uint8_t *) buffer, len);
+}
+
+size_t Stream::readBytes(char *buffer, size_t length) {
+	size_t count = 0;
+	while (count < length) {
+		int c = read();
+		if (c < 0) {
+			break;
+		}
+		buffer[count++] = (char) c;
+	}
+	return count;
+}
+
+String Stream::readString() {
+	String result;
+	int c;
+	while ((c = read()) >= 0) {
+		result += (char) c;
+	}
+	return result;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+	if (NativeHal::state().echo_serial) {
+		fputc(c, stdout);
+	}
+	return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
+	if (NativeHal::state().echo_serial) {
+		fwrite(buffer, 1, size, stdout);
+	}
+	return size;
+}
@@ -0,0 +1,214 @@
+#ifndef NATIVEHAL_ARDUINO_H
+#define NATIVEHAL_ARDUINO_H
+
+// Host replacement for the Arduino core: the subset of the ESP32 Arduino API the libraries use,
+// backed by NativeHal's virtual clock and pin map.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+#include <string>
+
+#include "NativeHal.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define F(string_literal) (string_literal)
+
+// strlcpy arrived in glibc 2.38
+#if defined(__GLIBC__) && (__GLIBC__ < 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 38))
+inline size_t strlcpy(char *dst, const char *src, size_t size) {
+	size_t len = strlen(src);
+	if (size > 0) {
+		size_t copy = len < size - 1 ? len : size - 1;
+		memcpy(dst, src, copy);
+		dst[copy] = '\0';
+	}
+	return len;
+}
+#endif
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+// FreeRTOS comes in through the ESP32's Arduino.h
+#define taskYIELD() yield()
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+
+uint32_t getCpuFrequencyMhz();
+bool setCpuFrequencyMhz(uint32_t mhz);
+
+void configTzTime(const char *tz, const char *server1, const char *server2 = nullptr, const char *server3 = nullptr);
+bool getLocalTime(struct tm *info, uint32_t ms = 5000);
+
+class String {
+    private:
+	std::string _s;
+
+	static std::string _from_unsigned(unsigned long long value, unsigned char base);
+	static std::string _from_signed(long long value, unsigned char base);
+	static std::string _from_double(double value, unsigned int decimals);
+
+    public:
+	String() {}
+	String(const char *s) : _s(s ? s : "") {}
+	String(const std::string &s) : _s(s) {}
+	explicit String(char c) : _s(1, c) {}
+	explicit String(unsigned char value, unsigned char base = 10) : _s(_from_unsigned(value, base)) {}
+	explicit String(int value, unsigned char base = 10) : _s(_from_signed(value, base)) {}
+	explicit String(unsigned int value, unsigned char base = 10) : _s(_from_unsigned(value, base)) {}
+	explicit String(long value, unsigned char base = 10) : _s(_from_signed(value, base)) {}
+	explicit String(unsigned long value, unsigned char base = 10) : _s(_from_unsigned(value, base)) {}
+	explicit String(long long value, unsigned char base = 10) : _s(_from_signed(value, base)) {}
+	explicit String(unsigned long long value, unsigned char base = 10) : _s(_from_unsigned(value, base)) {}
+	explicit String(float value, unsigned int decimals = 2) : _s(_from_double(value, decimals)) {}
+	explicit String(double value, unsigned int decimals = 2) : _s(_from_double(value, decimals)) {}
+
+	const char *c_str() const { return _s.c_str(); }
+	unsigned int length() const { return _s.length(); }
+	bool isEmpty() const { return _s.empty(); }
+	char charAt(unsigned int index) const { return index < _s.length() ? _s[index] : 0; }
+	char operator[](unsigned int index) const { return charAt(index); }
+	void reserve(unsigned int size) { _s.reserve(size); }
+	void clear() { _s.clear(); }
+
+	bool concat(const String &s) { _s += s._s; return true; }
+	bool concat(const char *s) { _s += s ? s : ""; return true; }
+	bool concat(const char *s, unsigned int len) { _s.append(s, len); return true; }
+	bool concat(char c) { _s += c; return true; }
+
+	String &operator+=(const String &s) { concat(s); return *this; }
+	String &operator+=(const char *s) { concat(s); return *this; }
+	String &operator+=(char c) { concat(c); return *this; }
+
+	friend String operator+(const String &a, const String &b) { return String(a._s + b._s); }
+	friend String operator+(const String &a, const char *b) { return String(a._s + (b ? b : "")); }
+	friend String operator+(const char *a, const String &b) { return String((a ? a : "") + b._s); }
+	friend String operator+(const String &a, char b) { return String(a._s + b); }
+
+	bool equals(const String &s) const { return _s == s._s; }
+	bool equalsIgnoreCase(const String &s) const { return strcasecmp(_s.c_str(), s._s.c_str()) == 0; }
+	bool operator==(const String &s) const { return _s == s._s; }
+	bool operator==(const char *s) const { return _s == (s ? s : ""); }
+	bool operator!=(const String &s) const { return _s != s._s; }
+	bool operator!=(const char *s) const { return !(*this == s); }
+	bool operator<(const String &s) const { return _s < s._s; }
+
+	int indexOf(char c, unsigned int from = 0) const;
+	int indexOf(const char *s, unsigned int from = 0) const;
+	bool startsWith(const String &prefix) const { return _s.compare(0, prefix._s.length(), prefix._s) == 0; }
+	bool endsWith(const String &suffix) const;
+	String substring(unsigned int from) const { return substring(from, _s.length()); }
+	String substring(unsigned int from, unsigned int to) const;
+	void trim();
+	void toLowerCase();
+	void toUpperCase();
+	long toInt() const { return atol(_s.c_str()); }
+	float toFloat() const { return atof(_s.c_str()); }
+};
+
+class IPAddress {
+    private:
+	uint8_t _octets[4] = {0, 0, 0, 0};
+
+    public:
+	IPAddress() {}
+	IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : _octets{a, b, c, d} {}
+
+	// Accepts dotted quads only, like the ESP32 core for IPv4
+	bool fromString(const char *address);
+	bool fromString(const String &address) { return fromString(address.c_str()); }
+	String toString() const;
+
+	uint8_t operator[](int index) const { return _octets[index]; }
+	bool operator==(const IPAddress &other) const { return memcmp(_octets, other._octets, 4) == 0; }
+	bool operator!=(const IPAddress &other) const { return !(*this == other); }
+};
+
+class Print {
+    public:
+	virtual ~Print() {}
+	virtual size_t write(uint8_t c) = 0;
+	virtual size_t write(const uint8_t *buffer, size_t size);
+	size_t write(const char *s) { return s ? write((const uint8_t *) s, strlen(s)) : 0; }
+
+	size_t print(const char *s) { return write(s); }
+	size_t print(const String &s) { return write((const uint8_t *) s.c_str(), s.length()); }
+	size_t print(char c) { return write((uint8_t) c); }
+	size_t print(int value, int base = DEC) { return print(String(value, base)); }
+	size_t print(unsigned int value, int base = DEC) { return print(String(value, base)); }
+	size_t print(long value, int base = DEC) { return print(String(value, base)); }
+	size_t print(unsigned long value, int base = DEC) { return print(String(value, base)); }
+	size_t print(double value, int decimals = 2) { return print(String(value, decimals)); }
+
+	size_t println() { return write("\n"); }
+	template <typename T> size_t println(const T &value) { size_t n = print(value); return n + println(); }
+	template <typename T> size_t println(const T &value, int format) { size_t n = print(value, format); return n + println(); }
+
+	size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print {
+    protected:
+	unsigned long _timeout = 1000;
+
+    public:
+	virtual int available() = 0;
+	virtual int read() = 0;
+	virtual int peek() = 0;
+
+	void setTimeout(unsigned long timeout) { _timeout = timeout; }
+	size_t readBytes(char *buffer, size_t length);
+	size_t readBytes(uint8_t *buffer, size_t length) { return readBytes((char *) buffer, length); }
+	String readString();
+};
+
+class HardwareSerial : public Stream {
+    public:
+	void begin(unsigned long baud) {}
+	size_t write(uint8_t c) override;
+	size_t write(const uint8_t *buffer, size_t size) override;
+	using Print::write;
+	int available() override { return 0; }
+	int read() override { return -1; }
+	int peek() override { return -1; }
+};
+
+extern HardwareSerial Serial;
+
+// Heap figures come from NativeHal::state()
+class EspClass {
+    public:
+	uint32_t getHeapSize();
+	uint32_t getFreeHeap();
+	uint32_t getMinFreeHeap();
+	uint32_t getMaxAllocHeap();
+};
+
+extern EspClass ESP;
+
+#endif
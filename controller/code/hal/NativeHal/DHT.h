@@ -0,0 +1,33 @@
+#ifndef NATIVEHAL_DHT_H
+#define NATIVEHAL_DHT_H
+
+// Fake of the Adafruit DHT library: readings come from NativeHal::set_dht()
+
+#include <Arduino.h>
+
+#define DHT11 11
+#define DHT21 21
+#define DHT22 22
+
+class DHT {
+    public:
+	DHT(uint8_t pin, uint8_t type, uint8_t count = 6) {}
+	void begin(uint8_t usec = 55) {}
+
+	float readTemperature(bool S = false, bool force = false) {
+		NativeHal::State &hal = NativeHal::state();
+		hal.dht_reads++;
+		if (hal.dht_failing) {
+			return NAN;
+		}
+		return S ? hal.dht_temp_c * 1.8 + 32 : hal.dht_temp_c;
+	}
+
+	float readHumidity(bool force = false) {
+		NativeHal::State &hal = NativeHal::state();
+		hal.dht_reads++;
+		return hal.dht_failing ? NAN : hal.dht_humidity;
+	}
+};
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef NATIVEHAL_DALLASTEMPERATURE_H
+#define NATIVEHAL_DALLASTEMPERATURE_H
+
+// Fake DS18B20 driver.  Conversions take as long as on the real part for the configured resolution,
+// and reading before a conversion finishes returns the 85C power-on value like the hardware does.
+
+#include <Arduino.h>
+#include <OneWire.h>
+
+#define DEVICE_DISCONNECTED_C -127
+#define DEVICE_DISCONNECTED_F -196.6
+#define DS18B20_POWER_ON_C 85.0
+
+typedef uint8_t DeviceAddress[8];
+
+class DallasTemperature {
+    private:
+	uint8_t _resolution = 12;
+	bool _wait_for_conversion = true;
+	bool _converted = false;
+	uint64_t _conversion_start_us = 0;
+	uint64_t _conversion_time_us = 750000;
+	std::vector<float> _latched;
+
+	bool _conversion_done() const {
+		return _converted && NativeHal::now_us() - _conversion_start_us >= _conversion_time_us;
+	}
+
+    public:
+	DallasTemperature(OneWire *wire) {}
+	void begin() {}
+
+	void setWaitForConversion(bool wait) { _wait_for_conversion = wait; }
+	bool getWaitForConversion() const { return _wait_for_conversion; }
+
+	void setResolution(uint8_t resolution) {
+		_resolution = resolution < 9 ? 9 : (resolution > 12 ? 12 : resolution);
+	}
+	uint8_t getResolution() const { return _resolution; }
+
+	uint16_t millisToWaitForConversion(uint8_t resolution) const {
+		switch (resolution) {
+			case 9: return 94;
+			case 10: return 188;
+			case 11: return 375;
+			default: return 750;
+		}
+	}
+
+	void requestTemperatures() {
+		// The probes sample when the conversion starts
+		_latched.clear();
+		for (const auto &device : NativeHal::state().onewire_devices) {
+			_latched.push_back(device.temp_c);
+		}
+		_converted = true;
+		_conversion_start_us = NativeHal::now_us();
+		_conversion_time_us = millisToWaitForConversion(_resolution) * 1000ULL;
+
+		if (_wait_for_conversion) {
+			NativeHal::advance_us(_conversion_time_us);
+		}
+	}
+
+	bool isConversionComplete() const {
+		return _conversion_done();
+	}
+
+	float getTempC(const uint8_t *address) {
+		const auto &devices = NativeHal::state().onewire_devices;
+		for (size_t i = 0; i < devices.size(); i++) {
+			if (memcmp(devices[i].address, address, 8) != 0) {
+				continue;
+			}
+			if (!devices[i].connected) {
+				return DEVICE_DISCONNECTED_C;
+			}
+			if (!_conversion_done() || i >= _latched.size()) {
+				return DS18B20_POWER_ON_C;
+			}
+
+			// Quantise to the configured resolution
+			float step = 0.0625 * (1 << (12 - _resolution));
+			return floorf(_latched[i] / step) * step;
+		}
+		return DEVICE_DISCONNECTED_C;
+	}
+
+	float getTempF(const uint8_t *address) {
+		float c = getTempC(address);
+		return c == DEVICE_DISCONNECTED_C ? DEVICE_DISCONNECTED_F : c * 1.8 + 32;
+	}
+};
+
+#endif
@@ -0,0 +1,195 @@
+#include "HTTPClient.h"
+
+#include <zlib.h>
+
+bool HTTPClient::begin(const String &url) {
+	std::string rest = url.c_str();
+	size_t scheme = rest.find("://");
+	if (scheme != std::string::npos) {
+		rest = rest.substr(scheme + 3);
+	}
+
+	size_t slash = rest.find('/');
+	std::string authority = rest.substr(0, slash);
+	std::string path = slash == std::string::npos ? "/" : rest.substr(slash);
+
+	uint16_t port = 80;
+	size_t colon = authority.find(':');
+	if (colon != std::string::npos) {
+		port = atoi(authority.substr(colon + 1).c_str());
+		authority = authority.substr(0, colon);
+	}
+
+	return begin(String(authority), port, String(path));
+}
+
+bool HTTPClient::begin(const String &host, uint16_t port, const String &path) {
+	_stream = &_own_stream;
+	_request = NativeHal::HttpRequest();
+	_request.host = host.c_str();
+	_request.port = port;
+	_request.path = path.c_str();
+	return true;
+}
+
+bool HTTPClient::begin(WiFiClient &client, const String &url) {
+	begin(url);
+	_stream = &client;
+	return true;
+}
+
+bool HTTPClient::begin(WiFiClient &client, const String &host, uint16_t port, const String &path, bool https) {
+	begin(host, port, path);
+	_stream = &client;
+	return true;
+}
+
+void HTTPClient::end() {
+	_request.headers.clear();
+	_response_headers.clear();
+	if (_reuse) {
+		_stream->clear_body();
+	} else {
+		_stream->stop();
+	}
+	_size = -1;
+}
+
+void HTTPClient::addHeader(const String &name, const String &value) {
+	_request.headers[name.c_str()] = value.c_str();
+}
+
+void HTTPClient::collectHeaders(const char *header_keys[], size_t count) {
+	_collect.assign(header_keys, header_keys + count);
+}
+
+String HTTPClient::header(const char *name) {
+	auto it = _response_headers.find(name);
+	return it == _response_headers.end() ? String() : String(it->second);
+}
+
+bool HTTPClient::hasHeader(const char *name) {
+	return _response_headers.count(name) > 0;
+}
+
+// One complete gzip member, checked against its CRC and length like any other decoder would
+static bool gunzip(const std::string &compressed, std::string &out) {
+	z_stream stream = {};
+	if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK) {
+		return false;
+	}
+
+	out.clear();
+	char chunk[4096];
+	stream.next_in = (Bytef *) compressed.data();
+	stream.avail_in = compressed.size();
+
+	int result;
+	do {
+		stream.next_out = (Bytef *) chunk;
+		stream.avail_out = sizeof(chunk);
+		result = inflate(&stream, Z_NO_FLUSH);
+		out.append(chunk, sizeof(chunk) - stream.avail_out);
+	} while (result == Z_OK);
+
+	inflateEnd(&stream);
+	return result == Z_STREAM_END && stream.avail_in == 0;
+}
+
+// Stands in for the InfluxDB v1 API
+static bool is_influx_request(const NativeHal::HttpRequest &request) {
+	return request.path.compare(0, 6, "/write") == 0 || request.path == "/ping";
+}
+
+static NativeHal::HttpResponse influx_server(const NativeHal::HttpRequest &request) {
+	NativeHal::State &hal = NativeHal::state();
+	NativeHal::HttpResponse response;
+
+	if (hal.influx_failing) {
+		response.code = HTTPC_ERROR_CONNECTION_REFUSED;
+		return response;
+	}
+
+	if (request.path == "/ping") {
+		response.code = HTTP_CODE_NO_CONTENT;
+		return response;
+	}
+
+	hal.influx_wire_bytes += request.body.size();
+	std::string body = request.body;
+
+	auto encoding = request.headers.find("Content-Encoding");
+	if (encoding != request.headers.end() && encoding->second == "gzip") {
+		hal.influx_gzip_writes++;
+		if (!gunzip(request.body, body)) {
+			response.code = HTTP_CODE_BAD_REQUEST;
+			response.body = "{\"error\":\"unable to decode gzip body\"}";
+			return response;
+		}
+	}
+
+	hal.influx_writes.push_back(body);
+	response.code = HTTP_CODE_NO_CONTENT;
+	return response;
+}
+
+int HTTPClient::_send(const char *method, const uint8_t *payload, size_t size) {
+	NativeHal::State &hal = NativeHal::state();
+
+	_response_headers.clear();
+	_stream->clear_body();
+	_size = -1;
+
+	bool influx = is_influx_request(_request);
+	if (!influx && !hal.http_handler) {
+		return HTTPC_ERROR_CONNECTION_REFUSED;
+	}
+	if (!_stream->connected() && !_stream->open(_request.host, _request.port)) {
+		return HTTPC_ERROR_CONNECTION_REFUSED;
+	}
+	_request.address = _stream->remote();
+
+	_request.method = method;
+	_request.body.assign((const char *) payload, payload ? size : 0);
+	if (!influx) {
+		hal.http_requests++;
+	}
+
+	NativeHal::HttpResponse response = influx ? influx_server(_request) : hal.http_handler(_request);
+	if (response.code < 0) {
+		_stream->stop();
+		return response.code;
+	}
+	_stream->touch();
+
+	// Like the real client, only the headers asked for are kept
+	for (const auto &name : _collect) {
+		auto it = response.headers.find(name);
+		if (it != response.headers.end()) {
+			_response_headers[name] = it->second;
+		}
+	}
+
+	// A handler sending "Transfer-Encoding: chunked" supplies the body already chunked
+	_stream->set_body(response.body);
+	auto encoding = response.headers.find("Transfer-Encoding");
+	_size = encoding != response.headers.end() && encoding->second == "chunked" ? -1 : response.body.size();
+	return response.code;
+}
+
+String HTTPClient::errorToString(int error) {
+	switch (error) {
+		case HTTPC_ERROR_CONNECTION_REFUSED: return "connection refused";
+		case HTTPC_ERROR_SEND_HEADER_FAILED: return "send header failed";
+		case HTTPC_ERROR_SEND_PAYLOAD_FAILED: return "send payload failed";
+		case HTTPC_ERROR_NOT_CONNECTED: return "not connected";
+		case HTTPC_ERROR_CONNECTION_LOST: return "connection lost";
+		case HTTPC_ERROR_NO_STREAM: return "no stream";
+		case HTTPC_ERROR_NO_HTTP_SERVER: return "no HTTP server";
+		case HTTPC_ERROR_TOO_LESS_RAM: return "too less ram";
+		case HTTPC_ERROR_ENCODING: return "Transfer-Encoding not supported";
+		case HTTPC_ERROR_STREAM_WRITE: return "Stream write error";
+		case HTTPC_ERROR_READ_TIMEOUT: return "read Timeout";
+		default: return String();
+	}
+}
@@ -0,0 +1,75 @@
+#ifndef NATIVEHAL_HTTPCLIENT_H
+#define NATIVEHAL_HTTPCLIENT_H
+
+// Fake of the ESP32 HTTPClient.  Requests are handed to the handler set with
+// NativeHal::set_http_handler(); with no handler every request fails to connect.  InfluxDB
+// writes and pings go to a built-in fake server instead.  Like the real client, the
+// connection is kept open between requests unless setReuse(false) is called.  Given a client
+// that's already connected, requests go out on it whatever host they name.
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED (-2)
+#define HTTPC_ERROR_SEND_PAYLOAD_FAILED (-3)
+#define HTTPC_ERROR_NOT_CONNECTED (-4)
+#define HTTPC_ERROR_CONNECTION_LOST (-5)
+#define HTTPC_ERROR_NO_STREAM (-6)
+#define HTTPC_ERROR_NO_HTTP_SERVER (-7)
+#define HTTPC_ERROR_TOO_LESS_RAM (-8)
+#define HTTPC_ERROR_ENCODING (-9)
+#define HTTPC_ERROR_STREAM_WRITE (-10)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+
+#define HTTP_CODE_OK 200
+#define HTTP_CODE_NO_CONTENT 204
+#define HTTP_CODE_NOT_MODIFIED 304
+#define HTTP_CODE_BAD_REQUEST 400
+#define HTTP_CODE_NOT_FOUND 404
+#define HTTP_CODE_INTERNAL_SERVER_ERROR 500
+
+class HTTPClient {
+    private:
+	NativeHal::HttpRequest _request;
+	std::vector<std::string> _collect;
+	std::map<std::string, std::string> _response_headers;
+	WiFiClient _own_stream;
+	WiFiClient *_stream = &_own_stream;
+	bool _reuse = true;
+	int _size = -1;
+
+	int _send(const char *method, const uint8_t *payload, size_t size);
+
+    public:
+	bool begin(const String &url);
+	bool begin(const String &host, uint16_t port, const String &path);
+	bool begin(WiFiClient &client, const String &url);
+	bool begin(WiFiClient &client, const String &host, uint16_t port, const String &path, bool https = false);
+	void end();
+
+	void setTimeout(uint16_t timeout) {}
+	void setConnectTimeout(int32_t timeout) {}
+	void setReuse(bool reuse) { _reuse = reuse; }
+	void useHTTP10(bool use) {}
+
+	void addHeader(const String &name, const String &value);
+	void collectHeaders(const char *header_keys[], size_t count);
+	String header(const char *name);
+	bool hasHeader(const char *name);
+
+	int GET() { return _send("GET", nullptr, 0); }
+	int POST(const uint8_t *payload, size_t size) { return _send("POST", payload, size); }
+	int POST(const String &payload) { return POST((const uint8_t *) payload.c_str(), payload.length()); }
+	int sendRequest(const char *method, const uint8_t *payload = nullptr, size_t size = 0) { return _send(method, payload, size); }
+
+	String getString() { return _stream->readString(); }
+	WiFiClient &getStream() { return *_stream; }
+	WiFiClient *getStreamPtr() { return _stream->connected() ? _stream : nullptr; }
+	int getSize() { return _size; }
+	bool connected() { return _stream->connected(); }
+
+	static String errorToString(int error);
+};
+
+#endif
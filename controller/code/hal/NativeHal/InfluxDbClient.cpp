@@ -0,0 +1,89 @@
+#include "InfluxDbClient.h"
+
+Point::Point(const String &measurement) : _measurement(_escape(measurement, ", ")) {}
+
+String Point::_escape(const String &value, const char *special) {
+	String escaped;
+	for (unsigned int i = 0; i < value.length(); i++) {
+		char c = value[i];
+		if (strchr(special, c)) {
+			escaped += '\\';
+		}
+		escaped += c;
+	}
+	return escaped;
+}
+
+void Point::addTag(const String &name, String value) {
+	_tags += ",";
+	_tags += _escape(name, ",= ");
+	_tags += "=";
+	_tags += _escape(value, ",= ");
+}
+
+void Point::_append_field(const String &name, const String &value) {
+	if (_fields.length() > 0) {
+		_fields += ",";
+	}
+	_fields += _escape(name, ",= ");
+	_fields += "=";
+	_fields += value;
+}
+
+void Point::setTime(WritePrecision precision) {
+	switch (precision) {
+		case WritePrecision::NoTime:
+			_timestamp = String();
+			break;
+		case WritePrecision::S:
+			setTime((unsigned long long) time(nullptr));
+			break;
+		case WritePrecision::MS:
+			setTime((unsigned long long) time(nullptr) * 1000);
+			break;
+		case WritePrecision::US:
+			setTime((unsigned long long) time(nullptr) * 1000000);
+			break;
+		case WritePrecision::NS:
+			setTime((unsigned long long) time(nullptr) * 1000000000);
+			break;
+	}
+}
+
+String Point::toLineProtocol(const String &include_tags) const {
+	String line = _measurement + _tags;
+	if (include_tags.length() > 0) {
+		line += ",";
+		line += include_tags;
+	}
+	line += " ";
+	line += _fields;
+	if (_timestamp.length() > 0) {
+		line += " ";
+		line += _timestamp;
+	}
+	return line;
+}
+
+bool InfluxDBClient::validateConnection() {
+	NativeHal::State &hal = NativeHal::state();
+	if (!hal.wifi_connected || hal.influx_failing) {
+		_last_error = "connection refused";
+		return false;
+	}
+
+	_last_error = String();
+	return true;
+}
+
+bool InfluxDBClient::_write(const char *lines) {
+	NativeHal::State &hal = NativeHal::state();
+	if (!hal.wifi_connected || hal.influx_failing) {
+		_last_error = "connection refused";
+		return false;
+	}
+
+	_last_error = String();
+	hal.influx_writes.push_back(lines);
+	return true;
+}
@@ -0,0 +1,88 @@
+#ifndef NATIVEHAL_INFLUXDBCLIENT_H
+#define NATIVEHAL_INFLUXDBCLIENT_H
+
+// Fake of the tobiasschuerg InfluxDB client.  Point produces real line protocol; writes are
+// appended to NativeHal::state().influx_writes, or fail while NativeHal::set_influx_failing() is on.
+
+#include <Arduino.h>
+
+enum class WritePrecision {
+	NoTime = 0,
+	S,
+	MS,
+	US,
+	NS
+};
+
+class WriteOptions {
+    public:
+	WritePrecision _writePrecision = WritePrecision::NoTime;
+	uint16_t _batchSize = 1;
+	uint16_t _bufferSize = 5;
+
+	WriteOptions &writePrecision(WritePrecision precision) { _writePrecision = precision; return *this; }
+	WriteOptions &batchSize(uint16_t size) { _batchSize = size; return *this; }
+	WriteOptions &bufferSize(uint16_t size) { _bufferSize = size; return *this; }
+};
+
+class Point {
+    private:
+	String _measurement;
+	String _tags;
+	String _fields;
+	String _timestamp;
+
+	static String _escape(const String &value, const char *special);
+	void _append_field(const String &name, const String &value);
+
+    public:
+	Point(const String &measurement);
+
+	void addTag(const String &name, String value);
+	void addField(const String &name, float value, int decimal_places = 2) { _append_field(name, String(value, decimal_places)); }
+	void addField(const String &name, double value, int decimal_places = 2) { _append_field(name, String(value, decimal_places)); }
+	void addField(const String &name, int value) { _append_field(name, String(value) + "i"); }
+	void addField(const String &name, long value) { _append_field(name, String(value) + "i"); }
+	void addField(const String &name, unsigned int value) { _append_field(name, String(value) + "i"); }
+	void addField(const String &name, unsigned long value) { _append_field(name, String(value) + "i"); }
+	void addField(const String &name, bool value) { _append_field(name, value ? "true" : "false"); }
+	void addField(const String &name, const char *value) { _append_field(name, "\"" + _escape(value, "\\\"") + "\""); }
+
+	void setTime(unsigned long long timestamp) { _timestamp = String(timestamp); }
+	void setTime(WritePrecision precision = WritePrecision::S);
+	void clearFields() { _fields = String(); _timestamp = String(); }
+	void clearTags() { _tags = String(); }
+	bool hasFields() const { return _fields.length() > 0; }
+	bool hasTags() const { return _tags.length() > 0; }
+	String getName() const { return _measurement; }
+
+	String toLineProtocol(const String &include_tags = "") const;
+};
+
+class InfluxDBClient {
+    private:
+	String _url;
+	String _db;
+	WriteOptions _options;
+	String _last_error;
+
+	bool _write(const char *lines);
+
+    public:
+	InfluxDBClient(const String &url, const String &db) : _url(url), _db(db) {}
+
+	void setConnectionParamsV1(const String &url, const String &db) { _url = url; _db = db; }
+	bool setWriteOptions(const WriteOptions &options) { _options = options; return true; }
+	bool validateConnection();
+	String getServerUrl() const { return _url; }
+	String getLastErrorMessage() const { return _last_error; }
+	int getLastStatusCode() const { return _last_error.length() > 0 ? 503 : 204; }
+
+	bool writePoint(Point &point) { return _write(point.toLineProtocol().c_str()); }
+	bool writeRecord(const String &record) { return _write(record.c_str()); }
+	bool writeRecord(const char *record) { return _write(record); }
+	bool flushBuffer() { return true; }
+	bool isBufferEmpty() const { return true; }
+};
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef NATIVEHAL_INFLUXDBCLOUD_H
+#define NATIVEHAL_INFLUXDBCLOUD_H
+
+// Only the certificates live here in the real library; nothing is needed on the host
+
+#endif
@@ -0,0 +1,106 @@
+#include "LittleFS.h"
+
+LittleFSFS LittleFS;
+
+namespace NativeHal {
+
+std::map<std::string, std::shared_ptr<std::string>> &files() {
+	static std::map<std::string, std::shared_ptr<std::string>> _files;
+	return _files;
+}
+
+}
+
+size_t File::read(uint8_t *buffer, size_t size) {
+	if (!_data || _pos >= _data->size()) {
+		return 0;
+	}
+
+	size_t count = std::min(size, _data->size() - _pos);
+	memcpy(buffer, _data->data() + _pos, count);
+	_pos += count;
+	return count;
+}
+
+int File::read() {
+	uint8_t c;
+	return read(&c, 1) == 1 ? c : -1;
+}
+
+size_t File::write(const uint8_t *buffer, size_t size) {
+	if (!_data || !_writable) {
+		return 0;
+	}
+
+	if (_pos + size > _data->size()) {
+		_data->resize(_pos + size);
+	}
+	memcpy(&(*_data)[_pos], buffer, size);
+	_pos += size;
+	return size;
+}
+
+File File::openNextFile() {
+	if (!_directory || _next_entry >= _entries.size()) {
+		return File();
+	}
+	return LittleFS.open(_entries[_next_entry++].c_str(), "r");
+}
+
+const char *File::name() const {
+	size_t slash = _path.rfind('/');
+	return slash == std::string::npos ? _path.c_str() : _path.c_str() + slash + 1;
+}
+
+File LittleFSFS::open(const char *path, const char *mode, bool create) {
+	auto &files = NativeHal::files();
+	auto it = files.find(path);
+
+	if (mode[0] == 'r') {
+		if (it == files.end()) {
+			// Directories only exist as the prefix of the files in them
+			std::string prefix = std::string(path) + (path[strlen(path) - 1] == '/' ? "" : "/");
+			std::vector<std::string> entries;
+			for (const auto &file : files) {
+				if (file.first.compare(0, prefix.size(), prefix) == 0 && file.first.find('/', prefix.size()) == std::string::npos) {
+					entries.push_back(file.first);
+				}
+			}
+			if (entries.empty()) {
+				return File();
+			}
+			return File(path, entries);
+		}
+		return File(it->second, 0, strchr(mode, '+') != nullptr, path);
+	}
+
+	if (it == files.end() || mode[0] == 'w') {
+		auto data = std::make_shared<std::string>();
+		files[path] = data;
+		return File(data, 0, true, path);
+	}
+
+	// Append
+	return File(it->second, it->second->size(), true, path);
+}
+
+bool LittleFSFS::rename(const char *from, const char *to) {
+	auto &files = NativeHal::files();
+	auto it = files.find(from);
+	if (it == files.end()) {
+		return false;
+	}
+
+	auto data = it->second;
+	files.erase(it);
+	files[to] = data;
+	return true;
+}
+
+size_t LittleFSFS::usedBytes() {
+	size_t used = 0;
+	for (const auto &file : NativeHal::files()) {
+		used += file.second->size();
+	}
+	return used;
+}
@@ -0,0 +1,81 @@
+#ifndef NATIVEHAL_LITTLEFS_H
+#define NATIVEHAL_LITTLEFS_H
+
+// In-memory stand-in for LittleFS.  Files live for the life of the process, or until
+// NativeHal::reset() clears them.
+
+#include <Arduino.h>
+#include <memory>
+
+namespace NativeHal {
+	std::map<std::string, std::shared_ptr<std::string>> &files();
+}
+
+class File {
+    private:
+	std::shared_ptr<std::string> _data;
+	size_t _pos = 0;
+	bool _writable = false;
+
+	std::string _path;
+	// For a directory, the full paths of the files in it
+	bool _directory = false;
+	std::vector<std::string> _entries;
+	size_t _next_entry = 0;
+
+    public:
+	File() {}
+	File(std::shared_ptr<std::string> data, size_t pos, bool writable, const std::string &path = "") : _data(data), _pos(pos), _writable(writable), _path(path) {}
+	File(const std::string &path, const std::vector<std::string> &entries) : _path(path), _directory(true), _entries(entries) {}
+
+	explicit operator bool() const { return (bool) _data || _directory; }
+
+	bool isDirectory() const { return _directory; }
+	File openNextFile();
+	const char *path() const { return _path.c_str(); }
+	// Just the last part of the path, like the ESP32 core
+	const char *name() const;
+
+	size_t size() const { return _data ? _data->size() : 0; }
+	size_t position() const { return _pos; }
+	int available() const { return _data ? _data->size() - _pos : 0; }
+
+	bool seek(size_t pos) {
+		if (!_data || pos > _data->size()) {
+			return false;
+		}
+		_pos = pos;
+		return true;
+	}
+
+	size_t read(uint8_t *buffer, size_t size);
+	int read();
+	size_t write(const uint8_t *buffer, size_t size);
+	size_t write(uint8_t c) { return write(&c, 1); }
+
+	void flush() {}
+	void close() { _data.reset(); _pos = 0; _directory = false; _entries.clear(); }
+};
+
+class LittleFSFS {
+    public:
+	bool begin(bool format_on_fail = false, const char *base_path = "/littlefs", uint8_t max_open_files = 10, const char *partition_label = "spiffs") { return true; }
+	void end() {}
+
+	bool exists(const char *path) { return NativeHal::files().count(path) > 0; }
+	bool exists(const String &path) { return exists(path.c_str()); }
+	File open(const char *path, const char *mode = "r", bool create = false);
+	File open(const String &path, const char *mode = "r", bool create = false) { return open(path.c_str(), mode, create); }
+	bool remove(const char *path) { return NativeHal::files().erase(path) > 0; }
+	bool remove(const String &path) { return remove(path.c_str()); }
+	bool rename(const char *from, const char *to);
+	bool mkdir(const char *path) { return true; }
+	bool format() { NativeHal::files().clear(); return true; }
+
+	size_t totalBytes() { return 1024 * 1024; }
+	size_t usedBytes();
+};
+
+extern LittleFSFS LittleFS;
+
+#endif
@@ -0,0 +1,9 @@
+#include "Logger.h"
+
+void Logger::_write(const char *level, const String &message) {
+	if (!NativeHal::state().echo_log) {
+		return;
+	}
+
+	printf("[%10.3f] %-5s %s\n", NativeHal::now_us() / 1e6, level, message.c_str());
+}
@@ -0,0 +1,24 @@
+#ifndef NATIVEHAL_LOGGER_H
+#define NATIVEHAL_LOGGER_H
+
+// Host stand-in for the shared syslog Logger; messages go to stdout, tagged with the virtual time
+
+#include <Arduino.h>
+
+class Logger {
+    private:
+	String _app;
+
+	void _write(const char *level, const String &message);
+
+    public:
+	void init(const char *host, int port, const char *device, const char *app) { _app = app; }
+
+	void log(const String &message) { _write("INFO", message); }
+	void log_info(const String &message) { _write("INFO", message); }
+	void log_debug(const String &message) { _write("DEBUG", message); }
+	void log_warning(const String &message) { _write("WARN", message); }
+	void log_error(const String &message) { _write("ERROR", message); }
+};
+
+#endif
@@ -0,0 +1,119 @@
+#include "NativeHal.h"
+#include "WirelessControl.h"
+#include "LittleFS.h"
+
+namespace NativeHal {
+
+static State _state;
+
+State &state() {
+	return _state;
+}
+
+void reset() {
+	_state = State();
+	files().clear();
+	WirelessControl::is_connected = true;
+}
+
+void set_millis(uint64_t ms) {
+	_state.now_us = ms * 1000;
+}
+
+void advance_ms(uint64_t ms) {
+	_state.now_us += ms * 1000;
+}
+
+void advance_us(uint64_t us) {
+	_state.now_us += us;
+}
+
+uint64_t now_us() {
+	return _state.now_us;
+}
+
+void set_epoch(uint32_t epoch_s) {
+	_state.epoch_s = epoch_s;
+}
+
+int pin_state(uint8_t pin) {
+	auto it = _state.pin_states.find(pin);
+	return it == _state.pin_states.end() ? 0 : it->second;
+}
+
+uint32_t pin_writes(uint8_t pin) {
+	auto it = _state.pin_writes.find(pin);
+	return it == _state.pin_writes.end() ? 0 : it->second;
+}
+
+void set_dht(float temp_c, float humidity) {
+	_state.dht_temp_c = temp_c;
+	_state.dht_humidity = humidity;
+}
+
+void set_dht_failing(bool failing) {
+	_state.dht_failing = failing;
+}
+
+void add_onewire_device(const uint8_t address[8], float temp_c) {
+	OneWireDevice device;
+	for (int i = 0; i < 8; i++) {
+		device.address[i] = address[i];
+	}
+	device.temp_c = temp_c;
+	device.connected = true;
+	_state.onewire_devices.push_back(device);
+}
+
+void set_onewire_temp(size_t index, float temp_c) {
+	if (index < _state.onewire_devices.size()) {
+		_state.onewire_devices[index].temp_c = temp_c;
+	}
+}
+
+void set_onewire_connected(size_t index, bool connected) {
+	if (index < _state.onewire_devices.size()) {
+		_state.onewire_devices[index].connected = connected;
+	}
+}
+
+void set_light(uint16_t full, uint16_t ir) {
+	_state.light_full = full;
+	_state.light_ir = ir;
+}
+
+void set_light_present(bool present) {
+	_state.light_present = present;
+}
+
+void set_wifi_connected(bool connected) {
+	_state.wifi_connected = connected;
+	WirelessControl::is_connected = connected;
+}
+
+void set_dns(const std::string &host, const std::string &address) {
+	if (address.empty()) {
+		_state.dns.erase(host);
+	} else {
+		_state.dns[host] = address;
+	}
+}
+
+void set_http_handler(HttpHandler handler) {
+	_state.http_handler = handler;
+}
+
+void set_influx_failing(bool failing) {
+	_state.influx_failing = failing;
+}
+
+void set_udp_drop_every(uint32_t packets) {
+	_state.udp_drop_every = packets;
+}
+
+void set_echo(bool serial, bool log) {
+	_state.echo_serial = serial;
+	_state.echo_log = log;
+}
+
+}
@@ -0,0 +1,153 @@
+#ifndef NATIVEHAL_H
+#define NATIVEHAL_H
+
+// Host-side stand-ins for the ESP32, its peripherals and the network, used by the `native`
+// PlatformIO environment.  The headers in this directory replace the Arduino, sensor, HTTP
+// and InfluxDB headers so the libraries build unchanged; this header is the other side of
+// those fakes, letting a host program set the clock and sensor values and see what was
+// written to pins and servers.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace NativeHal {
+
+struct OneWireDevice {
+	uint8_t address[8];
+	float temp_c;
+	bool connected;
+};
+
+struct HttpRequest {
+	std::string method;
+	// As sent in the Host header
+	std::string host;
+	uint16_t port;
+	// What the socket was opened to: the host, or an address the caller connected to itself
+	std::string address;
+	std::string path;
+	std::map<std::string, std::string> headers;
+	std::string body;
+};
+
+struct HttpResponse {
+	// HTTP status, or one of the negative HTTPC_ERROR_* codes
+	int code;
+	std::map<std::string, std::string> headers;
+	std::string body;
+};
+
+typedef std::function<HttpResponse(const HttpRequest &)> HttpHandler;
+
+struct UdpPacket {
+	std::string host;
+	uint16_t port;
+	std::string body;
+};
+
+struct State {
+	// Virtual monotonic clock; nothing advances it except the program and delay()
+	uint64_t now_us = 0;
+	// Wall clock time at now_us == 0, as if NTP had already synced.  time() follows the
+	// virtual clock from here.
+	uint32_t epoch_s = 1750000000;
+
+	uint32_t cpu_mhz = 240;
+
+	// What ESP reports for the heap; the host's own heap isn't tracked
+	uint32_t heap_size = 320 * 1024;
+	uint32_t heap_free = 200 * 1024;
+	uint32_t heap_min_free = 180 * 1024;
+	uint32_t heap_max_alloc = 110 * 1024;
+
+	std::map<uint8_t, int> pin_states;
+	std::map<uint8_t, uint32_t> pin_writes;
+
+	float dht_temp_c = 20;
+	float dht_humidity = 50;
+	bool dht_failing = false;
+	uint32_t dht_reads = 0;
+
+	std::vector<OneWireDevice> onewire_devices;
+
+	bool light_present = true;
+	uint16_t light_full = 0;
+	uint16_t light_ir = 0;
+
+	bool wifi_connected = true;
+	// Names WiFi.hostByName() can resolve; anything else fails like a lookup timing out
+	std::map<std::string, std::string> dns;
+	uint32_t dns_lookups = 0;
+	HttpHandler http_handler;
+	uint32_t http_requests = 0;
+	// TCP connections opened, and how long the servers keep an idle one open
+	uint32_t http_connects = 0;
+	uint32_t http_idle_timeout_ms = 75 * 1000;
+
+	// Bodies POSTed to the InfluxDB write API.  Requests to /write and /ping are answered by
+	// a built-in fake InfluxDB rather than the http handler.  gzip bodies are decompressed
+	// before they are kept, as the real server would.
+	std::vector<std::string> influx_writes;
+	bool influx_failing = false;
+	// Body bytes as they came over the wire, and how many requests were gzip
+	uint64_t influx_wire_bytes = 0;
+	uint32_t influx_gzip_writes = 0;
+
+	// Datagrams sent with WiFiUDP, as delivered.  With udp_drop_every set, every nth one is lost
+	// on the way instead.
+	std::vector<UdpPacket> udp_packets;
+	uint32_t udp_sent = 0;
+	uint32_t udp_drop_every = 0;
+
+	// Echo Serial and Logger output to stdout
+	bool echo_serial = false;
+	bool echo_log = true;
+};
+
+State &state();
+
+// Put everything back to power-on defaults, including the fake file system
+void reset();
+
+// Clock
+void set_millis(uint64_t ms);
+void advance_ms(uint64_t ms);
+void advance_us(uint64_t us);
+uint64_t now_us();
+void set_epoch(uint32_t epoch_s);
+
+// GPIO
+int pin_state(uint8_t pin);
+uint32_t pin_writes(uint8_t pin);
+
+// DHT22, in Celsius like the real sensor
+void set_dht(float temp_c, float humidity);
+void set_dht_failing(bool failing);
+
+// DS18B20 probes on the one-wire bus
+void add_onewire_device(const uint8_t address[8], float temp_c);
+void set_onewire_temp(size_t index, float temp_c);
+void set_onewire_connected(size_t index, bool connected);
+
+// TSL2591 raw channels
+void set_light(uint16_t full, uint16_t ir);
+void set_light_present(bool present);
+
+// Network
+void set_wifi_connected(bool connected);
+// Pass an empty address to make `host` stop resolving
+void set_dns(const std::string &host, const std::string &address);
+void set_http_handler(HttpHandler handler);
+void set_influx_failing(bool failing);
+void set_udp_drop_every(uint32_t packets);
+
+// Output
+void set_echo(bool serial, bool log);
+
+}
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef NATIVEHAL_ONEWIRE_H
+#define NATIVEHAL_ONEWIRE_H
+
+// Fake one-wire bus: search() walks the devices added with NativeHal::add_onewire_device()
+
+#include <Arduino.h>
+
+class OneWire {
+    private:
+	size_t _search_index = 0;
+
+    public:
+	OneWire(uint8_t pin) {}
+
+	void reset_search() {
+		_search_index = 0;
+	}
+
+	bool search(uint8_t *address, bool search_mode = true) {
+		const auto &devices = NativeHal::state().onewire_devices;
+		while (_search_index < devices.size()) {
+			const NativeHal::OneWireDevice &device = devices[_search_index++];
+			if (device.connected) {
+				memcpy(address, device.address, 8);
+				return true;
+			}
+		}
+		return false;
+	}
+};
+
+#endif
@@ -0,0 +1,88 @@
+#include "WiFi.h"
+#include "WiFiUdp.h"
+
+WiFiClass WiFi;
+
+int WiFiClass::hostByName(const char *host, IPAddress &result) {
+	NativeHal::State &hal = NativeHal::state();
+
+	if (result.fromString(host)) {
+		return 1;
+	}
+
+	hal.dns_lookups++;
+	auto it = hal.dns.find(host);
+	if (!hal.wifi_connected || it == hal.dns.end()) {
+		return 0;
+	}
+	return result.fromString(it->second.c_str()) ? 1 : 0;
+}
+
+bool WiFiClient::open(const std::string &host, uint16_t port) {
+	NativeHal::State &hal = NativeHal::state();
+
+	if (connected() && host == _host && port == _port) {
+		return true;
+	}
+
+	stop();
+	if (!hal.wifi_connected) {
+		return false;
+	}
+
+	_open = true;
+	_host = host;
+	_port = port;
+	hal.http_connects++;
+	touch();
+	return true;
+}
+
+uint8_t WiFiClient::connected() {
+	NativeHal::State &hal = NativeHal::state();
+
+	if (_open && (!hal.wifi_connected || NativeHal::now_us() - _last_used_us > hal.http_idle_timeout_ms * 1000ULL)) {
+		_open = false;
+	}
+	return _open;
+}
+
+void WiFiClient::stop() {
+	_open = false;
+	clear_body();
+}
+
+int WiFiUDP::beginPacket(const char *host, uint16_t port) {
+	IPAddress ip;
+	_started = WiFi.hostByName(host, ip) == 1;
+	_host = host;
+	_port = port;
+	_packet.clear();
+	return _started ? 1 : 0;
+}
+
+size_t WiFiUDP::write(const uint8_t *buffer, size_t size) {
+	if (!_started) {
+		return 0;
+	}
+	_packet.append((const char *) buffer, size);
+	return size;
+}
+
+int WiFiUDP::endPacket() {
+	NativeHal::State &hal = NativeHal::state();
+
+	if (!_started || !hal.wifi_connected) {
+		return 0;
+	}
+	_started = false;
+
+	// Lost on the air; the sender can't tell
+	hal.udp_sent++;
+	if (hal.udp_drop_every > 0 && hal.udp_sent % hal.udp_drop_every == 0) {
+		return 1;
+	}
+
+	hal.udp_packets.push_back({_host, _port, _packet});
+	return 1;
+}
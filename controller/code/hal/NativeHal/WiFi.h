@@ -0,0 +1,51 @@
+#ifndef NATIVEHAL_WIFI_H
+#define NATIVEHAL_WIFI_H
+
+// Fake of the ESP32 WiFi class.  Names resolve through the table set with NativeHal::set_dns(),
+// and only while the WiFi is connected.
+
+#include <Arduino.h>
+
+// A TCP connection to one server, which also reads back the body of the last response.  The
+// fake server closes connections left idle longer than NativeHal's http_idle_timeout_ms.
+class WiFiClient : public Stream {
+    private:
+	std::string _body;
+	size_t _pos = 0;
+
+	bool _open = false;
+	std::string _host;
+	uint16_t _port = 0;
+	uint64_t _last_used_us = 0;
+
+    public:
+	// Fake only: connect if not already connected to this server
+	bool open(const std::string &host, uint16_t port);
+	const std::string &remote() const { return _host; }
+
+	int connect(const char *host, uint16_t port, int32_t timeout = 0) { return open(host, port) ? 1 : 0; }
+	void touch() { _last_used_us = NativeHal::now_us(); }
+	void set_body(const std::string &body) { _body = body; _pos = 0; }
+	void clear_body() { _body.clear(); _pos = 0; }
+
+	size_t write(uint8_t c) override { return 1; }
+	using Print::write;
+	int available() override { return _body.size() - _pos; }
+	int read() override { return _pos < _body.size() ? (uint8_t) _body[_pos++] : -1; }
+	int peek() override { return _pos < _body.size() ? (uint8_t) _body[_pos] : -1; }
+	uint8_t connected();
+	void stop();
+};
+
+class WiFiClass {
+    public:
+	// Returns 1 and fills `result` when the name resolves, like the ESP32 core
+	int hostByName(const char *host, IPAddress &result);
+
+	IPAddress localIP() { return IPAddress(192, 168, 1, 50); }
+	bool setSleep(bool enabled) { return true; }
+};
+
+extern WiFiClass WiFi;
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef NATIVEHAL_WIFIUDP_H
+#define NATIVEHAL_WIFIUDP_H
+
+// Fake of the ESP32 WiFiUDP, send side only.  Datagrams are kept in NativeHal's udp_packets.
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+class WiFiUDP {
+    private:
+	std::string _host;
+	uint16_t _port = 0;
+	std::string _packet;
+	bool _started = false;
+
+    public:
+	// 0 when the WiFi is down or the host doesn't resolve, like the ESP32 core
+	int beginPacket(const char *host, uint16_t port);
+	size_t write(const uint8_t *buffer, size_t size);
+	size_t write(uint8_t c) { return write(&c, 1); }
+	int endPacket();
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef NATIVEHAL_WIRE_H
+#define NATIVEHAL_WIRE_H
+
+// Fake I2C bus.  Only the TSL2591 is on it: a read from the CHAN0_LOW register returns the four
+// channel bytes set with NativeHal::set_light().
+
+#include <Arduino.h>
+
+class TwoWire {
+    private:
+	uint8_t _address = 0;
+	uint8_t _register = 0;
+	uint8_t _rx[32];
+	size_t _rx_len = 0;
+	size_t _rx_pos = 0;
+
+    public:
+	bool begin() { return true; }
+
+	void beginTransmission(uint8_t address) {
+		_address = address;
+	}
+
+	size_t write(uint8_t data) {
+		_register = data;
+		return 1;
+	}
+
+	uint8_t endTransmission(bool stop = true) {
+		// Address NACK when nothing answers
+		return _address == 0x29 && NativeHal::state().light_present ? 0 : 2;
+	}
+
+	uint8_t requestFrom(int address, int quantity) {
+		_rx_len = 0;
+		_rx_pos = 0;
+
+		const NativeHal::State &hal = NativeHal::state();
+		if (address != 0x29 || !hal.light_present || (_register & 0x1F) != 0x14) {
+			return 0;
+		}
+
+		uint8_t channels[4] = {
+			(uint8_t) (hal.light_full & 0xFF), (uint8_t) (hal.light_full >> 8),
+			(uint8_t) (hal.light_ir & 0xFF), (uint8_t) (hal.light_ir >> 8),
+		};
+		for (int i = 0; i < quantity && i < 4; i++) {
+			_rx[_rx_len++] = channels[i];
+		}
+		return _rx_len;
+	}
+
+	int available() {
+		return _rx_len - _rx_pos;
+	}
+
+	int read() {
+		return _rx_pos < _rx_len ? _rx[_rx_pos++] : -1;
+	}
+};
+
+extern TwoWire Wire;
+
+#endif
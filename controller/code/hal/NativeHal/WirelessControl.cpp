@@ -0,0 +1,11 @@
+#include "WirelessControl.h"
+
+bool WirelessControl::is_connected = true;
+
+void WirelessControl::init_wifi(const char *ssid, const char *password, const char *hostname) {
+	is_connected = NativeHal::state().wifi_connected;
+}
+
+void WirelessControl::monitor() {
+	is_connected = NativeHal::state().wifi_connected;
+}
@@ -0,0 +1,16 @@
+#ifndef NATIVEHAL_WIRELESSCONTROL_H
+#define NATIVEHAL_WIRELESSCONTROL_H
+
+// Host stand-in for the shared WirelessControl; connectivity follows NativeHal::set_wifi_connected()
+
+#include <Arduino.h>
+
+class WirelessControl {
+    public:
+	static bool is_connected;
+
+	static void init_wifi(const char *ssid, const char *password, const char *hostname);
+	static void monitor();
+};
+
+#endif
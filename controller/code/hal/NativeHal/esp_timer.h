@@ -0,0 +1,12 @@
+#ifndef NATIVEHAL_ESP_TIMER_H
+#define NATIVEHAL_ESP_TIMER_H
+
+// The ESP-IDF high resolution timer, backed by NativeHal's virtual clock
+
+#include <Arduino.h>
+
+inline int64_t esp_timer_get_time() {
+	return NativeHal::now_us();
+}
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef WIFI_INFO_H
+#define WIFI_INFO_H
+
+// The real credentials stay out of the repository; the host build never connects anywhere
+
+#define WIFI_SSID "native"
+#define WIFI_PASSWORD "native"
+
+#endif
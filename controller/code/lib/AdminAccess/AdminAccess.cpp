@@ -1,10 +1,8 @@
 #include <AdminAccess.h>
 
-extern Logger *LOGGER;
-
 AdminAccess::AdminAccess(ExternalSettings *settings, ControlObjects *controls, SensorObjects *sensors, ClimateControl *climate)
      : _settings(settings), _controls(controls), _sensors(sensors), _climate(climate) {
-    LOGGER->log("Initializing AdminAccess");
+    LOG_INFO("Initializing AdminAccess");
     server = new AsyncWebServer(ADMIN_PORT);
 
     // Setup a handler for listning for commands on the WebSerial interface
@@ -14,7 +12,7 @@ AdminAccess::AdminAccess(ExternalSettings *settings, ControlObjects *controls, S
     WebSerial.begin(server);
     server->begin();
 
-    LOGGER->log("AdminAccess available at: http://" + WiFi.localIP().toString() + "/webserial");
+    LOG_INFO("AdminAccess available at: http://%s/webserial", WiFi.localIP().toString().c_str());
     Serial.println("AdminAccess available at: http://" + WiFi.localIP().toString() + "/webserial");
 }
 
@@ -29,7 +27,7 @@ void AdminAccess::onMessage(uint8_t *data, size_t len) {
     // Ignore commands we don't have a handler for
     if (cmd_triggers.find(cmd) == cmd_triggers.end()) {
         Serial.println("\tignoring unknown command");
-        LOGGER->log_error("Unknown AdminAccess command: " + String(cmd.c_str()));
+        LOG_ERROR("Unknown AdminAccess command: %s", cmd.c_str());
 
         WebSerial.println("Command not found.");
         print_help();
@@ -47,7 +45,7 @@ void AdminAccess::handle_commands() {
         if (pair.second) {
             WebSerial.println("Handling command");
             Serial.println("Got triggered: " + String(pair.first.c_str()));
-            LOGGER->log("Command run from AdminAccess: " + String(pair.first.c_str()));
+            LOG_INFO("Command run from AdminAccess: %s", pair.first.c_str());
             handlers[pair.first]("");
             cmd_triggers[pair.first] = false;
         }
@@ -91,20 +89,22 @@ void AdminAccess::print_status() {
 	WebSerial.println("Current Readings:");
 	Serial.println("Current Readings:");
 
-	WebSerial.printf("LEAD Sensor: temp: %.2fF, humidity: %.2f%%\n", _sensors->temphumid->current_temperature(), _climate->current_humidity());
-	Serial.printf("LEAD Sensor: temp: %.2fF, humidity: %.2f%%\n", _sensors->temphumid->current_temperature(), _sensors->temphumid->current_humidity());
+	// Read the lead sensor now; the probe and light values are from the last completed acquisition
+	_climate->sample_sensors();
+	const SensorSnapshot &snapshot = _climate->snapshot();
+
+	WebSerial.printf("LEAD Sensor: temp: %.2fF, humidity: %.2f%%%s\n", snapshot.temperature, snapshot.humidity, snapshot.valid ? "" : " (stale)");
+	Serial.printf("LEAD Sensor: temp: %.2fF, humidity: %.2f%%%s\n", snapshot.temperature, snapshot.humidity, snapshot.valid ? "" : " (stale)");
 
-	_sensors->temp->load_readings();
 	for (auto &sensor : _sensors->temp->sensors) {
 		WebSerial.printf("Sensor [%s]: temp: %.2fC\n", sensor.get_address_string().c_str(), sensor.temp);
 		Serial.printf("Sensor [%s]: temp: %.2fC\n", sensor.get_address_string().c_str(), sensor.temp);
 	}
 
-	_sensors->light->read();
 	WebSerial.printf("Light Sensor: full=%d, ir=%d, visible=%d, lux=%.2f lux\n",
-						_sensors->light->getFullLuminosity(), _sensors->light->getIR(), _sensors->light->getVisible(), _sensors->light->getLux());
+						snapshot.full_luminosity, snapshot.ir, snapshot.visible, snapshot.lux);
 	Serial.printf("Light Sensor: full=%d, ir=%d, visible=%d, lux=%.2f lux\n",
-						_sensors->light->getFullLuminosity(), _sensors->light->getIR(), _sensors->light->getVisible(), _sensors->light->getLux());
+						snapshot.full_luminosity, snapshot.ir, snapshot.visible, snapshot.lux);
 
     WebSerial.printf("- fan is: %s\n", _controls->fan->is_on() ? "ON" : "OFF");
     WebSerial.printf("- window is: %s\n", _controls->window->is_open() ? "OPEN" : "CLOSED");
@@ -118,4 +118,224 @@ void AdminAccess::print_delta() {
     WebSerial.printf("Short period temp delta (%d sec): %0.2f F\n", 
                      _settings->get_temp_short_delta_s(), _climate->get_short_temp_delta());
 
+    WebSerial.printf("Two point deltas: long %0.2f F, short %0.2f F\n",
+                     _climate->get_long_temp_two_point_delta(), _climate->get_short_temp_two_point_delta());
+
+    _print_trend("Long", _climate->get_long_temp_trend());
+    _print_trend("Short", _climate->get_short_temp_trend());
+}
+
+void AdminAccess::_print_trend(const char *name, const TrendEstimate &trend) {
+    WebSerial.printf("%s trend: %0.3f +/- %0.3f F/min, r2=%0.2f, %u samples%s\n", name,
+                     trend.rate_per_min, trend.stderr_per_min, trend.r_squared, trend.samples,
+                     trend.is_significant() ? "" : " (not significant)");
+}
+
+void AdminAccess::print_sensor_latency() {
+    const SensorAcquisition &acquisition = _climate->acquisition();
+
+    WebSerial.println("Sensor latency (last / mean / max ms):");
+    _print_latency("full acquisition", acquisition.cycle_latency());
+    _print_latency("DHT22", acquisition.dht_latency());
+    _print_latency("one-wire probes", acquisition.probe_latency());
+    _print_latency("light", acquisition.light_latency());
+    WebSerial.printf("Timeouts: %u\n", acquisition.timeouts());
+}
+
+void AdminAccess::print_jobs(const Scheduler *scheduler) {
+    WebSerial.println("Jobs (runs, late mean / max ms, run mean / max us):");
+    for (int id = 0; id < SCHEDULER_MAX_JOBS; id++) {
+        const SchedulerJob &job = scheduler->job(id);
+        if (!job.name) {
+            continue;
+        }
+
+        WebSerial.printf("- %s: %u, %u / %u, %u / %u, overruns %u, skipped %u", job.name, job.runs,
+                         job.mean_late_ms(), job.max_late_ms, job.mean_run_us(), job.max_run_us, job.overruns, job.skipped);
+        if (job.active) {
+            uint64_t now_ms = uptime_ms();
+            WebSerial.printf(", next in %lums\n", (unsigned long) (job.due_ms > now_ms ? job.due_ms - now_ms : 0));
+        } else {
+            WebSerial.println(", idle");
+        }
+    }
+}
+
+void AdminAccess::print_timing(const LatencyProbe *probes, size_t count) {
+    WebSerial.println("Timing since the last heartbeat (p50 / p90 / p99 / max):");
+    for (size_t i = 0; i < count; i++) {
+        LatencyHistogram histogram = probes[i].histogram->since(*probes[i].baseline);
+        WebSerial.printf("- %s: %s / %s / %s / %s (%u samples)\n", probes[i].name,
+                         LatencyHistogram::format_us(histogram.percentile(50)).c_str(),
+                         LatencyHistogram::format_us(histogram.percentile(90)).c_str(),
+                         LatencyHistogram::format_us(histogram.percentile(99)).c_str(),
+                         LatencyHistogram::format_us(histogram.max_us()).c_str(),
+                         histogram.count());
+    }
+}
+
+void AdminAccess::print_history(MetricStore *history) {
+    if (!history) {
+        WebSerial.println("History is disabled");
+        return;
+    }
+
+    struct SeriesSummary {
+        uint32_t count;
+        float min;
+        float max;
+        float latest;
+    } summaries[GORILLA_MAX_SERIES] = {};
+
+    uint32_t now = time(nullptr);
+    history->query(now - 24 * 3600, now, 0xFFFFFFFF, [&summaries](uint32_t ts, uint8_t series, float value) {
+        SeriesSummary &summary = summaries[series];
+        summary.min = summary.count == 0 || value < summary.min ? value : summary.min;
+        summary.max = summary.count == 0 || value > summary.max ? value : summary.max;
+        summary.latest = value;
+        summary.count++;
+        return true;
+    });
+
+    time_t oldest = history->oldest();
+    WebSerial.printf("History since %s", oldest ? ctime(&oldest) : "(empty)\n");
+    WebSerial.println(history->stats());
+    WebSerial.println("Last 24 hours (samples, min / max, latest):");
+    for (uint8_t series = 0; series < history->series_count(); series++) {
+        const SeriesSummary &summary = summaries[series];
+        WebSerial.printf("- %s: %u, %.2f / %.2f, %.2f\n", history->series_name(series), summary.count,
+                         summary.min, summary.max, summary.latest);
+    }
+}
+
+void AdminAccess::print_heap(const HeapMonitor *heap) {
+    HeapSnapshot snapshot = heap->snapshot();
+    WebSerial.printf("Heap: %u of %u bytes free, lowest ever %u\n", snapshot.free_bytes, snapshot.total_bytes, snapshot.min_free_bytes);
+    WebSerial.printf("Largest free block: %u bytes (%u%% fragmented), %u blocks allocated\n",
+                     snapshot.largest_block, snapshot.fragmentation_percent(), snapshot.allocated_blocks);
+
+    WebSerial.println("Stack never used:");
+    for (size_t i = 0; i < heap->task_count(); i++) {
+        WebSerial.printf("- %s: %u bytes\n", heap->task(i).name, heap->stack_free_bytes(i));
+    }
+
+    if (!COUNT_ALLOCATIONS) {
+        WebSerial.println("Allocations aren't counted in this build");
+        return;
+    }
+
+    WebSerial.printf("Allocations: %u, frees: %u, %llu bytes allocated in all\n", HeapMonitor::allocations(),
+                     HeapMonitor::frees(), (unsigned long long) HeapMonitor::allocated_bytes());
+    WebSerial.printf("Loop allocations since the last heartbeat: %.2f per pass, at most %u\n",
+                     heap->mean_loop_allocations(), heap->max_loop_allocations());
+
+    if (TRACK_ALLOCATIONS) {
+        WebSerial.println("Allocations by site (count, bytes):");
+        for (const HeapSite *site = HeapMonitor::sites(); site; site = site->next) {
+            WebSerial.printf("- %s: %u, %u\n", site->name, site->allocations.load(), site->bytes.load());
+        }
+    }
+}
+
+void AdminAccess::serve_history(MetricStore *history) {
+    server->on("/api/history/series", HTTP_GET, [history](AsyncWebServerRequest *request) {
+        String json = "{\"oldest\":" + String(history->oldest()) + ",\"series\":[";
+        for (uint8_t series = 0; series < history->series_count(); series++) {
+            json += String(series > 0 ? "," : "") + "\"" + history->series_name(series) + "\"";
+        }
+        json += "]}";
+
+        AsyncWebServerResponse *response = request->beginResponse(200, "application/json", json);
+        response->addHeader("Access-Control-Allow-Origin", "*");
+        request->send(response);
+    });
+
+    server->on("/api/history", HTTP_GET, [this, history](AsyncWebServerRequest *request) {
+        _send_history(request, history);
+    });
+
+    LOG_INFO("Serving metric history at http://%s/api/history", WiFi.localIP().toString().c_str());
+}
+
+void AdminAccess::serve_metrics(MetricsExporter *exporter) {
+    server->on("/metrics", HTTP_GET, [exporter](AsyncWebServerRequest *request) {
+        // The page is sent straight out of the exporter's buffer, so hold it until the response is done
+        if (!exporter->acquire()) {
+            AsyncWebServerResponse *response = request->beginResponse(503, "text/plain", "Busy, try again");
+            response->addHeader("Retry-After", "1");
+            request->send(response);
+            return;
+        }
+        request->onDisconnect([exporter]() { exporter->release(); });
+
+        size_t length = exporter->render();
+        request->send(request->beginResponse(200, METRICS_CONTENT_TYPE, (const uint8_t *) exporter->buffer(), length));
+    });
+
+    LOG_INFO("Serving metrics at http://%s/metrics", WiFi.localIP().toString().c_str());
+}
+
+void AdminAccess::_send_history(AsyncWebServerRequest *request, MetricStore *history) {
+    uint8_t series[GORILLA_MAX_SERIES];
+    uint8_t series_count = 0;
+
+    if (request->hasParam("series")) {
+        // Comma separated names
+        String names = request->getParam("series")->value();
+        int start = 0;
+        while (start <= (int) names.length() && series_count < GORILLA_MAX_SERIES) {
+            int end = names.indexOf(',', start);
+            if (end < 0) {
+                end = names.length();
+            }
+
+            String name = names.substring(start, end);
+            int id = history->find_series(name.c_str());
+            if (id < 0) {
+                request->send(404, "text/plain", "Unknown series: " + name);
+                return;
+            }
+            series[series_count++] = id;
+            start = end + 1;
+        }
+    } else {
+        for (series_count = 0; series_count < history->series_count(); series_count++) {
+            series[series_count] = series_count;
+        }
+    }
+
+    uint32_t to = request->hasParam("to") ? request->getParam("to")->value().toInt() : time(nullptr);
+    uint32_t from = request->hasParam("from") ? request->getParam("from")->value().toInt() : to - HISTORY_API_DEFAULT_RANGE_S;
+    long step = request->hasParam("step") ? request->getParam("step")->value().toInt() : HISTORY_API_DEFAULT_STEP_S;
+    bool binary = request->hasParam("format") && request->getParam("format")->value() == "binary";
+
+    if (series_count == 0 || from > to || step <= 0) {
+        request->send(400, "text/plain", "Expected at least one series, from <= to and step > 0");
+        return;
+    }
+
+    // Nothing is stored before the oldest sample or after now, so don't walk those steps
+    uint32_t now = time(nullptr);
+    uint32_t oldest = history->oldest();
+    if (to > now) {
+        to = now;
+    }
+    if (from < oldest) {
+        from = oldest;
+    }
+
+    // The stream is freed along with the response once it has all been sent
+    std::shared_ptr<HistoryStream> stream = std::make_shared<HistoryStream>(history, series, series_count, from, to, step,
+                                                                            binary ? HISTORY_BINARY : HISTORY_CSV);
+    AsyncWebServerResponse *response = request->beginChunkedResponse(binary ? "application/octet-stream" : "text/csv",
+        [stream](uint8_t *buffer, size_t max_len, size_t index) -> size_t {
+            return stream->read(buffer, max_len);
+        });
+    response->addHeader("Access-Control-Allow-Origin", "*");
+    request->send(response);
+}
+
+void AdminAccess::_print_latency(const char *name, const SensorLatency &latency) {
+    WebSerial.printf("- %s: %.1f / %.1f / %.1f (%u samples)\n", name,
+                     latency.last_us / 1000.0, latency.mean_us() / 1000.0, latency.max_us / 1000.0, latency.samples);
 }
@@ -7,15 +7,25 @@
 #include <map>
 #include <string>
 #include <functional>
+#include <memory>
 #include <string>
 
-#include "Logger.h"
+#include "LogQueue.h"
 #include "ClimateControl.h"
 #include "TimeHandler.h"
 #include "ExternalSettings.h"
+#include "Scheduler.h"
+#include "LatencyHistogram.h"
+#include "HistoryStream.h"
+#include "MetricsExporter.h"
+#include "HeapMonitor.h"
 
 #define ADMIN_PORT 80
 
+// Used by /api/history when the request leaves them out
+#define HISTORY_API_DEFAULT_RANGE_S (24 * 3600)
+#define HISTORY_API_DEFAULT_STEP_S 60
+
 class AdminAccess {
     private:
     AsyncWebServer *server;
@@ -27,6 +37,10 @@ class AdminAccess {
     SensorObjects *_sensors;
     ClimateControl *_climate;
 
+    void _print_latency(const char *name, const SensorLatency &latency);
+    void _print_trend(const char *name, const TrendEstimate &trend);
+    void _send_history(AsyncWebServerRequest *request, MetricStore *history);
+
     public:
     AdminAccess(ExternalSettings *settings, ControlObjects *controls, SensorObjects *sensors, ClimateControl *climate);
     void onMessage(uint8_t *data, size_t len);
@@ -37,6 +51,20 @@ class AdminAccess {
     void print_help();
     void print_status();
     void print_delta();
+    void print_sensor_latency();
+    void print_jobs(const Scheduler *scheduler);
+    void print_timing(const LatencyProbe *probes, size_t count);
+    void print_history(MetricStore *history);
+    void print_heap(const HeapMonitor *heap);
+
+    // Serve the stored history over HTTP:
+    //   GET /api/history/series  the series stored, as JSON
+    //   GET /api/history?series=DHT22/temperature,light/lux&from=<unix s>&to=<unix s>&step=<s>&format=csv|binary
+    // Everything but series may be left out; see HistoryStream for the formats.
+    void serve_history(MetricStore *history);
+
+    // Serve the current readings and stats for a Prometheus style scraper at GET /metrics
+    void serve_metrics(MetricsExporter *exporter);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,112 @@
+#include "ChunkedStream.h"
+
+ChunkedStream::ChunkedStream(Stream &source) : _source(source) {}
+
+// The socket's next byte, waiting up to its timeout for it to arrive
+int ChunkedStream::_source_read() {
+	char c;
+	return _source.readBytes(&c, 1) == 1 ? (uint8_t) c : -1;
+}
+
+// Read the CRLF ending the previous chunk, if any, and the size line of the next.  Returns
+// false at the end of the body.
+bool ChunkedStream::_next_chunk() {
+	char line[CHUNKED_MAX_SIZE_LINE];
+	size_t len = 0;
+
+	while (true) {
+		int c = _source_read();
+		if (c < 0) {
+			_done = true;
+			return false;
+		}
+		if (c == '\n') {
+			// Blank lines are the CRLF after the previous chunk's data
+			if (len == 0) {
+				continue;
+			}
+			break;
+		}
+		if (c != '\r' && len < sizeof(line) - 1) {
+			line[len++] = c;
+		}
+	}
+	line[len] = '\0';
+
+	// Anything after the hex size, e.g. ";name=value", is an extension
+	char *end;
+	unsigned long size = strtoul(line, &end, 16);
+	if (end == line) {
+		_done = true;
+		return false;
+	}
+
+	if (size == 0) {
+		// Skip the trailer, up to the blank line ending it
+		size_t trailer_len = 0;
+		int c;
+		while ((c = _source_read()) >= 0) {
+			if (c == '\n') {
+				if (trailer_len == 0) {
+					break;
+				}
+				trailer_len = 0;
+			} else if (c != '\r') {
+				trailer_len++;
+			}
+		}
+		_done = true;
+		_complete = c >= 0;
+		return false;
+	}
+
+	_remaining = size;
+	return true;
+}
+
+int ChunkedStream::_read_byte() {
+	if (_remaining == 0 && (_done || !_next_chunk())) {
+		return -1;
+	}
+
+	int c = _source_read();
+	if (c < 0) {
+		_done = true;
+		_remaining = 0;
+		return -1;
+	}
+	_remaining--;
+	return c;
+}
+
+int ChunkedStream::available() {
+	if (_peeked >= 0) {
+		return 1;
+	}
+	if (_done) {
+		return 0;
+	}
+	// A chunk boundary may still have data behind it
+	int buffered = _source.available();
+	return _remaining > 0 && (uint32_t) buffered > _remaining ? _remaining : buffered;
+}
+
+int ChunkedStream::read() {
+	if (_peeked >= 0) {
+		int c = _peeked;
+		_peeked = -1;
+		return c;
+	}
+	return _read_byte();
+}
+
+int ChunkedStream::peek() {
+	if (_peeked < 0) {
+		_peeked = _read_byte();
+	}
+	return _peeked;
+}
+
+bool ChunkedStream::complete() const {
+	return _complete && _peeked < 0;
+}
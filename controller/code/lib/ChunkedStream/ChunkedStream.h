@@ -0,0 +1,41 @@
+#ifndef CHUNKEDSTREAM_H
+#define CHUNKEDSTREAM_H
+
+#include <Arduino.h>
+
+// Longest chunk size line accepted, extensions and all
+#define CHUNKED_MAX_SIZE_LINE 32
+
+// Reads the body of a "Transfer-Encoding: chunked" response from the socket as plain bytes, so
+// a parser can work straight from the stream instead of the whole body being copied into a
+// String first.  Chunk extensions and trailers are skipped.  read() returns -1 at the end of the
+// body, or if the encoding is broken or the socket times out.
+class ChunkedStream : public Stream {
+    private:
+	Stream &_source;
+	// Bytes left in the current chunk
+	uint32_t _remaining = 0;
+	// Nothing more to read, and whether that's because the last chunk arrived
+	bool _done = false;
+	bool _complete = false;
+	int _peeked = -1;
+
+	int _source_read();
+	bool _next_chunk();
+	int _read_byte();
+
+    public:
+	ChunkedStream(Stream &source);
+
+	int available() override;
+	int read() override;
+	int peek() override;
+
+	size_t write(uint8_t c) override { return 0; }
+	using Print::write;
+
+	// Whether the whole body has been read, up to the terminating zero length chunk
+	bool complete() const;
+};
+
+#endif
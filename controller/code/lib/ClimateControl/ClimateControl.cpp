@@ -11,55 +11,144 @@
 #define REASON_HUMIDITY_LOW "Humidity below target threshold"
 #define REASON_HUMITIDY_OFF_PERIOD "Pausing after misting period"
 
-extern Logger *LOGGER;
-
 // TemperatureWindow class implementation
 
-TemperatureWindow::TemperatureWindow(size_t maxSize) : maxSize(maxSize) {}
+void RollupAccumulator::add(const TemperatureRollup &rollup) {
+	if (count == 0 || rollup.min < min) {
+		min = rollup.min;
+	}
+	if (count == 0 || rollup.max > max) {
+		max = rollup.max;
+	}
+	sum += rollup.mean;
+	count++;
+}
+
+TemperatureRollup RollupAccumulator::result() const {
+	return {min, max, count ? sum / count : 0};
+}
+
+void RollupAccumulator::reset() {
+	count = 0;
+	sum = 0;
+}
 
 void TemperatureWindow::addIfReady(float temp) {
-	long currentTime = millis();
-	if (currentTime - _last_collection_t >= TEMPERATURE_COLLECTION_PERIOD_S * 1000) {
+	uint64_t currentTime = uptime_ms();
+	if (!_collected || currentTime - _last_collection_ms >= TEMPERATURE_SAMPLE_PERIOD_S * 1000) {
 		addValue(temp);
-		_last_collection_t = currentTime;
+		_last_collection_ms = currentTime;
+		_collected = true;
 	}
 }
 
 void TemperatureWindow::addValue(float temp) {
-	if (data.size() >= maxSize) {
-		data.pop_front(); // remove oldest
+	_raw.push(temp);
+	_short_trend.add(temp);
+
+	// Roll raw samples up into minutes, and minutes up into ten minute buckets
+	_minute_acc.add({temp, temp, temp});
+	if (_minute_acc.count >= 60 / TEMPERATURE_SAMPLE_PERIOD_S) {
+		TemperatureRollup minute = _minute_acc.result();
+		_minutes.push(minute);
+		_long_trend.add(minute.mean);
+		_minute_acc.reset();
+
+		_ten_minute_acc.add(minute);
+		if (_ten_minute_acc.count >= 10) {
+			_ten_minutes.push(_ten_minute_acc.result());
+			_ten_minute_acc.reset();
+		}
 	}
-	data.push_back(temp); // add newest
 }
 
-const std::deque<float>& TemperatureWindow::getValues() const {
-	return data;
+bool TemperatureWindow::_valueAgo(uint32_t seconds, float &value) const {
+	// Use the finest resolution that reaches back far enough
+	uint32_t samples = seconds / TEMPERATURE_SAMPLE_PERIOD_S;
+	if (samples < _raw.size()) {
+		value = _raw.back(samples);
+		return true;
+	}
+
+	uint32_t minutes = seconds / 60;
+	if (minutes >= 1 && minutes <= _minutes.size()) {
+		value = _minutes.back(minutes - 1).mean;
+		return true;
+	}
+
+	uint32_t ten_minutes = seconds / 600;
+	if (ten_minutes >= 1 && ten_minutes <= _ten_minutes.size()) {
+		value = _ten_minutes.back(ten_minutes - 1).mean;
+		return true;
+	}
+
+	return false;
 }
 
-float TemperatureWindow::getDeltaOver(uint16_t seconds) const {
-	int minutes = seconds / 60;
-	if (minutes >= maxSize) {
-		//LOGGER->log_error("Requested a temp delta over a period longer than the history depth: " + String(minutes));
+float TemperatureWindow::getDeltaOver(uint32_t seconds) const {
+	float start_temp;
+	if (empty() || !_valueAgo(seconds, start_temp)) {
 		return 0;
 	}
 
-	if (minutes > data.size()) {
-		//LOGGER->log_error("Not enough data to calculate delta over " + String(minutes) + " minutes");
+	return latest() - start_temp;
+}
+
+float TemperatureWindow::getRateOver(uint32_t seconds) const {
+	if (seconds == 0) {
 		return 0;
 	}
+	return getDeltaOver(seconds) * 60 / seconds;
+}
+
+float TemperatureWindow::latest() const {
+	return _raw.empty() ? 0 : _raw.back();
+}
+
+bool TemperatureWindow::empty() const {
+	return _raw.empty();
+}
 
-	float start_temp = data[data.size() - 1 - minutes];
-	float current_temp = data.back();
-	return current_temp - start_temp;
+uint32_t TemperatureWindow::historySeconds() const {
+	uint32_t raw_s = _raw.size() ? (_raw.size() - 1) * TEMPERATURE_SAMPLE_PERIOD_S : 0;
+	uint32_t minutes_s = _minutes.size() * 60;
+	uint32_t ten_minutes_s = _ten_minutes.size() * 600;
+	return std::max(raw_s, std::max(minutes_s, ten_minutes_s));
+}
+
+void TemperatureWindow::setTrendHorizons(uint32_t short_seconds, uint32_t long_seconds) {
+	_short_trend.set_window(short_seconds / TEMPERATURE_SAMPLE_PERIOD_S);
+	_long_trend.set_window(long_seconds / 60);
+}
+
+TrendEstimate TemperatureWindow::getShortTrend() const {
+	return _short_trend.estimate();
+}
+
+TrendEstimate TemperatureWindow::getLongTrend() const {
+	return _long_trend.estimate();
+}
+
+const RingBuffer<float, TEMPERATURE_RAW_SAMPLES> &TemperatureWindow::raw() const {
+	return _raw;
+}
+
+const RingBuffer<TemperatureRollup, TEMPERATURE_MINUTE_SAMPLES> &TemperatureWindow::minutes() const {
+	return _minutes;
+}
+
+const RingBuffer<TemperatureRollup, TEMPERATURE_TEN_MINUTE_SAMPLES> &TemperatureWindow::tenMinutes() const {
+	return _ten_minutes;
 }
 
 // ClimateControl class implementation
 
 ClimateControl::ClimateControl(ExternalSettings *settings, SensorObjects *sensors, ControlObjects *controls) : _settings(settings), _sensors(sensors), _controls(controls) {
-  	LOGGER->log("Initializing ClimateControl");
+  	LOG_INFO("Initializing ClimateControl");
 
-	// Initialize the temp window object with the longest time period we need to capture.
-	_temp_window = new TemperatureWindow(_settings->get_temp_long_delta_s());
+	_config = _settings->current();
+
+	_acquisition = new SensorAcquisition(_sensors, &_snapshot);
 
   	// Set the initial temperature history
   	monitor();
@@ -76,33 +165,122 @@ void ClimateControl::disable_influx_collection() {
 	_influx = nullptr;
 }
 
+void ClimateControl::enable_history(MetricStore *history) {
+	_history = history;
+}
+
+void ClimateControl::_report(const char *sensor_id, const char *measurement, float value) {
+	if (_influx) {
+		_influx->write_sensor_metric(sensor_id, measurement, value);
+	}
+	if (_history) {
+		_history->record(sensor_id, measurement, value);
+	}
+}
+
 void ClimateControl::report_metrics() {
+	ALLOC_SITE("ClimateControl::report_metrics");
+
+	if (!_influx && !_history) {
+		return;
+	}
+
+	// Reuse this tick's lead sensor reading unless it has gone stale.  The one-wire and light
+	// readings are whatever the last acquisition collected.
+	if (!_snapshot.has_sample() || _snapshot.age_ms() >= MONITOR_PERIOD_MS) {
+		_snapshot.sample_climate(_sensors->temphumid);
+	}
+
+	if (_snapshot.temperature_valid) {
+		_report("DHT22", "temperature", _snapshot.temperature);
+	}
+	if (_snapshot.humidity_valid) {
+		_report("DHT22", "humidity", _snapshot.humidity);
+	}
+
+	if (_snapshot.probes_valid) {
+		for (auto &sensor : _sensors->temp->sensors) {
+			if (sensor.valid) {
+				_report(sensor.get_address_string().c_str(), "temperature", sensor.temp);
+			}
+		}
+	}
+
+	if (_snapshot.light_valid) {
+		_report("light", "full_luminosity", _snapshot.full_luminosity);
+		_report("light", "ir", _snapshot.ir);
+		_report("light", "visible", _snapshot.visible);
+		_report("light", "lux", _snapshot.lux);
+	}
+}
+
+void ClimateControl::report_fast_metrics() {
 	if (!_influx) {
 		return;
-	}	
+	}
 
-	_influx->write_sensor_metric("DHT22", "temperature", _sensors->temphumid->current_temperature());
-	_influx->write_sensor_metric("DHT22", "humidity", _sensors->temphumid->current_humidity());
-	
-	_sensors->temp->load_readings();
-	for (auto &sensor : _sensors->temp->sensors) {
-		_influx->write_sensor_metric(sensor.get_address_string().c_str(), "temperature", sensor.temp);
+	if (!_snapshot.has_sample() || _snapshot.age_ms() >= FAST_SAMPLE_PERIOD_MS) {
+		_snapshot.sample_climate(_sensors->temphumid);
+	}
+
+	if (_snapshot.temperature_valid) {
+		_influx->write_sensor_metric("DHT22", "temperature", _snapshot.temperature);
+	}
+	if (_snapshot.humidity_valid) {
+		_influx->write_sensor_metric("DHT22", "humidity", _snapshot.humidity);
 	}
 
-	_sensors->light->read();
-	_influx->write_sensor_metric("light", "full_luminosity", _sensors->light->getFullLuminosity());
-	_influx->write_sensor_metric("light", "ir", _sensors->light->getIR());
-	_influx->write_sensor_metric("light", "visible", _sensors->light->getVisible());
-	_influx->write_sensor_metric("light", "lux", _sensors->light->getLux());
+	if (_snapshot.light_valid) {
+		_influx->write_sensor_metric("light", "full_luminosity", _snapshot.full_luminosity);
+		_influx->write_sensor_metric("light", "ir", _snapshot.ir);
+		_influx->write_sensor_metric("light", "visible", _snapshot.visible);
+		_influx->write_sensor_metric("light", "lux", _snapshot.lux);
+	}
+}
+
+void ClimateControl::sample_sensors() {
+	_acquisition->start();
+}
+
+void ClimateControl::poll_sensors() {
+	_acquisition->poll();
+}
+
+void ClimateControl::set_sensor_poll_timer(std::function<void(uint32_t)> poll_timer) {
+	_acquisition->set_poll_timer(poll_timer);
+}
+
+const SensorAcquisition &ClimateControl::acquisition() const {
+	return *_acquisition;
+}
+
+const SensorSnapshot &ClimateControl::snapshot() const {
+	return _snapshot;
 }
 
 void ClimateControl::monitor() {
-	// Add a new temperature reading, if its time
-	_temp_window->addIfReady(_sensors->temphumid->current_temperature());
+	ALLOC_SITE("ClimateControl::monitor");
+
+	// Read the lead sensor and settings once; everything below decides from these copies.
+	// This also triggers the slower sensors, which poll_sensors() collects as they finish.
+	sample_sensors();
+	_config = _settings->current();
+	_temp_window.setTrendHorizons(_config.temp_short_delta_s, _config.temp_long_delta_s);
 
-	// See if we need to toggle any of the controls
-	_monitor_fan_control();
-	_monitor_window_control();
+	// Add a new temperature reading, if its time.  Don't record a stale fallback value.
+	if (_snapshot.temperature_valid) {
+		_temp_window.addIfReady(_snapshot.temperature);
+	}
+
+	_temperature_usable = _track_reading("temperature", _snapshot.temperature_valid, _temperature_misses);
+	_humidity_usable = _track_reading("humidity", _snapshot.humidity_valid, _humidity_misses);
+
+	// See if we need to toggle any of the controls.  Without a usable temperature the fan and
+	// window stay as they are.
+	if (_temperature_usable) {
+		_monitor_fan_control();
+		_monitor_window_control();
+	}
 	_monitor_mist_control();
 
 	// Periodically check on the window.  It takes some time to move and we don't get any feedback
@@ -111,6 +289,24 @@ void ClimateControl::monitor() {
 	_controls->window->monitor();
 }
 
+bool ClimateControl::_track_reading(const char *name, bool valid, uint32_t &misses) {
+	bool was_usable = misses <= CLIMATE_MAX_STALE_TICKS;
+	if (valid) {
+		misses = 0;
+	} else if (misses <= CLIMATE_MAX_STALE_TICKS) {
+		misses++;
+	}
+	bool usable = misses <= CLIMATE_MAX_STALE_TICKS;
+
+	// Only log the changes, not every tick in between
+	if (was_usable && !usable) {
+		LOG_ERROR("No valid %s reading, holding the controls until the sensor recovers", name);
+	} else if (!was_usable && usable) {
+		LOG_INFO("Valid %s reading again, resuming control", name);
+	}
+	return usable;
+}
+
 void ClimateControl::_monitor_mist_control() {
 	if (_is_mist_off_timer_active() || _is_mist_on_timer_active()) {
 		// One of either the "on" or "off" timer is active, so we don't need to do anything
@@ -119,7 +315,7 @@ void ClimateControl::_monitor_mist_control() {
 
 	// If we're here, no timers are active.  See if the "on" timer has just ended
 	if (_mist_on_timer_just_ended()) {
-		LOGGER->log_info("Misting period ended, watiing " + String(_settings->get_mist_off_ms() / 1000) + " seconds before checking humidity again");
+		LOG_INFO("Misting period ended, watiing %d seconds before checking humidity again", _config.mist_off_ms / 1000);
 		_influx && _influx->event_mist_off(REASON_HUMITIDY_OFF_PERIOD);
 
 		// It has, so turn off the misting
@@ -153,10 +349,10 @@ bool ClimateControl::_mist_on_timer_just_ended() {
 
 void ClimateControl::_mist_activate_on_timer() {
 	_mist_end_ms = 0;
-	_mist_start_ms = millis();
+	_mist_start_ms = uptime_ms();
 }
 void ClimateControl::_mist_activate_off_timer() {
-	_mist_end_ms = millis();
+	_mist_end_ms = uptime_ms();
 	_mist_start_ms = 0;
 }
 
@@ -167,7 +363,7 @@ bool ClimateControl::_is_mist_on_timer_active() {
 	}
 
 	// The timer is active if the current time is still less than the start time plus our "on" duration
-	return  millis() < _mist_start_ms + _settings->get_mist_on_ms();
+	return uptime_ms() - _mist_start_ms < (uint64_t) _config.mist_on_ms;
 }
 
 
@@ -178,7 +374,7 @@ bool ClimateControl::_is_mist_off_timer_active() {
 	}
 
 	// The timer is active if the current time is still less than the start time plus our "on" duration
-	return  millis() < _mist_end_ms + _settings->get_mist_off_ms();
+	return uptime_ms() - _mist_end_ms < (uint64_t) _config.mist_off_ms;
 }
 
 void ClimateControl::_monitor_fan_control() {
@@ -206,14 +402,14 @@ bool ClimateControl::_need_mist_on() {
 	}
 
 	// If the humidity is low, turn on the mist
-	if (_sensors->temphumid->current_humidity() < _settings->get_target_humidity()) {
-		LOGGER->log_info("Turning mist on (humidity): " + String(_sensors->temphumid->current_humidity()) + "% < " + String(_settings->get_target_humidity()) + "%");
+	if (_humidity_usable && _snapshot.humidity < _config.target_humidity) {
+		LOG_INFO("Turning mist on (humidity): %.2f%% < %.2f%%", _snapshot.humidity, _config.target_humidity);
 		_influx && _influx->event_mist_on(REASON_HUMIDITY_LOW);
 		return true;
 	}
 
-	if (over_max_temp()) {
-		LOGGER->log_info("Turning mist on (absolute): " + String(_sensors->temphumid->current_temperature()) + "F >= " + String(_settings->get_max_temp_f()) + "F");
+	if (_temperature_usable && over_max_temp()) {
+		LOG_INFO("Turning mist on (absolute): %.2fF >= %.2fF", _snapshot.temperature, _config.max_temp_f);
 		_influx && _influx->event_mist_on(REASON_OVER_MAX_TEMP);
 		return true;
 	}
@@ -234,13 +430,13 @@ bool ClimateControl::_need_fan_on() {
 
 	// If the temp is rising rapidly, or we're over our max temp, turn the fan on
     if (at_short_temp_rise_limit()) {
-		LOGGER->log_info("Turning fan on (short rise limit): rise of " + String(get_short_temp_delta()) + "F will exceed target in " + String(_settings->get_temp_short_delta_s()) + "s");
+		LOG_INFO("Turning fan on (short rise limit): rise of %.2fF will exceed target in %ds", get_short_temp_delta(), _config.temp_short_delta_s);
 		_influx && _influx->event_fan_on(REASON_SHORT_RISE);
 		return true;
 	}
 
 	if (over_max_temp()) {
-		LOGGER->log_info("Turning fan on (absolute): " + String(_sensors->temphumid->current_temperature()) + "F >= " + String(_settings->get_max_temp_f()) + "F");
+		LOG_INFO("Turning fan on (absolute): %.2fF >= %.2fF", _snapshot.temperature, _config.max_temp_f);
 		_influx && _influx->event_fan_on(REASON_OVER_MAX_TEMP);
         return true;
     }
@@ -256,13 +452,13 @@ bool ClimateControl::_need_fan_off() {
     
 	// If the temp is falling rapidly, or we're under our min temp, turn the fan off
     if (at_short_temp_fall_limit()) {
-		LOGGER->log_info("Turning fan off (short fall limit): fall of " + String(get_short_temp_delta()) + "F will fall below target in " + String(_settings->get_temp_short_delta_s()) + "s");
+		LOG_INFO("Turning fan off (short fall limit): fall of %.2fF will fall below target in %ds", get_short_temp_delta(), _config.temp_short_delta_s);
 		_influx && _influx->event_fan_off(REASON_SHORT_FALL);
 		return true;
 	}
 
 	if (under_min_temp()) {
-		LOGGER->log_info("Turning fan off (absolute): " + String(_sensors->temphumid->current_temperature()) + "F <= " + String(_settings->get_min_temp_f()) + "F");
+		LOG_INFO("Turning fan off (absolute): %.2fF <= %.2fF", _snapshot.temperature, _config.min_temp_f);
 		_influx && _influx->event_fan_off(REASON_UNDER_MIN_TEMP);
         return true;
     }
@@ -278,13 +474,13 @@ bool ClimateControl::_need_window_opened() {
 
     // Open the windows if we're at a long rise limit or over the max temp
     if (at_long_temp_rise_limit()) {
-		LOGGER->log_info("Opening window (long rise limit): " + String(get_long_temp_delta()) + "F will exceed target in " + String(_settings->get_temp_long_delta_s()) + "s");
+		LOG_INFO("Opening window (long rise limit): %.2fF will exceed target in %ds", get_long_temp_delta(), _config.temp_long_delta_s);
 		_influx && _influx->event_window_open(REASON_LONG_RISE);
 		return true;
 	}
 
 	if (over_max_temp()) {
-        LOGGER->log_info("Opening window (absolute): " + String(_sensors->temphumid->current_temperature()) + "F >= " + String(_settings->get_max_temp_f()) + "F");
+        LOG_INFO("Opening window (absolute): %.2fF >= %.2fF", _snapshot.temperature, _config.max_temp_f);
 		_influx && _influx->event_window_open(REASON_OVER_MAX_TEMP);
         return true;
     }
@@ -300,14 +496,14 @@ bool ClimateControl::_need_window_closed() {
 
     // Close unconditionally if temp is low enough
     if (at_long_temp_fall_limit()) {
-		LOGGER->log_info("Closing window (long fall limit): " + String(get_long_temp_delta()) + "F will fall below target in " + String(_settings->get_temp_long_delta_s()) + "s");
+		LOG_INFO("Closing window (long fall limit): %.2fF will fall below target in %ds", get_long_temp_delta(), _config.temp_long_delta_s);
 		_influx && _influx->event_window_closed(REASON_LONG_FALL);
         return true;
     }
 
     // After dropping below a threshold temp, check to see if we've been consistently falling before closing
     if (under_min_temp()) {
-		LOGGER->log_info("Closing window (absolute): " + String(_sensors->temphumid->current_temperature()) + "F <= " + String(_settings->get_min_temp_f()) + "F");
+		LOG_INFO("Closing window (absolute): %.2fF <= %.2fF", _snapshot.temperature, _config.min_temp_f);
 		_influx && _influx->event_window_closed(REASON_UNDER_MIN_TEMP);
         return true;
     }
@@ -316,19 +512,49 @@ bool ClimateControl::_need_window_closed() {
 }
 
 float ClimateControl::current_temperature() {
-	return _sensors->temphumid->current_temperature();
+	return _snapshot.temperature;
 }
 
 float ClimateControl::current_humidity() {
-	return _sensors->temphumid->current_humidity();
+	return _snapshot.humidity;
 }
 
 float ClimateControl::get_short_temp_delta() {
-	return _temp_window->getDeltaOver(_settings->get_temp_short_delta_s());
+	if (USE_TEMP_TREND) {
+		return _trend_delta(get_short_temp_trend(), _config.temp_short_delta_s);
+	}
+	return get_short_temp_two_point_delta();
 }
 
 float ClimateControl::get_long_temp_delta() {
-	return _temp_window->getDeltaOver(_settings->get_temp_long_delta_s());
+	if (USE_TEMP_TREND) {
+		return _trend_delta(get_long_temp_trend(), _config.temp_long_delta_s);
+	}
+	return get_long_temp_two_point_delta();
+}
+
+float ClimateControl::_trend_delta(const TrendEstimate &trend, uint32_t seconds) {
+	// A slope that isn't clearly separate from the noise is treated as no change at all
+	if (!trend.is_significant()) {
+		return 0;
+	}
+	return trend.change_over(seconds);
+}
+
+float ClimateControl::get_short_temp_two_point_delta() {
+	return _temp_window.getDeltaOver(_config.temp_short_delta_s);
+}
+
+float ClimateControl::get_long_temp_two_point_delta() {
+	return _temp_window.getDeltaOver(_config.temp_long_delta_s);
+}
+
+TrendEstimate ClimateControl::get_short_temp_trend() {
+	return _temp_window.getShortTrend();
+}
+
+TrendEstimate ClimateControl::get_long_temp_trend() {
+	return _temp_window.getLongTrend();
 }
 
 bool ClimateControl::at_short_temp_rise_limit() {
@@ -346,7 +572,7 @@ bool ClimateControl::_at_temp_rise_limit(float delta) {
 	}
 
 	// Check to see if the temperature will rise above the target temp in the next collection period at the current rate of rise.
-	if (_sensors->temphumid->current_temperature() + delta < _settings->get_target_temp_f()) {
+	if (_snapshot.temperature + delta < _config.target_temp_f) {
 		// It won't hit our target temp, so we don't need to take action
 		return false;
 	}
@@ -369,7 +595,7 @@ bool ClimateControl::_at_temp_fall_limit(float delta) {
 	}
 
 	// Check to see if the temperature will drop below the target temp in the next collection period at the current rate of fall.
-	if (_sensors->temphumid->current_temperature() + delta > _settings->get_target_temp_f()) {
+	if (_snapshot.temperature + delta > _config.target_temp_f) {
 		return false;
 	}
 
@@ -377,9 +603,9 @@ bool ClimateControl::_at_temp_fall_limit(float delta) {
 }
 
 bool ClimateControl::over_max_temp() {
-	return _sensors->temphumid->current_temperature() > _settings->get_max_temp_f();
+	return _snapshot.temperature > _config.max_temp_f;
 }
 
 bool ClimateControl::under_min_temp() {
-	return _sensors->temphumid->current_temperature() < _settings->get_min_temp_f();
+	return _snapshot.temperature < _config.min_temp_f;
 }
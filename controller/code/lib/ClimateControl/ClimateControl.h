@@ -2,33 +2,103 @@
 #define CLIMATECONTROL_H
 
 #include <Arduino.h>
-#include <deque>
 
-#include "Logger.h"
+#include "LogQueue.h"
+#include "Clock.h"
+#include "HeapMonitor.h"
 #include "TempHumiditySensor.h"
 #include "ExternalSettings.h"
 #include "monitor.h"
 #include "InfluxDBHandler.h"
+#include "MetricStore.h"
+#include "SensorSnapshot.h"
+#include "SensorAcquisition.h"
+#include "RingBuffer.h"
+#include "TrendEstimator.h"
+
+// How often to collect temperature data, e.g. once every TEMPERATURE_SAMPLE_PERIOD_S
+#define TEMPERATURE_SAMPLE_PERIOD_S 10
+
+// History kept at each resolution.  Together these cover 28 hours in about 4KB.
+#define TEMPERATURE_RAW_SAMPLES 90          // 15 minutes of raw samples
+#define TEMPERATURE_MINUTE_SAMPLES 120      // 2 hours of 1 minute rollups
+#define TEMPERATURE_TEN_MINUTE_SAMPLES 168  // 28 hours of 10 minute rollups
+
+// Decide on rises and falls from a least squares trend rather than the difference between two
+// single samples, so one noisy reading can't trigger the fan or window
+#ifndef USE_TEMP_TREND
+#define USE_TEMP_TREND true
+#endif
+
+// After a failed read the lead sensor reports its last good value.  Decisions go on using it for
+// this many ticks, then the actuators are held where they are until a read succeeds again.
+#ifndef CLIMATE_MAX_STALE_TICKS
+#define CLIMATE_MAX_STALE_TICKS 3
+#endif
+
+struct TemperatureRollup {
+	float min;
+	float max;
+	float mean;
+};
+
+// Combines samples or finer rollups into the next coarser rollup
+struct RollupAccumulator {
+	float min = 0;
+	float max = 0;
+	float sum = 0;
+	uint16_t count = 0;
 
-// How often to collect temperature data, e.g. once every TEMPERATURE_COLLECTION_PERIOD_S
-#define TEMPERATURE_COLLECTION_PERIOD_S 60
+	void add(const TemperatureRollup &rollup);
+	TemperatureRollup result() const;
+	void reset();
+};
 
+// Temperature history at several resolutions in fixed size rings.  Raw samples are rolled up
+// into 1 minute and then 10 minute min/max/mean buckets as they arrive, so lookups are a
+// single index into whichever ring covers the requested period.
 class TemperatureWindow {
 public:
-    TemperatureWindow(size_t maxSize);
-
 	void addIfReady(float temp);
 
     void addValue(float temp);
 
-    const std::deque<float>& getValues() const;
+	// Change between the newest sample and the one 'seconds' ago, or 0 if there isn't that much history
+	float getDeltaOver(uint32_t seconds) const;
+
+	// Average rate of change over the period, in degrees per minute
+	float getRateOver(uint32_t seconds) const;
 
-	float getDeltaOver(uint16_t seconds) const;
+	float latest() const;
+	bool empty() const;
+
+	// Longest period getDeltaOver() can currently answer
+	uint32_t historySeconds() const;
+
+	const RingBuffer<float, TEMPERATURE_RAW_SAMPLES> &raw() const;
+	const RingBuffer<TemperatureRollup, TEMPERATURE_MINUTE_SAMPLES> &minutes() const;
+	const RingBuffer<TemperatureRollup, TEMPERATURE_TEN_MINUTE_SAMPLES> &tenMinutes() const;
+
+	// Fit the short trend over raw samples and the long trend over minute means
+	void setTrendHorizons(uint32_t short_seconds, uint32_t long_seconds);
+	TrendEstimate getShortTrend() const;
+	TrendEstimate getLongTrend() const;
 
 private:
-    std::deque<float> data;
-    size_t maxSize;
-	long _last_collection_t = 0;
+	RingBuffer<float, TEMPERATURE_RAW_SAMPLES> _raw;
+	RingBuffer<TemperatureRollup, TEMPERATURE_MINUTE_SAMPLES> _minutes;
+	RingBuffer<TemperatureRollup, TEMPERATURE_TEN_MINUTE_SAMPLES> _ten_minutes;
+
+	RollupAccumulator _minute_acc;
+	RollupAccumulator _ten_minute_acc;
+
+	TrendEstimator<TEMPERATURE_RAW_SAMPLES> _short_trend{TEMPERATURE_SAMPLE_PERIOD_S};
+	TrendEstimator<TEMPERATURE_MINUTE_SAMPLES> _long_trend{60};
+
+	uint64_t _last_collection_ms = 0;
+	bool _collected = false;
+
+	bool _valueAgo(uint32_t seconds, float &value) const;
 };
 
 
@@ -36,19 +106,35 @@ class ClimateControl {
     private:
 	bool _at_temp_rise_limit(float delta);
 	bool _at_temp_fall_limit(float delta);
+	float _trend_delta(const TrendEstimate &trend, uint32_t seconds);
 
-	TemperatureWindow *_temp_window;
+	TemperatureWindow _temp_window;
 
 	// Keep track of how long the mist has been on and off
-	long _mist_start_ms = 0;
-	long _mist_end_ms = 0;
+	uint64_t _mist_start_ms = 0;
+	uint64_t _mist_end_ms = 0;
 
 	ExternalSettings *_settings;
 	SensorObjects *_sensors;
 	ControlObjects *_controls;
 
+	// Readings and settings taken at the start of the current tick
+	SensorSnapshot _snapshot;
+	Settings _config;
+	SensorAcquisition *_acquisition;
+
+	// Ticks since each reading was last valid.  They start out of grace, so nothing is decided
+	// from the sensor's initial value before its first good read.
+	uint32_t _temperature_misses = CLIMATE_MAX_STALE_TICKS;
+	uint32_t _humidity_misses = CLIMATE_MAX_STALE_TICKS;
+	bool _temperature_usable = false;
+	bool _humidity_usable = false;
+
 	InfluxDBHandler *_influx = nullptr;
+	MetricStore *_history = nullptr;
 
+	void _report(const char *sensor_id, const char *measurement, float value);
+	bool _track_reading(const char *name, bool valid, uint32_t &misses);
 	void _monitor_fan_control();
 	void _monitor_window_control();
 	void _monitor_mist_control();
@@ -76,18 +162,41 @@ class ClimateControl {
 	void enable_influx_collection(InfluxDBHandler *influx);
 	void disable_influx_collection();
 
+	// Also keep the reported metrics on the device
+	void enable_history(MetricStore *history);
+
 	// Monitor the current temperature and humidity, and make decisions about fan and window control
 	// based on the current temperature and humidity
 
 	void report_metrics();
+	// Just the DHT22 and light readings, for sending between collections.  Only goes to
+	// InfluxDB; the history keeps to the collection period.
+	void report_fast_metrics();
 	void monitor();
 
+	// Start a sensor acquisition, reading the lead sensor immediately
+	void sample_sensors();
+	// Collect slower sensors as they finish.  Either call on every loop pass, or run it when
+	// asked to through set_sensor_poll_timer().
+	void poll_sensors();
+	void set_sensor_poll_timer(std::function<void(uint32_t)> poll_timer);
+	const SensorSnapshot &snapshot() const;
+	const SensorAcquisition &acquisition() const;
+
     float current_temperature();
     float current_humidity();
 
+	// Expected change over the short and long periods; from the trend when USE_TEMP_TREND is set
 	float get_short_temp_delta();
 	float get_long_temp_delta();
 
+	// Difference between the newest sample and the one a period ago
+	float get_short_temp_two_point_delta();
+	float get_long_temp_two_point_delta();
+
+	TrendEstimate get_short_temp_trend();
+	TrendEstimate get_long_temp_trend();
+
 	bool at_short_temp_rise_limit();
 	bool at_short_temp_fall_limit();
 	bool at_long_temp_rise_limit();
@@ -0,0 +1,19 @@
+#include "Clock.h"
+#include <esp_timer.h>
+
+static SystemClock SYSTEM_CLOCK;
+static Clock *ACTIVE_CLOCK = nullptr;
+
+Clock *Clock::get() {
+	// Checked here rather than initialised statically, since other globals read the clock
+	// while they are being constructed
+	return ACTIVE_CLOCK ? ACTIVE_CLOCK : &SYSTEM_CLOCK;
+}
+
+void Clock::set(Clock *clock) {
+	ACTIVE_CLOCK = clock;
+}
+
+uint64_t SystemClock::now_us() {
+	return esp_timer_get_time();
+}
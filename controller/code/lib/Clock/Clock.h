@@ -0,0 +1,39 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <Arduino.h>
+
+// Monotonic time since boot, in 64 bits so it never wraps.  millis() is 32 bits and rolls over
+// after 49.7 days, which breaks any `millis() < start + period` style comparison; read time
+// through uptime_ms()/uptime_us() instead.
+//
+// The clock in use can be replaced with Clock::set(), e.g. to run the controls faster than real
+// time.  By default it is the ESP32's esp_timer, which the native build fakes with NativeHal's
+// virtual clock.
+class Clock {
+    public:
+	virtual ~Clock() {}
+	virtual uint64_t now_us() = 0;
+
+	uint64_t now_ms() {
+		return now_us() / 1000;
+	}
+
+	static Clock *get();
+	static void set(Clock *clock);
+};
+
+class SystemClock : public Clock {
+    public:
+	uint64_t now_us() override;
+};
+
+inline uint64_t uptime_us() {
+	return Clock::get()->now_us();
+}
+
+inline uint64_t uptime_ms() {
+	return Clock::get()->now_ms();
+}
+
+#endif
@@ -1,67 +1,205 @@
 #include "ExternalSettings.h"
 #include <HTTPClient.h>
 
-#define HTTP_TIMEOUT 5000
-#define HTTP_CONNECT_TIMEOUT 3000
+// Every key read from the settings document; anything else is skipped while parsing
+static const char *const SETTINGS_KEYS[] = {
+	"target_temp_f", "max_temp_f", "min_temp_f",
+	"temp_long_detla_s", "temp_short_detla_s",
+	"target_humidity", "mist_on_s", "mist_off_s",
+};
 
-extern Logger *LOGGER;
+Settings Settings::defaults() {
+	Settings settings;
+	settings.target_temp_f = DEFAULT_TARGET_TEMP_F;
+	settings.max_temp_f = DEFAULT_MAX_TEMP_F;
+	settings.min_temp_f = DEFAULT_MIN_TEMP_F;
+	settings.temp_long_delta_s = DEFAULT_TEMP_LONG_DETLA_S;
+	settings.temp_short_delta_s = DEFAULT_TEMP_SHORT_DETLA_S;
+	settings.target_humidity = DEFAULT_TARGET_HUMIDITY;
+	settings.mist_on_s = DEFAULT_MIST_ON_S;
+	settings.mist_off_s = DEFAULT_MIST_OFF_S;
+	settings.mist_on_ms = settings.mist_on_s * 1000;
+	settings.mist_off_ms = settings.mist_off_s * 1000;
+	return settings;
+}
+
+const char *Settings::validate() const {
+	if (min_temp_f > target_temp_f || target_temp_f > max_temp_f) {
+		return "temperatures must satisfy min_temp_f <= target_temp_f <= max_temp_f";
+	}
+	if (temp_short_delta_s <= 0 || temp_long_delta_s <= 0) {
+		return "temperature delta periods must be positive";
+	}
+	if (temp_short_delta_s > temp_long_delta_s) {
+		return "temp_short_detla_s must not be longer than temp_long_detla_s";
+	}
+	if (target_humidity < 0 || target_humidity > 100) {
+		return "target_humidity must be between 0 and 100";
+	}
+	if (mist_on_s <= 0 || mist_off_s <= 0) {
+		return "mist on and off periods must be positive";
+	}
+	return nullptr;
+}
+
+ExternalSettings::ExternalSettings(String host, uint16_t port, String path) : _host(host), _port(port), _path(path), _connection("settings", host, port) {
+	_settings = Settings::defaults();
+	_build_filter();
+}
+
+Settings ExternalSettings::current() const {
+	Settings settings;
+	uint32_t sequence;
 
-HTTPClient HTTP;
+	do {
+		// Wait out a reload that is in progress, then copy and make sure none started meanwhile
+		while ((sequence = _sequence.load(std::memory_order_acquire)) & 1) {
+			// The network task may have been preempted mid-reload on this core; spinning would
+			// keep it from finishing until the next tick
+			taskYIELD();
+		}
+		settings = _settings;
+		std::atomic_thread_fence(std::memory_order_acquire);
+	} while (sequence != _sequence.load(std::memory_order_relaxed));
 
-ExternalSettings::ExternalSettings(String host, uint16_t port, String path) : _host(host), _port(port), _path(path) {
-	_reset_connection();
+	return settings;
 }
 
-void ExternalSettings::_reset_connection() {
-	HTTP.end();
-	HTTP.begin(_host, _port, _path);
-	HTTP.setTimeout(HTTP_TIMEOUT);
-	HTTP.setConnectTimeout(HTTP_CONNECT_TIMEOUT);
+void ExternalSettings::_publish(const Settings &settings) {
+	_sequence.fetch_add(1, std::memory_order_acq_rel);
+	_settings = settings;
+	_sequence.fetch_add(1, std::memory_order_release);
+}
+
+bool ExternalSettings::_load(JsonDocument &doc) {
+	// Missing keys fall back to the compiled-in defaults
+	Settings defaults = Settings::defaults();
+	Settings settings;
+
+	settings.target_temp_f = doc["target_temp_f"] | defaults.target_temp_f;
+	settings.max_temp_f = doc["max_temp_f"] | defaults.max_temp_f;
+	settings.min_temp_f = doc["min_temp_f"] | defaults.min_temp_f;
+	settings.temp_long_delta_s = doc["temp_long_detla_s"] | defaults.temp_long_delta_s;
+	settings.temp_short_delta_s = doc["temp_short_detla_s"] | defaults.temp_short_delta_s;
+	settings.target_humidity = doc["target_humidity"] | defaults.target_humidity;
+	settings.mist_on_s = doc["mist_on_s"] | defaults.mist_on_s;
+	settings.mist_off_s = doc["mist_off_s"] | defaults.mist_off_s;
+	settings.mist_on_ms = settings.mist_on_s * 1000;
+	settings.mist_off_ms = settings.mist_off_s * 1000;
+
+	const char *problem = settings.validate();
+	if (problem) {
+		LOG_ERROR("Rejecting external settings, keeping previous values: %s", problem);
+		return false;
+	}
+
+	_publish(settings);
+	return true;
+}
+
+HTTPClient *ExternalSettings::_begin_request() {
+	String address = _host;
+	if (_resolver && _resolver->resolve(_host, address) == RESOLVE_FAILED) {
+		return nullptr;
+	}
+	_connection.set_address(address);
+
+	HTTPClient *http = _connection.begin(_path);
+	if (!http) {
+		return nullptr;
+	}
+
+	const char* headerNames[] = {"Last-Modified", "ETag", "Transfer-Encoding"};
+	http->collectHeaders(headerNames, sizeof(headerNames)/sizeof(headerNames[0]));
+	return http;
+}
 
-	const char* headerNames[] = {"Last-Modified"};
-	HTTP.collectHeaders(headerNames, sizeof(headerNames)/sizeof(headerNames[0]));
+void ExternalSettings::_build_filter() {
+	for (size_t i = 0; i < sizeof(SETTINGS_KEYS)/sizeof(SETTINGS_KEYS[0]); i++) {
+		_filter[SETTINGS_KEYS[i]] = true;
+	}
 }
 
 void ExternalSettings::monitor() {
-    _reset_connection();
+	ALLOC_SITE("ExternalSettings::monitor");
 
-	Serial.println("Fetching external settings ...");
+	// A host that didn't resolve, or a server that recently couldn't be reached, is retried
+	// later; trying now would only block
+	HTTPClient *http = _begin_request();
+	if (!http) {
+		LOG_DEBUG("Settings server unavailable, skipping fetch");
+		return;
+	}
 
-	int httpCode = HTTP.GET();
+	_fetch(http);
+	_connection.end();
+}
+
+void ExternalSettings::_fetch(HTTPClient *http) {
+	// Let the server answer 304 with no body when nothing has changed
+	if (_last_modified.length() > 0) {
+		http->addHeader("If-Modified-Since", _last_modified);
+	}
+	if (_etag.length() > 0) {
+		http->addHeader("If-None-Match", _etag);
+	}
+
+	int httpCode = _connection.send("GET");
 	
 	// Check for timeout or connection errors
-	if (httpCode == HTTPC_ERROR_CONNECTION_REFUSED || 
-	    httpCode == HTTPC_ERROR_SEND_HEADER_FAILED || 
-	    httpCode == HTTPC_ERROR_SEND_PAYLOAD_FAILED || 
-	    httpCode == HTTPC_ERROR_NOT_CONNECTED || 
-	    httpCode == HTTPC_ERROR_CONNECTION_LOST || 
-	    httpCode == HTTPC_ERROR_READ_TIMEOUT) {
-		LOGGER->log_error("HTTP request failed/timed out: " + String(httpCode));
-		Serial.printf("HTTP request failed/timed out: %d\n", httpCode);
+	if (httpCode < 0) {
+		LOG_ERROR("Settings request failed/timed out: %d", httpCode);
 		return;
 	}
 
-	String lastModified = HTTP.header("Last-Modified");
+	if (httpCode == HTTP_CODE_NOT_MODIFIED) {
+		return;
+	}
 
-	if (_last_modified == lastModified) {
-		Serial.println("No changes detected, skipping update.");
+	if (httpCode != HTTP_CODE_OK) {
+		LOG_ERROR("Unexpected HTTP response fetching settings: %d", httpCode);
 		return;
 	}
 
-	_last_modified = lastModified;
-	Serial.printf("Response %d received, last modified: %s\n", httpCode, lastModified.c_str());
-	LOGGER->log("Updated external settings content detected, reloading ...");
+	String lastModified = http->header("Last-Modified");
+	String etag = http->header("ETag");
+
+	// Servers that ignore conditional requests still send the validators, so check them here too
+	if ((lastModified.length() > 0 && _last_modified == lastModified) || (etag.length() > 0 && _etag == etag)) {
+		return;
+	}
 
-	String response = HTTP.getString();
+	LOG_INFO("Updated external settings detected (last modified: %s), reloading ...", lastModified.c_str());
 
-	// Clean up previous readings be for we deserialize the JSON document
-	_doc.clear();
-  	DeserializationError error = deserializeJson(_doc, response);
+	// Parse from the socket, keeping only the keys we know about.  The document is only
+	// needed long enough to compile it into a Settings struct.  A chunked body is decoded on
+	// the way, and read to the end so the next request on the socket starts clean.
+	JsonDocument doc;
+	DeserializationError error;
+	if (http->header("Transfer-Encoding").equalsIgnoreCase("chunked")) {
+		ChunkedStream body(http->getStream());
+		error = deserializeJson(doc, body, DeserializationOption::Filter(_filter));
+		while (body.read() >= 0) {
+		}
+		// Whatever is left of a broken body would be taken for the next response
+		if (!body.complete()) {
+			_connection.close();
+		}
+	} else {
+		error = deserializeJson(doc, http->getStream(), DeserializationOption::Filter(_filter));
+	}
 
 	// Test if parsing succeeds
 	if (error) {
-		LOGGER->log_error("deserializeJson() failed: " + String(error.f_str()));
-		Serial.println("deserializeJson() failed: " + String(error.f_str()));
+		LOG_ERROR("deserializeJson() failed: %s", error.c_str());
 		return;
 	}
+
+	if (!_load(doc)) {
+		return;
+	}
+
+	// Only remember the validators once the document has been applied, so a failed read is retried
+	_last_modified = lastModified;
+	_etag = etag;
 }
@@ -2,9 +2,14 @@
 #define EXTERNALSETTINGS_H
 
 #include <Arduino.h>
+#include <atomic>
 
-#include "Logger.h"
+#include "LogQueue.h"
+#include "HeapMonitor.h"
 #include "ArduinoJson.h"
+#include "HostResolver.h"
+#include "ChunkedStream.h"
+#include "HttpConnection.h"
 
 // Temp we want the greenhouse
 #define DEFAULT_TARGET_TEMP_F 70.0
@@ -21,77 +26,109 @@
 #define DEFAULT_MIST_ON_S 30
 #define DEFAULT_MIST_OFF_S 2*60
 
+// All settings, parsed and validated once when the settings document changes.  This is a plain
+// struct so readers can copy it and use its fields without touching the JSON document.
+struct Settings {
+	float target_temp_f;
+	float max_temp_f;
+	float min_temp_f;
+
+	int temp_long_delta_s;
+	int temp_short_delta_s;
+
+	float target_humidity;
+	int mist_on_s;
+	int mist_off_s;
+
+	// Derived once at load time so the control loop doesn't have to
+	int mist_on_ms;
+	int mist_off_ms;
+
+	static Settings defaults();
+
+	// Returns nullptr if the settings are consistent, otherwise a description of the first problem
+	const char *validate() const;
+};
+
 class ExternalSettings {
     private:
 	String _last_modified = "";
-	JsonDocument _doc;
+	String _etag = "";
+	JsonDocument _filter;
 	String _host;
 	uint16_t _port;
 	String _path;
+	HostResolver *_resolver = nullptr;
+	HttpConnection _connection;
+
+	// The active settings.  Guarded by a sequence counter: odd while a reload is being
+	// written, so a reader that overlaps a reload retries rather than seeing a partial update.
+	Settings _settings;
+	std::atomic<uint32_t> _sequence{0};
 
-	void _reset_connection();
+	HTTPClient *_begin_request();
+	void _fetch(HTTPClient *http);
+	void _build_filter();
+	bool _load(JsonDocument &doc);
+	void _publish(const Settings &settings);
 
     public:
 
     ExternalSettings(String host, uint16_t port, String path);
 
+	// Connect by cached address rather than resolving the settings host on every fetch
+	void set_resolver(HostResolver *resolver) {
+		_resolver = resolver;
+	}
 
 	void monitor();
 
-	template <typename T>
-	T get(const String &key, T defaultValue) {
-		if (_doc.isNull()) {
-			Serial.println("Error: JSON document is not initialized.");
-			return defaultValue;
-		}
-
-		if (_doc[key].isNull()) {
-			Serial.printf("Warning: Key '%s' not found in JSON document, returning default value\n", key.c_str());
-			return defaultValue;
-		} else {
-			return _doc[key].as<T>();
-		}
+	const HttpConnection &connection() const {
+		return _connection;
 	}
 
+	// Copy of the active settings.  Take one per tick and read its fields directly.
+	Settings current() const;
+
 	// Explicitly provide methods for all expected values
-	float get_target_temp_f() {
-		return get<float>("target_temp_f", DEFAULT_TARGET_TEMP_F);
+	float get_target_temp_f() const {
+		return current().target_temp_f;
 	}
 
-	float get_max_temp_f() {
-		return get<float>("max_temp_f", DEFAULT_MAX_TEMP_F);
+	float get_max_temp_f() const {
+		return current().max_temp_f;
 	}
 
-	float get_min_temp_f() {
-		return get<float>("min_temp_f", DEFAULT_MIN_TEMP_F);
+	float get_min_temp_f() const {
+		return current().min_temp_f;
 	}
 
-	int get_temp_long_delta_s() {
-		return get<int>("temp_long_detla_s", DEFAULT_TEMP_LONG_DETLA_S);
+	int get_temp_long_delta_s() const {
+		return current().temp_long_delta_s;
 	}
 
-	int get_temp_short_delta_s() {
-		return get<int>("temp_short_detla_s", DEFAULT_TEMP_SHORT_DETLA_S);
+	int get_temp_short_delta_s() const {
+		return current().temp_short_delta_s;
 	}
 
-	float get_target_humidity() {
-		return get<float>("target_humidity", DEFAULT_TARGET_HUMIDITY);
+	float get_target_humidity() const {
+		return current().target_humidity;
 	}
 
-	int get_mist_on_s() {
-		return get<int>("mist_on_s", DEFAULT_MIST_ON_S);
+	int get_mist_on_s() const {
+		return current().mist_on_s;
 	}
 
-	int get_mist_on_ms() {
-		return get_mist_on_s() * 1000;
+	int get_mist_on_ms() const {
+		return current().mist_on_ms;
 	}
 
-	int get_mist_off_s() {
-		return get<int>("mist_off_s", DEFAULT_MIST_OFF_S);
+	int get_mist_off_s() const {
+		return current().mist_off_s;
 	}
 
-	int get_mist_off_ms() {
-		return get_mist_off_s() * 1000;
+	int get_mist_off_ms() const {
+		return current().mist_off_ms;
 	}
 };
 
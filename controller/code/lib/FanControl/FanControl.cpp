@@ -1,9 +1,7 @@
 #include <FanControl.h>
 
-extern Logger *LOGGER;
-
 FanControl::FanControl(uint8_t pin) : _control_pin(pin) {
-        LOGGER->log("Initializing FanControl");
+        LOG_INFO("Initializing FanControl");
         pinMode(_control_pin, OUTPUT);
         turn_off();
     }
@@ -11,13 +9,13 @@ FanControl::FanControl(uint8_t pin) : _control_pin(pin) {
 void FanControl::turn_on() {
     digitalWrite(_control_pin, HIGH);
     _is_on = true;
-    LOGGER->log("Fan turned on");
+    LOG_INFO("Fan turned on");
 }
 
 void FanControl::turn_off() {
     digitalWrite(_control_pin, LOW);
     _is_on = false;
-    LOGGER->log("Fan turned off");
+    LOG_INFO("Fan turned off");
 }
 
 bool FanControl::is_on() {
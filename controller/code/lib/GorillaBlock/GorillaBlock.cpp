@@ -0,0 +1,345 @@
+#include "GorillaBlock.h"
+
+static_assert(sizeof(GorillaBlockHeader) == 20, "GorillaBlockHeader must pack to 20 bytes");
+
+// A timestamp delta-of-delta other than zero is written as one of these prefixes followed by
+// the value in the matching number of bits
+static const uint8_t DOD_PREFIX[] = {0b10, 0b110, 0b1110, 0b1111};
+static const uint8_t DOD_PREFIX_BITS[] = {2, 3, 4, 4};
+static const uint8_t DOD_BITS[] = {7, 9, 12, 32};
+
+static uint8_t leading_zeros(uint32_t value) {
+	return value == 0 ? 32 : __builtin_clz(value);
+}
+
+static uint8_t trailing_zeros(uint32_t value) {
+	return value == 0 ? 32 : __builtin_ctz(value);
+}
+
+static uint32_t float_bits(float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+static float bits_float(uint32_t bits) {
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+static void clear_state(GorillaState &state) {
+	memset(&state, 0, sizeof(state));
+}
+
+//----------------------------------------------------
+// GorillaBlock
+
+GorillaBlock::GorillaBlock() {
+	static_assert(sizeof(_block) == GORILLA_BLOCK_BYTES, "GorillaBlock must be exactly one block");
+	reset(0);
+}
+
+void GorillaBlock::reset(uint32_t sequence) {
+	memset(&_block, 0, sizeof(_block));
+	_block.header.magic = GORILLA_MAGIC;
+	_block.header.sequence = sequence;
+	clear_state(_state);
+}
+
+bool GorillaBlock::_write_bits(uint32_t &pos, uint32_t value, uint8_t count) {
+	if (pos + count > GORILLA_DATA_BYTES * 8) {
+		return false;
+	}
+
+	// Most significant bit first
+	for (int i = count - 1; i >= 0; i--) {
+		if ((value >> i) & 1) {
+			_block.data[pos >> 3] |= 0x80 >> (pos & 7);
+		}
+		pos++;
+	}
+	return true;
+}
+
+bool GorillaBlock::_encode_row(uint32_t &pos, uint32_t ts, uint32_t mask, const float *values) {
+	GorillaState &state = _state;
+
+	if (_block.header.rows == 0) {
+		if (!_write_bits(pos, ts, 32)) {
+			return false;
+		}
+	} else {
+		int32_t delta = (int32_t) (ts - state.ts);
+		int32_t dod = delta - state.delta;
+		state.delta = delta;
+
+		if (dod == 0) {
+			if (!_write_bits(pos, 0, 1)) {
+				return false;
+			}
+		} else {
+			// The smaller sizes hold -(2^(n-1) - 1) to 2^(n-1), offset to be unsigned
+			uint8_t size = 0;
+			while (size < 3 && (dod < -(1 << (DOD_BITS[size] - 1)) + 1 || dod > (1 << (DOD_BITS[size] - 1)))) {
+				size++;
+			}
+			uint32_t offset = size < 3 ? (1 << (DOD_BITS[size] - 1)) - 1 : 0;
+
+			if (!_write_bits(pos, DOD_PREFIX[size], DOD_PREFIX_BITS[size]) || !_write_bits(pos, (uint32_t) dod + offset, DOD_BITS[size])) {
+				return false;
+			}
+		}
+	}
+	state.ts = ts;
+
+	if (mask == state.mask) {
+		if (!_write_bits(pos, 0, 1)) {
+			return false;
+		}
+	} else if (!_write_bits(pos, 1, 1) || !_write_bits(pos, mask, 32)) {
+		return false;
+	}
+	state.mask = mask;
+
+	for (uint8_t series = 0; series < GORILLA_MAX_SERIES; series++) {
+		uint32_t bit = 1UL << series;
+		if (!(mask & bit)) {
+			continue;
+		}
+
+		uint32_t value = float_bits(values[series]);
+
+		if (!(state.seen & bit)) {
+			state.seen |= bit;
+			state.values[series] = value;
+			state.leading[series] = 0xFF;
+			if (!_write_bits(pos, value, 32)) {
+				return false;
+			}
+			continue;
+		}
+
+		uint32_t xored = value ^ state.values[series];
+		state.values[series] = value;
+
+		if (xored == 0) {
+			if (!_write_bits(pos, 0, 1)) {
+				return false;
+			}
+			continue;
+		}
+
+		uint8_t leading = leading_zeros(xored);
+		uint8_t trailing = trailing_zeros(xored);
+
+		// Reuse the last window if the changed bits fit inside it
+		if (state.leading[series] != 0xFF && leading >= state.leading[series] && trailing >= state.trailing[series]) {
+			uint8_t length = 32 - state.leading[series] - state.trailing[series];
+			if (!_write_bits(pos, 0b10, 2) || !_write_bits(pos, xored >> state.trailing[series], length)) {
+				return false;
+			}
+			continue;
+		}
+
+		uint8_t length = 32 - leading - trailing;
+		state.leading[series] = leading;
+		state.trailing[series] = trailing;
+		if (!_write_bits(pos, 0b11, 2) || !_write_bits(pos, leading, 5) || !_write_bits(pos, length - 1, 5) ||
+			!_write_bits(pos, xored >> trailing, length)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool GorillaBlock::append(uint32_t ts, uint32_t mask, const float *values) {
+	if (mask == 0) {
+		return true;
+	}
+
+	// Encode in place, undoing it if the row runs off the end of the block
+	GorillaState saved = _state;
+	uint32_t pos = _block.header.bits;
+
+	if (!_encode_row(pos, ts, mask, values)) {
+		_state = saved;
+		memset(_block.data + (_block.header.bits + 7) / 8, 0, GORILLA_DATA_BYTES - (_block.header.bits + 7) / 8);
+		if (_block.header.bits & 7) {
+			_block.data[_block.header.bits / 8] &= 0xFF << (8 - (_block.header.bits & 7));
+		}
+		return false;
+	}
+
+	if (_block.header.rows == 0 || ts < _block.header.first_ts) {
+		_block.header.first_ts = ts;
+	}
+	if (_block.header.rows == 0 || ts > _block.header.last_ts) {
+		_block.header.last_ts = ts;
+	}
+	_block.header.rows++;
+	_block.header.bits = pos;
+	return true;
+}
+
+bool GorillaBlock::load(const uint8_t *raw) {
+	GorillaReader reader(raw);
+	if (!reader.valid()) {
+		return false;
+	}
+
+	uint32_t ts;
+	uint32_t mask;
+	float values[GORILLA_MAX_SERIES];
+	while (reader.next(ts, mask, values)) {}
+
+	memcpy(&_block, raw, sizeof(_block));
+	if (reader.bit_position() != _block.header.bits) {
+		return false;
+	}
+	_state = reader.state();
+	return true;
+}
+
+const uint8_t *GorillaBlock::raw() const {
+	return (const uint8_t *) &_block;
+}
+
+uint8_t GorillaBlock::fill_percent() const {
+	return (uint32_t) _block.header.bits * 100 / (GORILLA_DATA_BYTES * 8);
+}
+
+//----------------------------------------------------
+// GorillaReader
+
+GorillaReader::GorillaReader(const uint8_t *raw) {
+	GorillaBlockHeader header;
+	memcpy(&header, raw, sizeof(header));
+
+	_data = raw + sizeof(GorillaBlockHeader);
+	_rows = header.magic == GORILLA_MAGIC ? header.rows : 0;
+	_bits = header.magic == GORILLA_MAGIC && header.bits <= GORILLA_DATA_BYTES * 8 ? header.bits : 0;
+	clear_state(_state);
+
+	if (header.magic != GORILLA_MAGIC) {
+		_data = nullptr;
+	}
+}
+
+bool GorillaReader::valid() const {
+	return _data != nullptr;
+}
+
+bool GorillaReader::_read_bits(uint32_t &value, uint8_t count) {
+	if (_pos + count > _bits) {
+		return false;
+	}
+
+	value = 0;
+	for (uint8_t i = 0; i < count; i++) {
+		value = (value << 1) | ((_data[_pos >> 3] >> (7 - (_pos & 7))) & 1);
+		_pos++;
+	}
+	return true;
+}
+
+bool GorillaReader::next(uint32_t &ts, uint32_t &mask, float *values) {
+	if (!_data || _row >= _rows) {
+		return false;
+	}
+
+	GorillaState &state = _state;
+	uint32_t bits;
+
+	if (_row == 0) {
+		if (!_read_bits(bits, 32)) {
+			return false;
+		}
+		state.ts = bits;
+	} else {
+		// Count the prefix's leading ones: 0, 10, 110, 1110 or 1111
+		uint8_t ones = 0;
+		while (ones < 4) {
+			if (!_read_bits(bits, 1)) {
+				return false;
+			}
+			if (!bits) {
+				break;
+			}
+			ones++;
+		}
+
+		int32_t dod = 0;
+		if (ones > 0) {
+			uint8_t size = ones - 1;
+			uint32_t offset = size < 3 ? (1 << (DOD_BITS[size] - 1)) - 1 : 0;
+			if (!_read_bits(bits, DOD_BITS[size])) {
+				return false;
+			}
+			dod = (int32_t) (bits - offset);
+		}
+
+		state.delta += dod;
+		state.ts += state.delta;
+	}
+
+	if (!_read_bits(bits, 1)) {
+		return false;
+	}
+	if (bits && !_read_bits(state.mask, 32)) {
+		return false;
+	}
+
+	for (uint8_t series = 0; series < GORILLA_MAX_SERIES; series++) {
+		uint32_t bit = 1UL << series;
+		if (!(state.mask & bit)) {
+			continue;
+		}
+
+		if (!(state.seen & bit)) {
+			if (!_read_bits(state.values[series], 32)) {
+				return false;
+			}
+			state.seen |= bit;
+			state.leading[series] = 0xFF;
+		} else {
+			if (!_read_bits(bits, 1)) {
+				return false;
+			}
+
+			if (bits) {
+				uint32_t control;
+				if (!_read_bits(control, 1)) {
+					return false;
+				}
+
+				if (control) {
+					uint32_t leading;
+					uint32_t length;
+					if (!_read_bits(leading, 5) || !_read_bits(length, 5)) {
+						return false;
+					}
+					state.leading[series] = leading;
+					state.trailing[series] = 32 - leading - (length + 1);
+				} else if (state.leading[series] == 0xFF) {
+					return false;
+				}
+
+				uint8_t length = 32 - state.leading[series] - state.trailing[series];
+				uint32_t xored;
+				if (!_read_bits(xored, length)) {
+					return false;
+				}
+				state.values[series] ^= xored << state.trailing[series];
+			}
+		}
+
+		values[series] = bits_float(state.values[series]);
+	}
+
+	_row++;
+	ts = state.ts;
+	mask = state.mask;
+	return true;
+}
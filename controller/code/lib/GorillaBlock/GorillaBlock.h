@@ -0,0 +1,121 @@
+#ifndef GORILLABLOCK_H
+#define GORILLABLOCK_H
+
+#include <Arduino.h>
+
+// One flash sector, so a sealed block is written, and eventually erased, as a unit
+#define GORILLA_BLOCK_BYTES 4096
+
+// Series are identified by their bit in a row's 32 bit mask
+#define GORILLA_MAX_SERIES 32
+
+#define GORILLA_MAGIC 0x31424847 // "GHB1"
+
+struct GorillaBlockHeader {
+	uint32_t magic;
+	// Increases by one for every block written, so blocks sort oldest first
+	uint32_t sequence;
+	uint32_t first_ts;
+	uint32_t last_ts;
+	uint16_t rows;
+	uint16_t bits;
+};
+
+#define GORILLA_DATA_BYTES (GORILLA_BLOCK_BYTES - sizeof(GorillaBlockHeader))
+
+// Everything the encoder and decoder carry from one row to the next
+struct GorillaState {
+	uint32_t ts;
+	int32_t delta;
+	uint32_t mask;
+	// Series that have had a value in this block; the first one is stored whole
+	uint32_t seen;
+	uint32_t values[GORILLA_MAX_SERIES];
+	// Window of meaningful bits in the last XOR written for each series
+	uint8_t leading[GORILLA_MAX_SERIES];
+	uint8_t trailing[GORILLA_MAX_SERIES];
+};
+
+// A block of rows compressed as described in Facebook's Gorilla paper.  Each row is a timestamp
+// and one float per series in its mask:
+//
+//   - timestamps as the change in the interval since the last row, in 1 to 36 bits, so a
+//     steady collection period costs one bit
+//   - the mask in one bit when it's the same as the last row's
+//   - each value XORed with the series' previous value, in one bit when unchanged or just the
+//     bits that differ otherwise
+//
+// A row of a dozen slowly changing sensor readings takes around 20 bytes.
+class GorillaBlock {
+    private:
+	struct {
+		GorillaBlockHeader header;
+		uint8_t data[GORILLA_DATA_BYTES];
+	} _block;
+	GorillaState _state;
+
+	bool _write_bits(uint32_t &pos, uint32_t value, uint8_t count);
+	bool _encode_row(uint32_t &pos, uint32_t ts, uint32_t mask, const float *values);
+
+    public:
+	GorillaBlock();
+
+	// Start an empty block
+	void reset(uint32_t sequence);
+
+	// Append a row of values, indexed by series, for the series set in `mask`.  Returns false,
+	// leaving the block unchanged, when the row doesn't fit.
+	bool append(uint32_t ts, uint32_t mask, const float *values);
+
+	// Take over a block read back from flash, replaying it so appends can continue.  Returns
+	// false if it isn't a valid block.
+	bool load(const uint8_t *raw);
+
+	// The whole block as written to flash
+	const uint8_t *raw() const;
+
+	const GorillaBlockHeader &header() const {
+		return _block.header;
+	}
+
+	bool empty() const {
+		return _block.header.rows == 0;
+	}
+
+	// Percent of the data area used
+	uint8_t fill_percent() const;
+};
+
+// Decodes the rows of a block in order
+class GorillaReader {
+    private:
+	const uint8_t *_data;
+	uint16_t _rows;
+	uint16_t _bits;
+	uint16_t _row = 0;
+	uint32_t _pos = 0;
+	GorillaState _state;
+
+	bool _read_bits(uint32_t &value, uint8_t count);
+
+    public:
+	// `raw` is a whole block as returned by GorillaBlock::raw()
+	GorillaReader(const uint8_t *raw);
+
+	bool valid() const;
+
+	// Where decoding has got to; after the last row, what the encoder needs to carry on
+	const GorillaState &state() const {
+		return _state;
+	}
+
+	uint32_t bit_position() const {
+		return _pos;
+	}
+
+	// Decode the next row.  `values` must hold GORILLA_MAX_SERIES; only the series in `mask`
+	// are filled in.  Returns false after the last row or if the block is corrupt.
+	bool next(uint32_t &ts, uint32_t &mask, float *values);
+};
+
+#endif
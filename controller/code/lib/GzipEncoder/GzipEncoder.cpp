@@ -0,0 +1,284 @@
+#include "GzipEncoder.h"
+
+#include <string.h>
+
+#define MIN_MATCH 3
+#define MAX_MATCH 258
+#define END_OF_BLOCK 256
+
+#define WINDOW_MASK (GZIP_WINDOW_BYTES - 1)
+
+// How hard each level looks for a match: candidates followed along the hash chain, the length
+// that is good enough to stop at, and whether to check if the next byte starts a longer match
+struct GzipLevel {
+	uint16_t max_chain;
+	uint16_t nice_length;
+	bool lazy;
+};
+
+static const GzipLevel LEVELS[GZIP_MAX_LEVEL + 1] = {
+	{0, 0, false},
+	{4, 8, false}, {8, 16, false}, {16, 32, false},
+	{16, 32, true}, {32, 64, true}, {64, 128, true},
+	{128, 258, true}, {256, 258, true}, {1024, 258, true},
+};
+
+// Length codes 257-285 and distance codes 0-29: the smallest value each covers, and how many
+// extra bits follow the code
+static const uint16_t LENGTH_BASE[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t LENGTH_EXTRA[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t DISTANCE_BASE[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+	4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t DISTANCE_EXTRA[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+static const uint32_t CRC_TABLE[16] = {
+	0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+	0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+
+static uint16_t hash(const uint8_t *p) {
+	uint32_t bytes = (uint32_t) p[0] << 16 | (uint32_t) p[1] << 8 | p[2];
+	return (bytes * 2654435761u) >> (32 - GZIP_HASH_BITS);
+}
+
+GzipEncoder::GzipEncoder(uint8_t level) {
+	set_level(level);
+}
+
+void GzipEncoder::set_level(uint8_t level) {
+	_level = level > GZIP_MAX_LEVEL ? GZIP_MAX_LEVEL : level;
+}
+
+uint8_t GzipEncoder::level() const {
+	return _level;
+}
+
+uint32_t GzipEncoder::crc32(const uint8_t *data, size_t len) {
+	uint32_t crc = 0xFFFFFFFF;
+	for (size_t i = 0; i < len; i++) {
+		crc ^= data[i];
+		crc = (crc >> 4) ^ CRC_TABLE[crc & 0x0F];
+		crc = (crc >> 4) ^ CRC_TABLE[crc & 0x0F];
+	}
+	return ~crc;
+}
+
+void GzipEncoder::_put_byte(uint8_t value) {
+	if (_length >= _capacity) {
+		_overflow = true;
+		return;
+	}
+	_out[_length++] = value;
+}
+
+// Deflate packs bits starting from the least significant
+void GzipEncoder::_put_bits(uint32_t value, uint8_t count) {
+	_bits |= value << _bit_count;
+	_bit_count += count;
+	while (_bit_count >= 8) {
+		_put_byte(_bits & 0xFF);
+		_bits >>= 8;
+		_bit_count -= 8;
+	}
+}
+
+// ...except Huffman codes, which go most significant bit first
+void GzipEncoder::_put_code(uint16_t code, uint8_t length) {
+	uint16_t reversed = 0;
+	for (uint8_t i = 0; i < length; i++) {
+		reversed = (reversed << 1) | (code & 1);
+		code >>= 1;
+	}
+	_put_bits(reversed, length);
+}
+
+void GzipEncoder::_put_uint32(uint32_t value) {
+	for (int i = 0; i < 4; i++) {
+		_put_byte(value & 0xFF);
+		value >>= 8;
+	}
+}
+
+void GzipEncoder::_align() {
+	if (_bit_count > 0) {
+		_put_byte(_bits & 0xFF);
+	}
+	_bits = 0;
+	_bit_count = 0;
+}
+
+// Fixed Huffman codes for literals and lengths (RFC 1951 3.2.6)
+void GzipEncoder::_literal(uint8_t value) {
+	if (value < 144) {
+		_put_code(0x30 + value, 8);
+	} else {
+		_put_code(0x190 + value - 144, 9);
+	}
+}
+
+void GzipEncoder::_match(uint16_t length, uint16_t distance) {
+	uint8_t code = 28;
+	while (LENGTH_BASE[code] > length) {
+		code--;
+	}
+	uint16_t symbol = 257 + code;
+	if (symbol < 280) {
+		_put_code(symbol - 256, 7);
+	} else {
+		_put_code(0xC0 + symbol - 280, 8);
+	}
+	_put_bits(length - LENGTH_BASE[code], LENGTH_EXTRA[code]);
+
+	code = 29;
+	while (DISTANCE_BASE[code] > distance) {
+		code--;
+	}
+	_put_code(code, 5);
+	_put_bits(distance - DISTANCE_BASE[code], DISTANCE_EXTRA[code]);
+}
+
+void GzipEncoder::_insert(const uint8_t *in, size_t pos) {
+	uint16_t h = hash(in + pos);
+	_prev[pos & WINDOW_MASK] = _head[h];
+	_head[h] = pos + 1;
+}
+
+// The longest earlier match for the bytes at `pos`, or 0 if there's none of at least MIN_MATCH
+uint16_t GzipEncoder::_longest_match(const uint8_t *in, size_t len, size_t pos, uint16_t &distance) {
+	const GzipLevel &level = LEVELS[_level];
+	size_t max_length = len - pos < MAX_MATCH ? len - pos : MAX_MATCH;
+	uint16_t best = 0;
+
+	uint16_t candidate = _head[hash(in + pos)];
+	for (uint16_t chain = level.max_chain; candidate > 0 && chain > 0; chain--) {
+		size_t start = candidate - 1;
+		// Older positions have had their chain slots reused
+		if (pos - start >= GZIP_WINDOW_BYTES) {
+			break;
+		}
+
+		if (in[start + best] == in[pos + best]) {
+			uint16_t length = 0;
+			while (length < max_length && in[start + length] == in[pos + length]) {
+				length++;
+			}
+			if (length > best) {
+				best = length;
+				distance = pos - start;
+				if (length >= level.nice_length || length == max_length) {
+					break;
+				}
+			}
+		}
+
+		uint16_t next = _prev[start & WINDOW_MASK];
+		if (next >= candidate) {
+			break;
+		}
+		candidate = next;
+	}
+
+	return best >= MIN_MATCH ? best : 0;
+}
+
+void GzipEncoder::_deflate(const uint8_t *in, size_t len) {
+	memset(_head, 0, sizeof(_head));
+
+	// One final block with fixed codes
+	_put_bits(1, 1);
+	_put_bits(1, 2);
+
+	size_t pos = 0;
+	while (pos < len) {
+		uint16_t distance = 0;
+		uint16_t length = 0;
+		if (pos + MIN_MATCH <= len) {
+			length = _longest_match(in, len, pos, distance);
+			_insert(in, pos);
+
+			// A longer match starting one byte on is worth a literal first
+			if (length > 0 && length < LEVELS[_level].nice_length && LEVELS[_level].lazy && pos + 1 + MIN_MATCH <= len) {
+				uint16_t next_distance = 0;
+				uint16_t next_length = _longest_match(in, len, pos + 1, next_distance);
+				if (next_length > length) {
+					_literal(in[pos]);
+					pos++;
+					length = next_length;
+					distance = next_distance;
+					_insert(in, pos);
+				}
+			}
+		}
+
+		if (length == 0) {
+			_literal(in[pos]);
+			pos++;
+			continue;
+		}
+
+		_match(length, distance);
+		for (size_t end = pos + length, i = pos + 1; i < end; i++) {
+			if (i + MIN_MATCH <= len) {
+				_insert(in, i);
+			}
+		}
+		pos += length;
+	}
+
+	_put_code(END_OF_BLOCK - 256, 7);
+	_align();
+}
+
+void GzipEncoder::_store(const uint8_t *in, size_t len) {
+	// One final stored block
+	_put_bits(1, 1);
+	_put_bits(0, 2);
+	_align();
+
+	_put_byte(len & 0xFF);
+	_put_byte(len >> 8);
+	_put_byte(~len & 0xFF);
+	_put_byte((~len >> 8) & 0xFF);
+
+	if (_length + len > _capacity) {
+		_overflow = true;
+		return;
+	}
+	memcpy(_out + _length, in, len);
+	_length += len;
+}
+
+size_t GzipEncoder::compress(const uint8_t *in, size_t len, uint8_t *out, size_t capacity) {
+	if (len > GZIP_MAX_INPUT) {
+		return 0;
+	}
+
+	_out = out;
+	_capacity = capacity;
+	_length = 0;
+	_bits = 0;
+	_bit_count = 0;
+	_overflow = false;
+
+	// Magic, deflate, no flags or modification time, extra flags for the level, unknown OS
+	static const uint8_t header[8] = {0x1F, 0x8B, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00};
+	for (uint8_t b : header) {
+		_put_byte(b);
+	}
+	_put_byte(_level == GZIP_MAX_LEVEL ? 2 : _level == 1 ? 4 : 0);
+	_put_byte(0xFF);
+
+	if (_level == 0) {
+		_store(in, len);
+	} else {
+		_deflate(in, len);
+	}
+
+	_put_uint32(crc32(in, len));
+	_put_uint32(len);
+
+	return _overflow ? 0 : _length;
+}
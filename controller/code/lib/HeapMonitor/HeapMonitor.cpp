@@ -0,0 +1,242 @@
+#include "HeapMonitor.h"
+
+#if __has_include(<freertos/FreeRTOS.h>)
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_heap_caps.h>
+#define HEAP_HAS_TASKS true
+#else
+#define HEAP_HAS_TASKS false
+#endif
+
+// Per task allocation counts and current site, shared with the allocator wrappers below
+struct TaskAllocations {
+	void *handle;
+	HeapSite *site;
+	std::atomic<uint32_t> allocations{0};
+};
+
+static TaskAllocations TASK_ALLOCATIONS[HEAP_MAX_TASKS];
+static std::atomic<uint8_t> TASK_SLOTS{0};
+
+static std::atomic<uint32_t> ALLOCATIONS{0};
+static std::atomic<uint32_t> FREES{0};
+static std::atomic<uint64_t> ALLOCATED_BYTES{0};
+static std::atomic<HeapSite *> SITES{nullptr};
+
+static void *current_task() {
+#if HEAP_HAS_TASKS
+	return xTaskGetCurrentTaskHandle();
+#else
+	// Everything on the host runs as the one task
+	return nullptr;
+#endif
+}
+
+static int8_t find_slot(void *task) {
+	uint8_t slots = TASK_SLOTS.load(std::memory_order_acquire);
+	for (uint8_t slot = 0; slot < slots; slot++) {
+		if (TASK_ALLOCATIONS[slot].handle == task) {
+			return slot;
+		}
+	}
+	return -1;
+}
+
+#if COUNT_ALLOCATIONS
+// The allocator itself, with -Wl,--wrap.  These run for every allocation in the firmware, from
+// any task, so they must not allocate or block.
+static void count_allocation(size_t size) {
+	ALLOCATIONS.fetch_add(1, std::memory_order_relaxed);
+	ALLOCATED_BYTES.fetch_add(size, std::memory_order_relaxed);
+
+	int8_t slot = find_slot(current_task());
+	if (slot < 0) {
+		return;
+	}
+
+	TaskAllocations &task = TASK_ALLOCATIONS[slot];
+	task.allocations.fetch_add(1, std::memory_order_relaxed);
+#if TRACK_ALLOCATIONS
+	if (task.site) {
+		task.site->allocations.fetch_add(1, std::memory_order_relaxed);
+		task.site->bytes.fetch_add(size, std::memory_order_relaxed);
+	}
+#endif
+}
+
+extern "C" {
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+void *__wrap_malloc(size_t size) {
+	count_allocation(size);
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+	count_allocation(count * size);
+	return __real_calloc(count, size);
+}
+
+// String grows with realloc, so each call counts as an allocation
+void *__wrap_realloc(void *ptr, size_t size) {
+	if (size > 0) {
+		count_allocation(size);
+	}
+	return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void *ptr) {
+	if (ptr) {
+		FREES.fetch_add(1, std::memory_order_relaxed);
+	}
+	__real_free(ptr);
+}
+}
+#endif
+
+HeapSite::HeapSite(const char *name) : name(name) {
+	next = SITES.load();
+	while (!SITES.compare_exchange_weak(next, this)) {
+	}
+}
+
+AllocationScope::AllocationScope(HeapSite *site) : _slot(find_slot(current_task())), _previous(nullptr) {
+	if (_slot >= 0) {
+		_previous = TASK_ALLOCATIONS[_slot].site;
+		TASK_ALLOCATIONS[_slot].site = site;
+	}
+}
+
+AllocationScope::~AllocationScope() {
+	if (_slot >= 0) {
+		TASK_ALLOCATIONS[_slot].site = _previous;
+	}
+}
+
+uint8_t HeapSnapshot::fragmentation_percent() const {
+	if (free_bytes == 0 || largest_block >= free_bytes) {
+		return 0;
+	}
+	return 100 - (uint64_t) largest_block * 100 / free_bytes;
+}
+
+void HeapMonitor::begin() {
+	watch_task("loop", current_task());
+	reset_stats();
+}
+
+void HeapMonitor::watch_task(const char *name, void *handle) {
+	if (_task_count >= HEAP_MAX_TASKS) {
+		return;
+	}
+	_tasks[_task_count++] = {name, handle};
+
+	// Fill the slot in before the wrappers can see it
+	uint8_t slot = TASK_SLOTS.load();
+	TASK_ALLOCATIONS[slot].handle = handle;
+	TASK_ALLOCATIONS[slot].site = nullptr;
+	TASK_SLOTS.store(slot + 1, std::memory_order_release);
+}
+
+void HeapMonitor::end_loop() {
+	int8_t slot = find_slot(current_task());
+	if (slot < 0) {
+		return;
+	}
+
+	uint32_t allocations = TASK_ALLOCATIONS[slot].allocations.load(std::memory_order_relaxed);
+	uint32_t pass = allocations - _loop_start_allocations;
+	_loop_start_allocations = allocations;
+
+	_loops++;
+	_loop_allocations += pass;
+	if (pass > _max_loop_allocations) {
+		_max_loop_allocations = pass;
+	}
+}
+
+HeapSnapshot HeapMonitor::snapshot() const {
+	HeapSnapshot snapshot;
+	snapshot.total_bytes = ESP.getHeapSize();
+	snapshot.free_bytes = ESP.getFreeHeap();
+	snapshot.min_free_bytes = ESP.getMinFreeHeap();
+	snapshot.largest_block = ESP.getMaxAllocHeap();
+	snapshot.allocated_blocks = 0;
+
+#if HEAP_HAS_TASKS
+	multi_heap_info_t info;
+	heap_caps_get_info(&info, MALLOC_CAP_8BIT);
+	snapshot.allocated_blocks = info.allocated_blocks;
+#endif
+	return snapshot;
+}
+
+size_t HeapMonitor::task_count() const {
+	return _task_count;
+}
+
+const WatchedTask &HeapMonitor::task(size_t index) const {
+	return _tasks[index];
+}
+
+uint32_t HeapMonitor::stack_free_bytes(size_t index) const {
+#if HEAP_HAS_TASKS
+	// ESP-IDF counts stack in bytes rather than words
+	return uxTaskGetStackHighWaterMark((TaskHandle_t) _tasks[index].handle);
+#else
+	return 0;
+#endif
+}
+
+uint32_t HeapMonitor::allocations() {
+	return ALLOCATIONS.load(std::memory_order_relaxed);
+}
+
+uint32_t HeapMonitor::frees() {
+	return FREES.load(std::memory_order_relaxed);
+}
+
+uint64_t HeapMonitor::allocated_bytes() {
+	return ALLOCATED_BYTES.load(std::memory_order_relaxed);
+}
+
+float HeapMonitor::mean_loop_allocations() const {
+	return _loops ? (float) _loop_allocations / _loops : 0;
+}
+
+uint32_t HeapMonitor::max_loop_allocations() const {
+	return _max_loop_allocations;
+}
+
+const HeapSite *HeapMonitor::sites() {
+	return SITES.load();
+}
+
+void HeapMonitor::reset_stats() {
+	_loops = 0;
+	_loop_allocations = 0;
+	_max_loop_allocations = 0;
+}
+
+String HeapMonitor::stats() const {
+	HeapSnapshot heap = snapshot();
+
+	String stats = "free=" + String(heap.free_bytes) + " largest=" + String(heap.largest_block) +
+		" min=" + String(heap.min_free_bytes) + " frag=" + String(heap.fragmentation_percent()) + "%" +
+		" blocks=" + String(heap.allocated_blocks);
+
+	if (COUNT_ALLOCATIONS) {
+		stats += " allocs=" + String(allocations()) + " frees=" + String(frees()) +
+			" allocs/loop=" + String(mean_loop_allocations(), 2) + " (max " + String(_max_loop_allocations) + ")";
+	}
+
+	stats += " stack free:";
+	for (size_t i = 0; i < _task_count; i++) {
+		stats += " " + String(_tasks[i].name) + "=" + String(stack_free_bytes(i));
+	}
+	return stats;
+}
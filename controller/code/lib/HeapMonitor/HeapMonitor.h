@@ -0,0 +1,121 @@
+#ifndef HEAPMONITOR_H
+#define HEAPMONITOR_H
+
+#include <Arduino.h>
+#include <atomic>
+
+// Count every malloc/calloc/realloc/free.  Needs the allocator wrapped at link time, so only set
+// this alongside -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free (see platformio.ini).
+#ifndef COUNT_ALLOCATIONS
+#define COUNT_ALLOCATIONS false
+#endif
+
+// Also attribute each allocation to the innermost ALLOC_SITE() scope active on the allocating
+// task.  Costs a lookup per allocation, so it has its own build; implies COUNT_ALLOCATIONS.
+#ifndef TRACK_ALLOCATIONS
+#define TRACK_ALLOCATIONS false
+#endif
+
+#if TRACK_ALLOCATIONS
+#undef COUNT_ALLOCATIONS
+#define COUNT_ALLOCATIONS true
+#endif
+
+// Tasks whose stack high-water marks are reported, and that can have an ALLOC_SITE() open
+#define HEAP_MAX_TASKS 6
+
+// A named place in the code that allocations are attributed to.  Sites link themselves into a
+// list as they are first entered, so none are allocated.
+struct HeapSite {
+	const char *name;
+	std::atomic<uint32_t> allocations{0};
+	std::atomic<uint32_t> bytes{0};
+	HeapSite *next;
+
+	HeapSite(const char *name);
+};
+
+// Makes `site` the current site for the calling task until the end of the enclosing scope.
+// Only watched tasks (see HeapMonitor::watch_task()) keep track of a site.
+class AllocationScope {
+    private:
+	int8_t _slot;
+	HeapSite *_previous;
+
+    public:
+	AllocationScope(HeapSite *site);
+	~AllocationScope();
+};
+
+// e.g. ALLOC_SITE("InfluxDBHandler::flush"); at the top of a function.  One per scope.
+#if TRACK_ALLOCATIONS
+#define ALLOC_SITE(name) static HeapSite _alloc_site(name); AllocationScope _alloc_scope(&_alloc_site)
+#else
+#define ALLOC_SITE(name) do {} while (0)
+#endif
+
+struct HeapSnapshot {
+	uint32_t total_bytes;
+	uint32_t free_bytes;
+	uint32_t min_free_bytes;
+	// The largest single allocation that would currently succeed
+	uint32_t largest_block;
+	// Blocks currently allocated, where the allocator reports it
+	uint32_t allocated_blocks;
+
+	// Share of the free heap that isn't in the largest block, 0-100
+	uint8_t fragmentation_percent() const;
+};
+
+struct WatchedTask {
+	const char *name;
+	void *handle;
+};
+
+// Reports the state of the heap and the tasks' stacks, so slow degradation over weeks of uptime
+// shows in the heartbeat before it ends in a reset.  With COUNT_ALLOCATIONS it also counts
+// allocations, in total and per pass through the loop.
+class HeapMonitor {
+    private:
+	WatchedTask _tasks[HEAP_MAX_TASKS];
+	uint8_t _task_count = 0;
+
+	// Allocations made by the loop task in the current pass, and over the stats period
+	uint32_t _loop_start_allocations = 0;
+	uint32_t _loops = 0;
+	uint32_t _loop_allocations = 0;
+	uint32_t _max_loop_allocations = 0;
+
+    public:
+	// Call from the loop task; it is watched as "loop"
+	void begin();
+
+	void watch_task(const char *name, void *handle);
+
+	// Call at the end of each pass through the loop
+	void end_loop();
+
+	HeapSnapshot snapshot() const;
+
+	size_t task_count() const;
+	const WatchedTask &task(size_t index) const;
+	// Bytes of the task's stack that have never been used
+	uint32_t stack_free_bytes(size_t index) const;
+
+	// Running totals across all tasks; zero unless COUNT_ALLOCATIONS
+	static uint32_t allocations();
+	static uint32_t frees();
+	static uint64_t allocated_bytes();
+
+	// Allocations made by the loop task, per pass since reset_stats()
+	float mean_loop_allocations() const;
+	uint32_t max_loop_allocations() const;
+
+	// The first in the list of ALLOC_SITE()s entered so far; follow next for the rest
+	static const HeapSite *sites();
+
+	void reset_stats();
+	String stats() const;
+};
+
+#endif
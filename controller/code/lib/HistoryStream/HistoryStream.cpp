@@ -0,0 +1,186 @@
+#include "HistoryStream.h"
+
+HistoryStream::HistoryStream(MetricStore *store, const uint8_t *series, uint8_t series_count, uint32_t from, uint32_t to,
+	uint32_t step, HistoryFormat format) : _store(store), _format(format), _series_count(series_count), _to(to), _cursor(from) {
+	memcpy(_series, series, series_count);
+	_step = step > 0 ? step : 1;
+
+	_window_steps = series_count > 0 ? HISTORY_STREAM_WINDOW_VALUES / series_count : 1;
+	_sums = new float[_window_steps * series_count];
+	_counts = new uint32_t[_window_steps * series_count];
+
+	// Align steps to the clock so repeated queries line up
+	_cursor -= _cursor % _step;
+	_done = _cursor > _to;
+}
+
+HistoryStream::~HistoryStream() {
+	delete[] _sums;
+	delete[] _counts;
+}
+
+bool HistoryStream::_format_header_part() {
+	if (_header_part > _series_count + 1) {
+		return false;
+	}
+
+	uint8_t part = _header_part++;
+	_line_pos = 0;
+
+	if (part == 0) {
+		if (_format == HISTORY_CSV) {
+			_line_len = strlcpy(_line, "timestamp", sizeof(_line));
+		} else {
+			memcpy(_line, HISTORY_STREAM_MAGIC, 4);
+			_line[4] = _series_count;
+			memcpy(_line + 5, &_step, 4);
+			_line_len = 9;
+		}
+		return true;
+	}
+
+	if (part <= _series_count) {
+		const char *name = _store->series_name(_series[part - 1]);
+		if (_format == HISTORY_CSV) {
+			_line_len = snprintf(_line, sizeof(_line), ",%s", name);
+		} else {
+			_line[0] = strlen(name);
+			memcpy(_line + 1, name, _line[0]);
+			_line_len = 1 + _line[0];
+		}
+		return true;
+	}
+
+	// Binary records follow the names directly
+	_line_len = 0;
+	if (_format == HISTORY_CSV) {
+		_line[_line_len++] = '\n';
+	}
+	return true;
+}
+
+void HistoryStream::_fill_window() {
+	uint64_t span = (uint64_t) _window_steps * _step;
+	uint32_t end = _to - _cursor < span ? _to : _cursor + span - 1;
+
+	_window_start = _cursor;
+	_window_filled = (end - _cursor) / _step + 1;
+	_window_next = 0;
+	memset(_sums, 0, sizeof(float) * _window_steps * _series_count);
+	memset(_counts, 0, sizeof(uint32_t) * _window_steps * _series_count);
+
+	// Map store series ids to columns
+	int8_t columns[GORILLA_MAX_SERIES];
+	memset(columns, -1, sizeof(columns));
+	uint32_t mask = 0;
+	for (uint8_t i = 0; i < _series_count; i++) {
+		columns[_series[i]] = i;
+		mask |= 1UL << _series[i];
+	}
+
+	size_t found = _store->query(_cursor, end, mask, [this, &columns](uint32_t ts, uint8_t series, float value) {
+		size_t slot = (ts - _window_start) / _step * _series_count + columns[series];
+		_sums[slot] += value;
+		_counts[slot]++;
+		return true;
+	});
+
+	if (end >= _to) {
+		_done = true;
+		return;
+	}
+	_cursor = end + 1;
+
+	if (found == 0) {
+		// Nothing here, so jump to the window holding the next sample.  A gap in the history,
+		// however many windows long, then costs one more query rather than one per window.
+		_window_filled = 0;
+
+		bool any = false;
+		uint32_t next = 0;
+		_store->query(_cursor, _to, mask, [&any, &next](uint32_t ts, uint8_t series, float value) {
+			any = true;
+			next = ts;
+			return false;
+		});
+
+		if (any) {
+			_cursor = next - next % _step;
+		} else {
+			_done = true;
+		}
+	}
+}
+
+bool HistoryStream::_format_next_row() {
+	if (_format_header_part()) {
+		return true;
+	}
+
+	while (true) {
+		if (_window_next >= _window_filled) {
+			if (_done) {
+				return false;
+			}
+			_fill_window();
+			continue;
+		}
+
+		uint16_t step = _window_next++;
+		const float *sums = _sums + step * _series_count;
+		const uint32_t *counts = _counts + step * _series_count;
+
+		bool any = false;
+		for (uint8_t i = 0; i < _series_count; i++) {
+			any = any || counts[i] > 0;
+		}
+		if (!any) {
+			continue;
+		}
+
+		uint32_t ts = _window_start + step * _step;
+
+		if (_format == HISTORY_CSV) {
+			_line_len = snprintf(_line, sizeof(_line), "%lu", (unsigned long) ts);
+			for (uint8_t i = 0; i < _series_count; i++) {
+				if (counts[i] > 0) {
+					_line_len += snprintf(_line + _line_len, sizeof(_line) - _line_len, ",%.7g", sums[i] / counts[i]);
+				} else {
+					_line[_line_len++] = ',';
+				}
+			}
+			_line[_line_len++] = '\n';
+		} else {
+			memcpy(_line, &ts, 4);
+			_line_len = 4;
+			for (uint8_t i = 0; i < _series_count; i++) {
+				float value = counts[i] > 0 ? sums[i] / counts[i] : NAN;
+				memcpy(_line + _line_len, &value, 4);
+				_line_len += 4;
+			}
+		}
+
+		_line_pos = 0;
+		return true;
+	}
+}
+
+size_t HistoryStream::read(uint8_t *buffer, size_t max) {
+	size_t written = 0;
+
+	while (written < max) {
+		if (_line_pos >= _line_len && !_format_next_row()) {
+			break;
+		}
+
+		size_t count = _line_len - _line_pos;
+		if (count > max - written) {
+			count = max - written;
+		}
+		memcpy(buffer + written, _line + _line_pos, count);
+		_line_pos += count;
+		written += count;
+	}
+
+	return written;
+}
@@ -0,0 +1,74 @@
+#ifndef HISTORYSTREAM_H
+#define HISTORYSTREAM_H
+
+#include <Arduino.h>
+
+#include "MetricStore.h"
+
+// Values aggregated per pass over the store.  Each pass covers this many values spread across
+// the requested series, so the RAM used per response is fixed however long the range.
+#define HISTORY_STREAM_WINDOW_VALUES 256
+
+// Room for one formatted row of up to GORILLA_MAX_SERIES values
+#define HISTORY_STREAM_LINE_BYTES 640
+
+#define HISTORY_STREAM_MAGIC "GHH1"
+
+enum HistoryFormat {
+	// A header line naming the series, then "timestamp,value,value..." with empty fields for
+	// series that have no samples in that step
+	HISTORY_CSV,
+	// "GHH1", u8 series count, u32 step, then a u8 length and name per series.  After that
+	// one record per step: u32 timestamp and a float per series, NaN where there are no
+	// samples.  All little endian.
+	HISTORY_BINARY,
+};
+
+// Produces the samples of some series over a time range as a stream of bytes, averaged into
+// steps of a fixed number of seconds.  Steps with no samples at all are left out, and windows
+// with none are skipped over.  The stream is generated as it is read, a window of steps at a
+// time, so a response of any length can be served from a small buffer.
+class HistoryStream {
+    private:
+	MetricStore *_store;
+	HistoryFormat _format;
+	uint8_t _series[GORILLA_MAX_SERIES];
+	uint8_t _series_count;
+	uint32_t _to;
+	uint32_t _step;
+
+	// Start of the next window to aggregate
+	uint32_t _cursor;
+	bool _done = false;
+
+	// One window of steps, _window_steps * _series_count wide
+	float *_sums;
+	uint32_t *_counts;
+	uint16_t _window_steps;
+	uint32_t _window_start = 0;
+	uint16_t _window_filled = 0;
+	uint16_t _window_next = 0;
+
+	// The formatted row being handed out, which may take several reads
+	char _line[HISTORY_STREAM_LINE_BYTES];
+	size_t _line_len = 0;
+	size_t _line_pos = 0;
+
+	// The header goes out a piece at a time: the start, one per series name, then the end
+	uint8_t _header_part = 0;
+
+	bool _format_header_part();
+	bool _format_next_row();
+	void _fill_window();
+
+    public:
+	// `series` are ids from the store.  `step` is at least one second.
+	HistoryStream(MetricStore *store, const uint8_t *series, uint8_t series_count, uint32_t from, uint32_t to,
+		uint32_t step, HistoryFormat format);
+	~HistoryStream();
+
+	// Copy up to `max` more bytes into `buffer`.  Returns 0 once the stream is finished.
+	size_t read(uint8_t *buffer, size_t max);
+};
+
+#endif
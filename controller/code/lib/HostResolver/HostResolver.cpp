@@ -0,0 +1,118 @@
+#include "HostResolver.h"
+
+ResolverEntry *HostResolver::_find(const char *host) {
+	for (uint8_t i = 0; i < _count; i++) {
+		if (strcmp(_entries[i].host, host) == 0) {
+			return &_entries[i];
+		}
+	}
+	return nullptr;
+}
+
+ResolverEntry *HostResolver::_add(const char *host) {
+	if (_count >= RESOLVER_MAX_HOSTS || strlen(host) >= RESOLVER_MAX_HOST_LEN) {
+		return nullptr;
+	}
+
+	ResolverEntry &entry = _entries[_count++];
+	strlcpy(entry.host, host, sizeof(entry.host));
+	return &entry;
+}
+
+void HostResolver::_lookup(ResolverEntry &entry) {
+	IPAddress ip;
+	uint64_t start_ms = uptime_ms();
+	bool found = WiFi.hostByName(entry.host, ip) == 1 && ip != IPAddress();
+	uint64_t now_ms = uptime_ms();
+
+	entry.lookups++;
+	entry.last_lookup_ms = now_ms - start_ms;
+
+	if (found) {
+		if (entry.has_ip && ip != entry.ip) {
+			LOG_INFO("Address for %s changed to %s", entry.host, ip.toString().c_str());
+		}
+
+		entry.ip = ip;
+		entry.has_ip = true;
+		entry.failed = false;
+		entry.stale = false;
+		entry.expires_ms = now_ms + RESOLVER_TTL_MS;
+		return;
+	}
+
+	entry.failures++;
+	entry.expires_ms = now_ms + RESOLVER_NEGATIVE_TTL_MS;
+
+	// Keep using the last good address; the host has most likely just missed an mDNS query
+	if (entry.has_ip) {
+		entry.stale = true;
+		LOG_WARNING("Failed to resolve %s, keeping %s", entry.host, entry.ip.toString().c_str());
+	} else {
+		entry.failed = true;
+		LOG_ERROR("Failed to resolve %s", entry.host);
+	}
+}
+
+ResolveStatus HostResolver::resolve(const char *host, IPAddress &ip) {
+	if (ip.fromString(host)) {
+		return RESOLVE_OK;
+	}
+
+	ResolverEntry *entry = _find(host);
+	if (!entry) {
+		entry = _add(host);
+		if (!entry) {
+			return RESOLVE_UNCACHED;
+		}
+		_lookup(*entry);
+	} else if (uptime_ms() >= entry->expires_ms) {
+		_lookup(*entry);
+	} else {
+		entry->hits++;
+	}
+
+	if (entry->failed) {
+		return RESOLVE_FAILED;
+	}
+
+	ip = entry->ip;
+	return RESOLVE_OK;
+}
+
+ResolveStatus HostResolver::resolve(const String &host, String &address) {
+	IPAddress ip;
+	ResolveStatus status = resolve(host.c_str(), ip);
+	address = status == RESOLVE_OK ? ip.toString() : host;
+	return status;
+}
+
+void HostResolver::refresh() {
+	uint64_t now_ms = uptime_ms();
+
+	for (uint8_t i = 0; i < _count; i++) {
+		ResolverEntry &entry = _entries[i];
+
+		// Good entries are refreshed ahead of time; failed ones wait out the negative TTL
+		bool due = entry.failed || entry.stale
+			? now_ms >= entry.expires_ms
+			: now_ms + RESOLVER_REFRESH_AHEAD_MS >= entry.expires_ms;
+		if (due) {
+			_lookup(entry);
+		}
+	}
+}
+
+String HostResolver::stats() const {
+	String stats = "";
+	for (uint8_t i = 0; i < _count; i++) {
+		const ResolverEntry &entry = _entries[i];
+		if (stats.length() > 0) {
+			stats += ", ";
+		}
+		stats += String(entry.host) + "=" + (entry.failed ? String("failed") : entry.ip.toString()) +
+			"(hits=" + String(entry.hits) + " lookups=" + String(entry.lookups) +
+			" failures=" + String(entry.failures) + " last=" + String(entry.last_lookup_ms) + "ms)";
+	}
+	return stats;
+}
@@ -0,0 +1,77 @@
+#ifndef HOSTRESOLVER_H
+#define HOSTRESOLVER_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+#include "LogQueue.h"
+#include "Clock.h"
+
+// How long a resolved address is used before looking it up again
+#ifndef RESOLVER_TTL_MS
+#define RESOLVER_TTL_MS (10 * 60 * 1000)
+#endif
+
+// How long to wait before retrying a name that didn't resolve
+#define RESOLVER_NEGATIVE_TTL_MS (60 * 1000)
+
+// refresh() looks names up again this long before they expire, so callers never wait on it
+#define RESOLVER_REFRESH_AHEAD_MS (60 * 1000)
+
+#define RESOLVER_MAX_HOSTS 4
+#define RESOLVER_MAX_HOST_LEN 64
+
+enum ResolveStatus {
+	RESOLVE_OK,
+	// The name didn't resolve recently; don't try to connect until it's retried
+	RESOLVE_FAILED,
+	// The cache is full, or the name is too long to cache
+	RESOLVE_UNCACHED,
+};
+
+struct ResolverEntry {
+	char host[RESOLVER_MAX_HOST_LEN];
+	IPAddress ip;
+	bool has_ip = false;
+	bool failed = false;
+	// The last lookup failed and the previous address is still being served
+	bool stale = false;
+	uint64_t expires_ms = 0;
+
+	uint32_t hits = 0;
+	uint32_t lookups = 0;
+	uint32_t failures = 0;
+	uint32_t last_lookup_ms = 0;
+};
+
+// Caches name lookups (DNS, and mDNS for .local names through lwIP) so the settings and InfluxDB
+// clients connect to an address instead of resolving on every request.  An mDNS lookup on a busy
+// network can take hundreds of ms or time out.  Names that fail are cached too, and a name that
+// stops resolving keeps its last good address until it resolves again.
+//
+// Only used from the network task, so there is no locking.
+class HostResolver {
+    private:
+	ResolverEntry _entries[RESOLVER_MAX_HOSTS];
+	uint8_t _count = 0;
+
+	ResolverEntry *_find(const char *host);
+	ResolverEntry *_add(const char *host);
+	void _lookup(ResolverEntry &entry);
+
+    public:
+	// Resolve `host` into `ip`, from the cache when the entry is still fresh.  IP literals are
+	// returned as they are.
+	ResolveStatus resolve(const char *host, IPAddress &ip);
+
+	// Same, but returns the address as a string, or `host` itself when it can't be cached
+	ResolveStatus resolve(const String &host, String &address);
+
+	// Look up any name that is about to expire, or whose negative entry has run out.  Call
+	// from the network task between requests.
+	void refresh();
+
+	String stats() const;
+};
+
+#endif
@@ -0,0 +1,118 @@
+#include "HttpConnection.h"
+
+HttpConnection::HttpConnection(const char *name, const String &host, uint16_t port) : _name(name), _host(host), _port(port) {
+	_http.setReuse(true);
+}
+
+void HttpConnection::set_host(const String &host, uint16_t port) {
+	if (host == _host && port == _port) {
+		return;
+	}
+
+	// The client would otherwise carry on using the socket to the old server
+	close();
+	_host = host;
+	_port = port;
+	_retry_at_ms = 0;
+	_backoff_ms = 0;
+}
+
+void HttpConnection::set_address(const String &address) {
+	if (address == _address) {
+		return;
+	}
+
+	// The server moved; don't carry on with a socket to its old address
+	close();
+	_address = address;
+}
+
+bool HttpConnection::backing_off() const {
+	return uptime_ms() < _retry_at_ms;
+}
+
+HTTPClient *HttpConnection::begin(const String &path) {
+	if (backing_off()) {
+		return nullptr;
+	}
+
+	// connected() peeks at the socket, so this also catches a server that has closed it
+	if (_http.connected() && uptime_ms() - _last_used_ms > HTTP_KEEPALIVE_IDLE_MS) {
+		close();
+	}
+	_reused = _http.connected();
+
+	// Given our own client, HTTPClient sends on it if it's already connected and only connects
+	// by name if it isn't
+	_http.begin(_client, _host, _port, path);
+	_http.setReuse(true);
+	_http.setTimeout(HTTP_TIMEOUT_MS);
+	_http.setConnectTimeout(HTTP_CONNECT_TIMEOUT_MS);
+	return &_http;
+}
+
+bool HttpConnection::_stale_socket_error(int code) const {
+	return code == HTTPC_ERROR_SEND_HEADER_FAILED || code == HTTPC_ERROR_SEND_PAYLOAD_FAILED ||
+		code == HTTPC_ERROR_NOT_CONNECTED || code == HTTPC_ERROR_CONNECTION_LOST;
+}
+
+// Open the socket to the cached address, if there is one and it isn't open already
+bool HttpConnection::_connect() {
+	if (_address.length() == 0 || _client.connected()) {
+		return true;
+	}
+	return _client.connect(_address.c_str(), _port, HTTP_CONNECT_TIMEOUT_MS);
+}
+
+int HttpConnection::send(const char *method, const uint8_t *payload, size_t size) {
+	_requests++;
+	if (_reused) {
+		_reuses++;
+	} else {
+		_connects++;
+	}
+
+	int code = _connect() ? _http.sendRequest(method, (uint8_t *) payload, size) : HTTPC_ERROR_CONNECTION_REFUSED;
+
+	// The server may have timed out the connection just as we used it.  Stopping the socket
+	// keeps the request's headers, so it can go straight out again on a new connection.
+	if (_reused && _stale_socket_error(code)) {
+		_retries++;
+		_connects++;
+		_client.stop();
+		code = _connect() ? _http.sendRequest(method, (uint8_t *) payload, size) : HTTPC_ERROR_CONNECTION_REFUSED;
+	}
+
+	if (code < 0) {
+		_failures++;
+		_backoff_ms = _backoff_ms == 0 ? HTTP_BACKOFF_MIN_MS : _backoff_ms * 2;
+		if (_backoff_ms > HTTP_BACKOFF_MAX_MS) {
+			_backoff_ms = HTTP_BACKOFF_MAX_MS;
+		}
+		_retry_at_ms = uptime_ms() + _backoff_ms;
+		LOG_WARNING("%s connection failed (%s), retrying in %us", _name, HTTPClient::errorToString(code).c_str(),
+			(unsigned) (_backoff_ms / 1000));
+	} else {
+		_backoff_ms = 0;
+		_retry_at_ms = 0;
+	}
+
+	return code;
+}
+
+void HttpConnection::end() {
+	// Drains anything left of the response and keeps the socket if the server allows it
+	_http.end();
+	_last_used_ms = uptime_ms();
+}
+
+void HttpConnection::close() {
+	_client.stop();
+	_http.end();
+}
+
+String HttpConnection::stats() const {
+	return String(_name) + "(requests=" + String(_requests) + " reused=" + String(_reuses) +
+		" connects=" + String(_connects) + " retries=" + String(_retries) +
+		" failures=" + String(_failures) + (backing_off() ? " backing off" : "") + ")";
+}
@@ -0,0 +1,98 @@
+#ifndef HTTPCONNECTION_H
+#define HTTPCONNECTION_H
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+
+#include "LogQueue.h"
+#include "Clock.h"
+
+#define HTTP_TIMEOUT_MS 5000
+#define HTTP_CONNECT_TIMEOUT_MS 3000
+
+// A connection unused for longer than this has probably been dropped by the server or a NAT
+// along the way, so open a fresh one rather than finding out mid-request
+#ifndef HTTP_KEEPALIVE_IDLE_MS
+#define HTTP_KEEPALIVE_IDLE_MS (5 * 60 * 1000)
+#endif
+
+// After a connection failure, wait this long before trying the endpoint again, doubling up to
+// the max while it stays unreachable.  Requests are made once per collection period, so
+// anything shorter than that makes no difference.
+#define HTTP_BACKOFF_MIN_MS (60 * 1000)
+#define HTTP_BACKOFF_MAX_MS (10 * 60 * 1000)
+
+// A persistent HTTP/1.1 connection to one server.  Requests reuse the open socket when the
+// server keeps it alive, so a collection period costs one TCP setup instead of one per request.
+//
+//    HTTPClient *http = connection.begin("/path");
+//    if (http) {
+//        http->addHeader(...);
+//        int code = connection.send("GET");
+//        ... read the response from http ...
+//        connection.end();
+//    }
+//
+// The socket can be opened to an address looked up ahead of time (see set_address()) while the
+// requests still carry the server's name in their Host header.
+//
+// Only used from the network task, so there is no locking.
+class HttpConnection {
+    private:
+	const char *_name;
+	String _host;
+	uint16_t _port;
+	String _address;
+	WiFiClient _client;
+	HTTPClient _http;
+
+	uint64_t _last_used_ms = 0;
+	uint64_t _retry_at_ms = 0;
+	uint32_t _backoff_ms = 0;
+	// Whether the current request went out on a socket left open by an earlier one
+	bool _reused = false;
+
+	uint32_t _requests = 0;
+	uint32_t _reuses = 0;
+	uint32_t _connects = 0;
+	uint32_t _retries = 0;
+	uint32_t _failures = 0;
+
+	bool _stale_socket_error(int code) const;
+	bool _connect();
+
+    public:
+	HttpConnection(const char *name, const String &host, uint16_t port);
+
+	// Point the connection at a different server, closing the current socket if it changed
+	void set_host(const String &host, uint16_t port);
+
+	// Connect to `address`, e.g. from HostResolver, rather than looking the host up on each new
+	// connection.  Requests still name the host in their Host header, which virtual hosts and
+	// reverse proxies route on.  Empty connects by name.
+	void set_address(const String &address);
+
+	// Start a request for `path`.  Returns the client so the caller can add headers, or nullptr
+	// while backing off after the server couldn't be reached.
+	HTTPClient *begin(const String &path);
+
+	// Send the request started by begin().  A reused socket the server has closed in the
+	// meantime is retried once on a new connection.  Returns the HTTP status or a negative
+	// HTTPC_ERROR_* code.
+	int send(const char *method, const uint8_t *payload = nullptr, size_t size = 0);
+
+	// Finish reading the response, leaving the socket open for the next request
+	void end();
+
+	void close();
+
+	bool backing_off() const;
+
+	uint32_t requests() const { return _requests; }
+	uint32_t reuses() const { return _reuses; }
+	uint32_t connects() const { return _connects; }
+
+	String stats() const;
+};
+
+#endif
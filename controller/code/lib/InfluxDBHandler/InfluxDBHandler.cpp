@@ -1,62 +1,309 @@
 #include <InfluxDBHandler.h>
 #include "WirelessControl.h"
+#include <time.h>
 
-extern Logger *LOGGER;
+#if __has_include(<esp_task_wdt.h>)
+#include <esp_task_wdt.h>
+#define INFLUX_FEED_WATCHDOG() esp_task_wdt_reset()
+#else
+#define INFLUX_FEED_WATCHDOG()
+#endif
 
-InfluxDBHandler::InfluxDBHandler(const String &url, const String &db, const char *device) : _device(device) {
-    LOGGER->log("Initializing InfluxDBHandler");
-    Serial.println("Initialziing InfluxDB: ");
+// Anything earlier means NTP hasn't synced yet; let the server timestamp those points
+#define MIN_VALID_TIMESTAMP 1600000000
 
-    _client = new InfluxDBClient(url, db);
+// Split an http://host:port/base URL into its parts; the port defaults to 80
+static void parse_url(const String &url, String &host, uint16_t &port, String &base_path) {
+    int host_start = url.indexOf("://");
+    host_start = host_start < 0 ? 0 : host_start + 3;
 
-    if (_client->validateConnection()) {
-        Serial.println("\tConnected to InfluxDB: " + _client->getServerUrl());
-        LOGGER->log("Connected to InfluxDB at " + _client->getServerUrl());
-    } else {
-        Serial.println("\tInfluxDB connection failed: " + _client->getLastErrorMessage());
-        LOGGER->log_error("InfluxDB connection failed: " + _client->getLastErrorMessage());
+    int path_start = url.indexOf("/", host_start);
+    if (path_start < 0) {
+        path_start = url.length();
+    }
+
+    String authority = url.substring(host_start, path_start);
+    int colon = authority.indexOf(":");
+    host = colon < 0 ? authority : authority.substring(0, colon);
+    port = colon < 0 ? 80 : authority.substring(colon + 1).toInt();
+
+    base_path = url.substring(path_start);
+    if (base_path.endsWith("/")) {
+        base_path = base_path.substring(0, base_path.length() - 1);
     }
+}
+
+InfluxDBHandler::InfluxDBHandler(const String &url, const String &db, const char *device) : _connection("influxdb", "", 0), _url(url), _device(device),
+    _sensor_prefixes("weather", device, "sensor_id"), _event_prefixes("events", device, "reason"), _udp(device) {
+    LOG_INFO("Initializing InfluxDBHandler");
+
+    uint16_t port;
+    String base_path;
+    parse_url(url, _host, port, base_path);
+    _connection.set_host(_host, port);
+
+    // Points are timestamped when recorded since they may be sent much later
+    _write_path = base_path + "/write?db=" + db + "&precision=s";
+
+    _validate_connection();
 
     if (WirelessControl::is_connected) {
-        LOGGER->log("Logging events to InfluxDB is enabled");
+        LOG_INFO("Logging events to InfluxDB is enabled");
+    }
+}
+
+void InfluxDBHandler::_validate_connection() {
+    HTTPClient *http = _connection.begin("/ping");
+    int code = http ? _connection.send("GET") : HTTPC_ERROR_CONNECTION_REFUSED;
+    _connection.end();
+
+    if (code == HTTP_CODE_NO_CONTENT) {
+        LOG_INFO("Connected to InfluxDB at %s", _url.c_str());
+    } else {
+        _last_error = code < 0 ? HTTPClient::errorToString(code) : "HTTP " + String(code);
+        LOG_ERROR("InfluxDB connection failed: %s", _last_error.c_str());
     }
 }
 
-bool InfluxDBHandler::write_sensor_metric(const char *sensor_id, const String &measurement, float value) {
-    Point sensor("weather");
-    sensor.addTag("device", _device);
-    sensor.addTag("sensor_id", sensor_id);
-    sensor.addField(measurement, value);
+// Point the connection and the UDP sender at the server's cached address.  False if its name
+// didn't resolve recently, in which case there's no point trying to send.
+bool InfluxDBHandler::_resolve() {
+    String address;
+    if (!_resolver) {
+        return true;
+    }
+    if (_resolver->resolve(_host, address) == RESOLVE_FAILED) {
+        return false;
+    }
 
-    return _write_metric(&sensor);
+    _connection.set_address(address);
+    _udp.set_destination(address, _udp_port);
+    return true;
 }
 
-bool InfluxDBHandler::write_event_metric(const String &event_type, bool state, const char *reason) {
-    Point event("events");
-    event.addTag("device", _device);
-    event.addTag("reason", reason);
-    event.addField(event_type, state);
+void InfluxDBHandler::enable_udp(uint16_t port) {
+    _udp_port = port;
+    _udp.set_destination(_host, port);
 
-    return _write_metric(&event);
+    if (port > 0) {
+        LOG_INFO("Sending sensor metrics to InfluxDB over UDP port %u", port);
+    }
 }
 
-bool InfluxDBHandler::_write_metric(Point *point) {
+void InfluxDBHandler::enable_spill(bool fs_mounted) {
+    _backlog.begin(fs_mounted);
+}
+
+void InfluxDBHandler::set_compression_level(uint8_t level) {
+    _compress = level > 0;
+    if (_compress) {
+        _gzip.set_level(level);
+    }
+}
+
+bool InfluxDBHandler::write_sensor_metric(const char *sensor_id, const char *measurement, float value) {
+    return _record(false, sensor_id, measurement, value, false);
+}
+
+bool InfluxDBHandler::write_event_metric(const char *event_type, bool state, const char *reason) {
+    return _record(true, reason, event_type, 0, state);
+}
+
+bool InfluxDBHandler::_record(bool is_event, const char *tag, const char *field, float value, bool state) {
+    ALLOC_SITE("InfluxDBHandler::record");
+
+    MetricRecord record;
+    record.timestamp = time(nullptr);
+    record.is_event = is_event;
+    strlcpy(record.tag, tag, sizeof(record.tag));
+    strlcpy(record.field, field, sizeof(record.field));
+    record.value = value;
+    record.state = state;
+
+    if (!_queue.push(record)) {
+        _records_dropped++;
+        return false;
+    }
+    return true;
+}
+
+void InfluxDBHandler::_format_queued() {
+    ALLOC_SITE("InfluxDBHandler::format");
+
+    MetricRecord record;
+    while (_queue.pop(record)) {
+        // Events must not be lost, so they always go over HTTP
+        if (_udp_port > 0 && !record.is_event) {
+            _write_udp(record);
+        } else {
+            _write_batch(record);
+        }
+    }
+}
+
+// Encode the record as a line of line protocol.  False if it didn't fit or couldn't be encoded.
+bool InfluxDBHandler::_encode(const MetricRecord &record, LineEncoder &line) {
+    LinePrefixCache &prefixes = record.is_event ? _event_prefixes : _sensor_prefixes;
+    const LinePrefix *prefix = prefixes.get(record.tag);
+
+    if (prefix) {
+        line.begin(prefix->prefix, prefix->length);
+    } else {
+        line.begin(record.is_event ? "events" : "weather");
+        line.tag("device", _device);
+        line.tag(record.is_event ? "reason" : "sensor_id", record.tag);
+    }
+
+    if (record.is_event) {
+        line.field(record.field, record.state);
+    } else {
+        line.field(record.field, record.value);
+    }
+    if (record.timestamp >= MIN_VALID_TIMESTAMP) {
+        line.timestamp(record.timestamp);
+    }
+
+    if (line.end()) {
+        _points_queued++;
+        return true;
+    }
+
+    // A bad value won't do any better with more room
+    if (line.invalid()) {
+        _records_invalid++;
+        LOG_ERROR("Dropping %s %s from %s: not a number", record.is_event ? "event" : "metric", record.field, record.tag);
+    }
+    return false;
+}
+
+void InfluxDBHandler::_write_batch(const MetricRecord &record) {
+    while (true) {
+        LineEncoder line(_batch + _batch_len, INFLUX_BATCH_BYTES - 1 - _batch_len);
+        if (_encode(record, line)) {
+            _batch_len += line.length();
+            return;
+        }
+
+        // Make room if this point won't fit in the current batch
+        if (!line.overflowed() || _batch_len == 0) {
+            return;
+        }
+        _stash_batch();
+    }
+}
+
+void InfluxDBHandler::_write_udp(const MetricRecord &record) {
+    while (true) {
+        LineEncoder line(_udp.line_buffer(), _udp.line_capacity());
+        if (_encode(record, line)) {
+            _udp.commit_line(line.length());
+            return;
+        }
+
+        // Send the packet so far and start a new one
+        if (!line.overflowed() || _udp.empty()) {
+            return;
+        }
+        _udp.flush();
+    }
+}
+
+void InfluxDBHandler::_stash_batch() {
+    if (_batch_len == 0) {
+        return;
+    }
+
+    _backlog.push(_batch, _batch_len);
+    _batch_len = 0;
+}
+
+bool InfluxDBHandler::flush() {
+    ALLOC_SITE("InfluxDBHandler::flush");
+
+    bool resolved = _resolve();
+    _format_queued();
+    _udp.flush();
+
+    // Everything goes through the backlog so points are always sent oldest first
+    _stash_batch();
+
     if (!WirelessControl::is_connected) {
         return true;
     }
 
-    if (!_client->writePoint(*point)) {
-        String error_msg = last_error();
-        if (error_msg.length() > 0) {
-            LOGGER->log_error("Failed to write metric: " + error_msg);
-            Serial.println("Failed to write point " + point->toLineProtocol() + ": " + error_msg);
-        } else {
-            LOGGER->log_error("Failed to write metric: Unknown InfluxDB error");
-            Serial.println("Failed to write point " + point->toLineProtocol() + ": Unknown InfluxDB error");
+    if (!resolved) {
+        _last_error = "server name didn't resolve";
+        return false;
+    }
+
+    // With the batch stashed its buffer is free to stage each request
+    for (int i = 0; i < INFLUX_MAX_REQUESTS_PER_FLUSH && !_backlog.empty(); i++) {
+        size_t len = _backlog.read_lines(_batch, INFLUX_BATCH_BYTES - 1);
+        if (len == 0) {
+            continue;
         }
+
+        // Each request can take most of HTTP_TIMEOUT_MS, so a full catch up would outlast the
+        // watchdog if it were only fed once per flush
+        bool sent = _send(_batch, len);
+        INFLUX_FEED_WATCHDOG();
+        if (!sent) {
+            return false;
+        }
+        _backlog.consume(len);
+    }
+
+    return true;
+}
+
+void InfluxDBHandler::send_samples() {
+    _resolve();
+    _format_queued();
+    _udp.flush();
+}
+
+bool InfluxDBHandler::_send(char *lines, size_t len) {
+    HTTPClient *http = _connection.begin(_write_path);
+    if (!http) {
+        _last_error = "server unreachable, backing off";
         return false;
     }
 
+    http->addHeader("Content-Type", "text/plain; charset=utf-8");
+
+    // The final newline is dropped; the server doesn't need it
+    const uint8_t *payload = (const uint8_t *) lines;
+    size_t payload_len = len - 1;
+
+    // Sent as is if compressing wouldn't make it any smaller
+    size_t compressed_len = _compress ? _gzip.compress(payload, payload_len, _compressed, payload_len) : 0;
+    if (compressed_len > 0) {
+        http->addHeader("Content-Encoding", "gzip");
+        payload = _compressed;
+        payload_len = compressed_len;
+    }
+
+    int code = _connection.send("POST", payload, payload_len);
+
+    if (code == HTTP_CODE_NO_CONTENT) {
+        _last_error = "";
+    } else if (code < 0) {
+        _last_error = HTTPClient::errorToString(code);
+    } else {
+        // InfluxDB explains a rejected write in the body
+        _last_error = "HTTP " + String(code) + ": " + http->getString();
+    }
+    _connection.end();
+
+    if (code != HTTP_CODE_NO_CONTENT) {
+        _send_failures++;
+        LOG_ERROR("Failed to write metrics: %s", _last_error.length() > 0 ? _last_error.c_str() : "Unknown InfluxDB error");
+        return false;
+    }
+
+    _requests_sent++;
+    _bytes_sent += payload_len;
+    _raw_bytes_sent += len - 1;
     return true;
 }
 
@@ -84,5 +331,15 @@ bool InfluxDBHandler::event_mist_off(const char *reason) {
 }
 
 String InfluxDBHandler::last_error() {
-    return _client->getLastErrorMessage();
+    return _last_error;
+}
+
+String InfluxDBHandler::stats() {
+    return "points=" + String(_points_queued) + ", requests=" + String(_requests_sent) +
+        ", bytes=" + String(_bytes_sent) + ", raw_bytes=" + String(_raw_bytes_sent) + ", failures=" + String(_send_failures) +
+        ", backlog=" + String(_backlog.pending_bytes()) + ", spilled=" + String(_backlog.spilled_bytes()) +
+        ", dropped=" + String(_backlog.dropped_bytes()) +
+        ", queue_dropped=" + String(_records_dropped) + ", invalid=" + String(_records_invalid) +
+        ", prefix_misses=" + String(_sensor_prefixes.misses() + _event_prefixes.misses()) +
+        (_udp_port > 0 ? ", udp(" + _udp.stats() + ")" : "");
 }
@@ -2,24 +2,104 @@
 #define INFLUXDBHANDLER_H
 
 #include <Arduino.h>
-#include <InfluxDbClient.h>
-#include <InfluxDbCloud.h>
+#include <HTTPClient.h>
 
-#include "Logger.h"
+#include "LogQueue.h"
+#include "GzipEncoder.h"
+#include "HeapMonitor.h"
+#include "HostResolver.h"
+#include "HttpConnection.h"
+#include "LineEncoder.h"
+#include "MetricBuffer.h"
+#include "SpscQueue.h"
+#include "UdpLineSender.h"
+
+// Line protocol collected between flushes and sent as one request
+#ifndef INFLUX_BATCH_BYTES
+#define INFLUX_BATCH_BYTES (4 * 1024)
+#endif
+
+// Limit how much backlog is sent per flush so catching up doesn't starve the loop.  flush() feeds
+// the task watchdog after each request, as this many slow ones add up to more than WDT_TIMEOUT_S.
+#define INFLUX_MAX_REQUESTS_PER_FLUSH 8
+
+// Metrics recorded by the control task waiting to be formatted and sent by the network task.
+// A collection period produces around 10-20.
+#define INFLUX_QUEUE_DEPTH 64
+
+// A metric as recorded, before it is turned into line protocol.  Fixed size so it can be
+// copied through the queue without allocating.
+struct MetricRecord {
+    uint32_t timestamp;
+    bool is_event;
+    // sensor_id for sensor metrics, reason for events
+    char tag[48];
+    // measurement for sensor metrics, event type for events
+    char field[24];
+    float value;
+    bool state;
+};
 
 class InfluxDBHandler {
     private:
-    InfluxDBClient *_client;
+    // Batches are POSTed straight to the v1 write API over a persistent connection
+    HttpConnection _connection;
+    String _url;
+    String _host;
+    HostResolver *_resolver = nullptr;
+    String _write_path;
+    String _last_error;
 
     const char *_device;
 
-    bool _write_metric(Point *point);
+    // "weather,device=...,sensor_id=..." and "events,device=...,reason=..." line prefixes
+    LinePrefixCache _sensor_prefixes;
+    LinePrefixCache _event_prefixes;
+
+    // Points are formatted into _batch and sent by flush(); anything that can't be sent
+    // right away waits in the backlog
+    char _batch[INFLUX_BATCH_BYTES];
+    size_t _batch_len = 0;
+    MetricBuffer _backlog;
+
+    // Each request is compressed from _batch into here
+    GzipEncoder _gzip;
+    uint8_t _compressed[INFLUX_BATCH_BYTES];
+    bool _compress = false;
+
+    // With a UDP port set, sensor metrics go over UDP and only events are POSTed
+    UdpLineSender _udp;
+    uint16_t _udp_port = 0;
+
+    // Filled by the control task, drained by flush() on the network task
+    SpscQueue<MetricRecord, INFLUX_QUEUE_DEPTH> _queue;
+    uint32_t _records_dropped = 0;
+    // Records whose value can't be written as line protocol (NaN)
+    uint32_t _records_invalid = 0;
+
+    uint32_t _points_queued = 0;
+    uint32_t _requests_sent = 0;
+    uint32_t _bytes_sent = 0;
+    // Line protocol sent, before compression
+    uint32_t _raw_bytes_sent = 0;
+    uint32_t _send_failures = 0;
+
+    bool _record(bool is_event, const char *tag, const char *field, float value, bool state);
+    bool _encode(const MetricRecord &record, LineEncoder &line);
+    void _write_batch(const MetricRecord &record);
+    void _write_udp(const MetricRecord &record);
+    void _format_queued();
+    void _stash_batch();
+    bool _send(char *lines, size_t len);
+    void _validate_connection();
+    bool _resolve();
 
     public:
     InfluxDBHandler(const String &serverUrl, const String &db, const char *device);
 
-    bool write_sensor_metric(const char *sensor_id, const String &measurement, float value);
-    bool write_event_metric(const String &event_type, bool state, const char *reason);
+    // These only record the metric, without allocating, so they are safe to call from the control task
+    bool write_sensor_metric(const char *sensor_id, const char *measurement, float value);
+    bool write_event_metric(const char *event_type, bool state, const char *reason);
     
     bool event_fan_on(const char *reason);
     bool event_fan_off(const char *reason);
@@ -28,7 +108,36 @@ class InfluxDBHandler {
     bool event_mist_on(const char *reason);
     bool event_mist_off(const char *reason);
 
+    // Send sensor metrics to InfluxDB's UDP listener on `port`, on the same host, rather than
+    // POSTing them.  Events are still POSTed so none are lost.  0 turns UDP off.
+    void enable_udp(uint16_t port);
+
+    // Let the backlog spill to LittleFS once it outgrows RAM, if it has been mounted.  Until
+    // this is called the backlog is RAM only.
+    void enable_spill(bool fs_mounted);
+
+    // Send everything queued since the last flush, plus any backlog.  Call once per collection
+    // period from the network task.
+    bool flush();
+
+    // Send the sensor metrics queued so far over UDP, holding any events for the next flush().
+    // Call from the network task as often as samples are taken.
+    void send_samples();
+
+    // 1-9 sends requests with Content-Encoding: gzip at that level; 0, the default, sends them as is
+    void set_compression_level(uint8_t level);
+
+    // Connect, and send UDP, to the server's cached address rather than resolving its name
+    void set_resolver(HostResolver *resolver) {
+        _resolver = resolver;
+    }
+
     String last_error();
+    String stats();
+
+    const HttpConnection &connection() const {
+        return _connection;
+    }
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,142 @@
+#include "LatencyHistogram.h"
+
+LatencyHistogram::LatencyHistogram() {
+	reset();
+}
+
+uint16_t LatencyHistogram::_bucket(uint32_t us) {
+	if (us < 2 * LATENCY_SUB_BUCKETS) {
+		return us;
+	}
+
+	// Keep the top LATENCY_SUB_BUCKET_BITS + 1 bits; the shift picks the power of two range
+	uint8_t msb = 31 - __builtin_clz(us);
+	uint8_t shift = msb - LATENCY_SUB_BUCKET_BITS;
+	uint16_t bucket = 2 * LATENCY_SUB_BUCKETS + (shift - 1) * LATENCY_SUB_BUCKETS + (us >> shift) - LATENCY_SUB_BUCKETS;
+
+	return bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1;
+}
+
+uint32_t LatencyHistogram::_bucket_low(uint16_t bucket) {
+	return bucket ? _bucket_high(bucket - 1) + 1 : 0;
+}
+
+uint32_t LatencyHistogram::_bucket_high(uint16_t bucket) {
+	if (bucket < 2 * LATENCY_SUB_BUCKETS) {
+		return bucket;
+	}
+
+	uint8_t shift = (bucket - 2 * LATENCY_SUB_BUCKETS) / LATENCY_SUB_BUCKETS + 1;
+	uint32_t top = (bucket - 2 * LATENCY_SUB_BUCKETS) % LATENCY_SUB_BUCKETS + LATENCY_SUB_BUCKETS;
+	return ((top + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint32_t us) {
+	_counts[_bucket(us)]++;
+	_total++;
+	_sum_us += us;
+
+	if (us < _min_us) {
+		_min_us = us;
+	}
+	if (us > _max_us) {
+		_max_us = us;
+	}
+}
+
+void LatencyHistogram::reset() {
+	memset(_counts, 0, sizeof(_counts));
+	_total = 0;
+	_min_us = UINT32_MAX;
+	_max_us = 0;
+	_sum_us = 0;
+}
+
+LatencyHistogram LatencyHistogram::since(const LatencyHistogram &earlier) const {
+	LatencyHistogram window;
+
+	// The recording task may be part way through a sample while this one is read, so take the
+	// total from the buckets rather than trusting _total to match them
+	for (uint16_t bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+		uint32_t count = _counts[bucket] - earlier._counts[bucket];
+		if (count == 0 || count > _counts[bucket]) {
+			continue;
+		}
+
+		window._counts[bucket] = count;
+		window._total += count;
+		window._min_us = std::min(window._min_us, std::max(_bucket_low(bucket), min_us()));
+		window._max_us = std::max(window._max_us, std::min(_bucket_high(bucket), _max_us));
+	}
+
+	if (window._total && _sum_us > earlier._sum_us) {
+		window._sum_us = _sum_us - earlier._sum_us;
+	}
+	return window;
+}
+
+uint32_t LatencyHistogram::count() const {
+	return _total;
+}
+
+uint32_t LatencyHistogram::min_us() const {
+	return _total ? _min_us : 0;
+}
+
+uint32_t LatencyHistogram::max_us() const {
+	return _max_us;
+}
+
+uint32_t LatencyHistogram::mean_us() const {
+	return _total ? _sum_us / _total : 0;
+}
+
+uint64_t LatencyHistogram::sum_us() const {
+	return _sum_us;
+}
+
+uint32_t LatencyHistogram::count_below(uint32_t us) const {
+	uint16_t last = _bucket(us);
+	uint32_t count = 0;
+	for (uint16_t bucket = 0; bucket < last; bucket++) {
+		count += _counts[bucket];
+	}
+	return count;
+}
+
+uint32_t LatencyHistogram::percentile(float percentile) const {
+	if (_total == 0) {
+		return 0;
+	}
+
+	uint32_t rank = ceil(_total * percentile / 100.0);
+	if (rank < 1) {
+		rank = 1;
+	}
+
+	uint32_t seen = 0;
+	for (uint16_t bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+		seen += _counts[bucket];
+		if (seen >= rank) {
+			// The bucket's upper edge can overshoot what was actually seen
+			return std::max(std::min(_bucket_high(bucket), _max_us), min_us());
+		}
+	}
+	return _max_us;
+}
+
+String LatencyHistogram::format_us(uint32_t us) {
+	if (us < 1000) {
+		return String(us) + "us";
+	} else if (us < 1000000) {
+		return String(us / 1000.0, 1) + "ms";
+	}
+	return String(us / 1000000.0, 2) + "s";
+}
+
+String LatencyHistogram::summary() const {
+	return "n=" + String(_total) +
+		" p50=" + format_us(percentile(50)) +
+		" p99=" + format_us(percentile(99)) +
+		" max=" + format_us(_max_us);
+}
@@ -0,0 +1,84 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <Arduino.h>
+
+#include "Clock.h"
+
+// Log-linear buckets, as in HdrHistogram: each power of two is split into
+// 2^LATENCY_SUB_BUCKET_BITS linear buckets, each 1/8 as wide as the values at its bottom.
+// Percentiles report a bucket's upper edge, so they can read up to 12.5% above the value
+// recorded.  Values below 2^(LATENCY_SUB_BUCKET_BITS + 1) us get a bucket each.
+#define LATENCY_SUB_BUCKET_BITS 3
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BUCKET_BITS)
+
+// Largest value tracked, about 67 seconds; anything longer lands in the last bucket
+#define LATENCY_MAX_BITS 26
+#define LATENCY_BUCKETS (2 * LATENCY_SUB_BUCKETS + (LATENCY_MAX_BITS - LATENCY_SUB_BUCKET_BITS - 1) * LATENCY_SUB_BUCKETS)
+
+// Distribution of durations in microseconds.  Recording is a few shifts and an increment, so it
+// can sit on every loop pass.
+//
+// Counts only ever grow, and only the task that records into a histogram writes to it.  Other
+// tasks read it as it is, and take a copy to measure a period against with since().
+class LatencyHistogram {
+    private:
+	uint32_t _counts[LATENCY_BUCKETS];
+	uint32_t _total;
+	uint32_t _min_us;
+	uint32_t _max_us;
+	uint64_t _sum_us;
+
+	static uint16_t _bucket(uint32_t us);
+	static uint32_t _bucket_low(uint16_t bucket);
+	static uint32_t _bucket_high(uint16_t bucket);
+
+    public:
+	LatencyHistogram();
+
+	void record(uint32_t us);
+	void reset();
+
+	// The samples recorded since `earlier`, a copy of this histogram taken before.  Min and max
+	// are only known to bucket precision.
+	LatencyHistogram since(const LatencyHistogram &earlier) const;
+
+	uint32_t count() const;
+	uint32_t min_us() const;
+	uint32_t max_us() const;
+	uint32_t mean_us() const;
+	uint64_t sum_us() const;
+
+	// Samples below `us`; exact when `us` is a power of two, as those start a range of buckets
+	uint32_t count_below(uint32_t us) const;
+
+	// The value `percentile` percent of samples were at or below, to bucket precision
+	uint32_t percentile(float percentile) const;
+
+	// e.g. "n=120 p50=180us p99=2.1ms max=3.4ms"
+	String summary() const;
+
+	static String format_us(uint32_t us);
+};
+
+// Records the time from construction to the end of the enclosing scope
+class ScopedLatency {
+    private:
+	LatencyHistogram &_histogram;
+	uint64_t _start_us;
+
+    public:
+	ScopedLatency(LatencyHistogram &histogram) : _histogram(histogram), _start_us(uptime_us()) {}
+	~ScopedLatency() {
+		_histogram.record(uptime_us() - _start_us);
+	}
+};
+
+// A histogram, the name it is reported under, and a copy of it as of the last heartbeat
+struct LatencyProbe {
+	const char *name;
+	LatencyHistogram *histogram;
+	LatencyHistogram *baseline;
+};
+
+#endif
@@ -1,14 +1,12 @@
 #include "LightSensor.h"
 
-extern Logger *LOGGER;
-
 LightSensor::LightSensor(): _tsl(SENSOR_ID) {
 	if (_tsl.begin()) {
 		Serial.println(F("Found a TSL2591 sensor"));
 		_initialized = true;
 	  } else {
 		Serial.println(F("No sensor found ... check your wiring?"));
-		LOGGER->log_error("No TSL2591 light sensor found.");
+		LOG_ERROR("No TSL2591 light sensor found.");
 		return;
 	  }
 		
@@ -63,6 +61,74 @@ void LightSensor::read() {
 	_lum = _tsl.getFullLuminosity();
 }
 
+void LightSensor::start_read() {
+	if (!_initialized) {
+		return;
+	}
+
+	// The sensor integrates on its own once enabled
+	_tsl.enable();
+	_integration_start_ms = uptime_ms();
+	_integrating = true;
+}
+
+unsigned long LightSensor::integration_time_ms() {
+	// Integration times run from 100ms (0) to 600ms (5); allow the same margin the library does
+	return (_tsl.getTiming() + 1) * 120;
+}
+
+bool LightSensor::read_ready() {
+	if (!_integrating) {
+		return false;
+	}
+
+	if (uptime_ms() - _integration_start_ms < integration_time_ms()) {
+		return false;
+	}
+
+	// Wait for the ALS valid bit in case the clock ran a little slow
+	return _tsl.getStatus() & TSL2591_STATUS_AVALID;
+}
+
+bool LightSensor::finish_read() {
+	if (!_integrating) {
+		return false;
+	}
+
+	// Read both channels in one transaction, as getFullLuminosity() does, without its delay
+	Wire.beginTransmission(TSL2591_ADDR);
+	Wire.write(TSL2591_COMMAND_BIT | TSL2591_REGISTER_CHAN0_LOW);
+	bool ok = Wire.endTransmission() == 0 && Wire.requestFrom(TSL2591_ADDR, 4) == 4;
+
+	if (ok) {
+		uint8_t data[4];
+		for (int i = 0; i < 4; i++) {
+			data[i] = Wire.read();
+		}
+
+		uint16_t full = data[0] | (data[1] << 8);
+		uint16_t ir = data[2] | (data[3] << 8);
+		_lum = ((uint32_t) ir << 16) | full;
+	}
+
+	_tsl.disable();
+	_integrating = false;
+	return ok;
+}
+
+void LightSensor::cancel_read() {
+	_tsl.disable();
+	_integrating = false;
+}
+
+bool LightSensor::is_reading() const {
+	return _integrating;
+}
+
+bool LightSensor::is_initialized() const {
+	return _initialized;
+}
+
 uint32_t LightSensor::getFullLuminosity() {
 	return _lum & 0xFFFF;
 }
@@ -5,24 +5,42 @@
 #include <Adafruit_Sensor.h>
 #include "Adafruit_TSL2591.h"
 
-#include "Logger.h"
+#include "LogQueue.h"
+#include "Clock.h"
 
 // This seems arbitrary, but keep what was used in the example
 #define SENSOR_ID 2591
 
+// Bit in the status register set once an integration cycle has completed
+#define TSL2591_STATUS_AVALID 0x01
+
 class LightSensor {
     private:
 	Adafruit_TSL2591 _tsl;
 	uint32_t _lum;
 	bool _initialized = false;
 
+	bool _integrating = false;
+	uint64_t _integration_start_ms = 0;
+
     public:
 
     LightSensor();
 	void displayInfo();
 	void configure();
 
+	// Blocking read, waits out the integration time
 	void read();
+	bool is_initialized() const;
+
+	// Non-blocking read: power up and start integrating, then collect once it is done
+	void start_read();
+	unsigned long integration_time_ms();
+	bool read_ready();
+	// False if the result couldn't be read back, in which case the last reading is kept
+	bool finish_read();
+	void cancel_read();
+	bool is_reading() const;
 	uint32_t getFullLuminosity();
 	uint16_t getIR();
 	uint32_t getVisible();
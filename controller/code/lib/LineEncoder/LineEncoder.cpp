@@ -0,0 +1,195 @@
+#include "LineEncoder.h"
+
+#include <math.h>
+#include <string.h>
+
+// Characters that need a backslash in each part of a line
+#define ESCAPE_MEASUREMENT ", "
+#define ESCAPE_KEY ",= "
+
+static const uint64_t POWERS_OF_TEN[LINE_MAX_DECIMALS + 1] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+
+LineEncoder::LineEncoder(char *out, size_t capacity) : _out(out), _capacity(capacity) {
+}
+
+void LineEncoder::_append(const char *text, size_t len) {
+	if (_overflow || _length + len > _capacity) {
+		_overflow = true;
+		return;
+	}
+	memcpy(_out + _length, text, len);
+	_length += len;
+}
+
+void LineEncoder::_append(char c) {
+	if (_overflow || _length >= _capacity) {
+		_overflow = true;
+		return;
+	}
+	_out[_length++] = c;
+}
+
+void LineEncoder::_append_escaped(const char *text, const char *special) {
+	for (const char *c = text; *c; c++) {
+		if (strchr(special, *c)) {
+			_append('\\');
+		}
+		_append(*c);
+	}
+}
+
+void LineEncoder::_append_unsigned(uint64_t value, uint8_t min_digits) {
+	// Digits come out backwards
+	char digits[20];
+	uint8_t count = 0;
+	do {
+		digits[count++] = '0' + value % 10;
+		value /= 10;
+	} while (value > 0 || count < min_digits);
+
+	while (count > 0) {
+		_append(digits[--count]);
+	}
+}
+
+void LineEncoder::_field_name(const char *name) {
+	_append(_has_field ? ',' : ' ');
+	_has_field = true;
+	_append_escaped(name, ESCAPE_KEY);
+	_append('=');
+}
+
+void LineEncoder::begin(const char *measurement) {
+	_append_escaped(measurement, ESCAPE_MEASUREMENT);
+}
+
+void LineEncoder::begin(const char *prefix, size_t len) {
+	_append(prefix, len);
+}
+
+void LineEncoder::tag(const char *name, const char *value) {
+	_append(',');
+	_append_escaped(name, ESCAPE_KEY);
+	_append('=');
+	_append_escaped(value, ESCAPE_KEY);
+}
+
+void LineEncoder::field(const char *name, float value, uint8_t decimals) {
+	if (decimals > LINE_MAX_DECIMALS) {
+		decimals = LINE_MAX_DECIMALS;
+	}
+
+	// Fixed point, rounded half away from zero and signed like dtostrf(), so -0.001 is "-0.00".
+	// Anything that won't fit in 63 bits once scaled is as unwritable as NaN.
+	double scaled = fabs((double) value) * POWERS_OF_TEN[decimals] + 0.5;
+	if (isnan(value) || scaled >= 9.2e18) {
+		_invalid = true;
+		return;
+	}
+	uint64_t fixed = (uint64_t) scaled;
+
+	_field_name(name);
+	if (signbit(value)) {
+		_append('-');
+	}
+	_append_unsigned(fixed / POWERS_OF_TEN[decimals]);
+	if (decimals > 0) {
+		_append('.');
+		_append_unsigned(fixed % POWERS_OF_TEN[decimals], decimals);
+	}
+}
+
+void LineEncoder::field(const char *name, bool value) {
+	_field_name(name);
+	if (value) {
+		_append("true", 4);
+	} else {
+		_append("false", 5);
+	}
+}
+
+void LineEncoder::field(const char *name, int32_t value) {
+	_field_name(name);
+	if (value < 0) {
+		_append('-');
+	}
+	_append_unsigned(value < 0 ? -(int64_t) value : value);
+	_append('i');
+}
+
+void LineEncoder::timestamp(uint32_t seconds) {
+	_append(' ');
+	_append_unsigned(seconds);
+}
+
+bool LineEncoder::end() {
+	if (!_has_field) {
+		_invalid = true;
+	}
+	_append('\n');
+
+	if (_overflow || _invalid) {
+		_length = 0;
+		return false;
+	}
+	return true;
+}
+
+size_t LineEncoder::length() const {
+	return _length;
+}
+
+bool LineEncoder::overflowed() const {
+	return _overflow;
+}
+
+bool LineEncoder::invalid() const {
+	return _invalid;
+}
+
+LinePrefixCache::LinePrefixCache(const char *measurement, const char *device, const char *key_tag) :
+	_measurement(measurement), _device(device), _key_tag(key_tag) {
+}
+
+const LinePrefix *LinePrefixCache::get(const char *key) {
+	for (uint8_t i = 0; i < _count; i++) {
+		if (strcmp(_entries[i].key, key) == 0) {
+			_hits++;
+			return &_entries[i];
+		}
+	}
+	_misses++;
+
+	if (strlen(key) >= LINE_PREFIX_KEY_BYTES) {
+		return nullptr;
+	}
+
+	// Built aside so a prefix that doesn't fit leaves the entry it would replace intact
+	char line[LINE_PREFIX_BYTES];
+	LineEncoder prefix(line, sizeof(line));
+	prefix.begin(_measurement);
+	prefix.tag("device", _device);
+	prefix.tag(_key_tag, key);
+	if (prefix.overflowed()) {
+		return nullptr;
+	}
+
+	LinePrefix &entry = _entries[_next];
+	strcpy(entry.key, key);
+	memcpy(entry.prefix, line, prefix.length());
+	entry.length = prefix.length();
+
+	_next = (_next + 1) % LINE_PREFIX_CACHE_SIZE;
+	if (_count < LINE_PREFIX_CACHE_SIZE) {
+		_count++;
+	}
+	return &entry;
+}
+
+uint32_t LinePrefixCache::hits() const {
+	return _hits;
+}
+
+uint32_t LinePrefixCache::misses() const {
+	return _misses;
+}
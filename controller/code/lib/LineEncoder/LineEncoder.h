@@ -0,0 +1,101 @@
+#ifndef LINEENCODER_H
+#define LINEENCODER_H
+
+#include <Arduino.h>
+
+// Longest "measurement,device=...,sensor_id=..." prefix kept by LinePrefixCache
+#define LINE_PREFIX_BYTES 112
+#define LINE_PREFIX_KEY_BYTES 48
+#define LINE_PREFIX_CACHE_SIZE 8
+
+// Most decimal places a float field can be written with
+#define LINE_MAX_DECIMALS 6
+
+// Writes InfluxDB line protocol straight into a buffer the caller owns, e.g.
+//
+//   LineEncoder line(buffer, sizeof(buffer));
+//   line.begin("weather");
+//   line.tag("sensor_id", "DHT22");
+//   line.field("temperature", 68.5);
+//   line.timestamp(1750000000);
+//   if (line.end()) { ... line.length() bytes, ending in '\n' }
+//
+// Nothing is allocated, and numbers are formatted without printf.  If the line doesn't fit, or
+// a value can't be written (NaN), end() returns false and the partial line is left out of
+// length().  Tags must all come before the first field.
+class LineEncoder {
+    private:
+	char *_out;
+	size_t _capacity;
+	size_t _length = 0;
+	bool _has_field = false;
+	bool _overflow = false;
+	bool _invalid = false;
+
+	void _append(const char *text, size_t len);
+	void _append(char c);
+	void _append_escaped(const char *text, const char *special);
+	void _append_unsigned(uint64_t value, uint8_t min_digits = 1);
+	void _field_name(const char *name);
+
+    public:
+	LineEncoder(char *out, size_t capacity);
+
+	// Start the line with a measurement name, which is escaped
+	void begin(const char *measurement);
+	// Or with an already escaped "measurement,tag=value,..." prefix, see LinePrefixCache
+	void begin(const char *prefix, size_t len);
+
+	void tag(const char *name, const char *value);
+
+	void field(const char *name, float value, uint8_t decimals = 2);
+	void field(const char *name, bool value);
+	void field(const char *name, int32_t value);
+
+	// Seconds; leave it out to have the server timestamp the point
+	void timestamp(uint32_t seconds);
+
+	// Finish the line with '\n'.  False if it didn't fit or had nothing to write.
+	bool end();
+
+	// Bytes of the line so far, or the whole line after a successful end()
+	size_t length() const;
+
+	bool overflowed() const;
+	bool invalid() const;
+};
+
+struct LinePrefix {
+	char key[LINE_PREFIX_KEY_BYTES];
+	char prefix[LINE_PREFIX_BYTES];
+	uint8_t length;
+};
+
+// Escaped "measurement,device=<device>,<key tag>=<key>" prefixes for the few keys (sensor ids,
+// event reasons) a controller ever writes, built the first time each key is seen.  The oldest
+// entry is replaced once the cache is full.
+class LinePrefixCache {
+    private:
+	const char *_measurement;
+	const char *_device;
+	const char *_key_tag;
+
+	LinePrefix _entries[LINE_PREFIX_CACHE_SIZE];
+	uint8_t _count = 0;
+	uint8_t _next = 0;
+
+	uint32_t _hits = 0;
+	uint32_t _misses = 0;
+
+    public:
+	// The strings must outlive the cache
+	LinePrefixCache(const char *measurement, const char *device, const char *key_tag);
+
+	// nullptr if the prefix is too long to cache; the caller should encode the tags itself
+	const LinePrefix *get(const char *key);
+
+	uint32_t hits() const;
+	uint32_t misses() const;
+};
+
+#endif
@@ -0,0 +1,123 @@
+#include "LogQueue.h"
+
+#include <stdarg.h>
+
+LogEntry LogQueue::_entries[LOG_QUEUE_DEPTH];
+size_t LogQueue::_head = 0;
+size_t LogQueue::_count = 0;
+std::mutex LogQueue::_lock;
+
+LogSink LogQueue::_sinks[LOG_MAX_SINKS];
+uint8_t LogQueue::_sink_count = 0;
+void (*LogQueue::_wake)() = nullptr;
+
+std::atomic<uint32_t> LogQueue::_written{0};
+std::atomic<uint32_t> LogQueue::_dropped{0};
+std::atomic<uint32_t> LogQueue::_truncated{0};
+size_t LogQueue::_high_water = 0;
+
+void LogQueue::write(uint8_t level, const char *format, ...) {
+	char message[LOG_MESSAGE_BYTES];
+
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf(message, sizeof(message), format, args);
+	va_end(args);
+
+	if (length < 0) {
+		return;
+	}
+	if (length >= (int) sizeof(message)) {
+		length = sizeof(message) - 1;
+		_truncated++;
+	}
+	_written++;
+
+	if (!_wake) {
+		_dispatch(level, message);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(_lock);
+		if (_count == LOG_QUEUE_DEPTH) {
+			_dropped++;
+			return;
+		}
+
+		LogEntry &entry = _entries[(_head + _count) % LOG_QUEUE_DEPTH];
+		entry.level = level;
+		memcpy(entry.message, message, length + 1);
+
+		_count++;
+		if (_count > _high_water) {
+			_high_water = _count;
+		}
+	}
+	_wake();
+}
+
+void LogQueue::add_sink(LogSink sink) {
+	if (_sink_count < LOG_MAX_SINKS) {
+		_sinks[_sink_count++] = sink;
+	}
+}
+
+void LogQueue::set_wake(void (*wake)()) {
+	_wake = wake;
+}
+
+size_t LogQueue::flush(size_t max) {
+	size_t sent = 0;
+	LogEntry entry;
+
+	while (sent < max) {
+		{
+			std::lock_guard<std::mutex> guard(_lock);
+			if (_count == 0) {
+				break;
+			}
+
+			// Copy it out so the sinks run without holding the lock
+			const LogEntry &queued = _entries[_head];
+			entry.level = queued.level;
+			strcpy(entry.message, queued.message);
+
+			_head = (_head + 1) % LOG_QUEUE_DEPTH;
+			_count--;
+		}
+
+		_dispatch(entry.level, entry.message);
+		sent++;
+	}
+	return sent;
+}
+
+void LogQueue::_dispatch(uint8_t level, const char *message) {
+	for (uint8_t i = 0; i < _sink_count; i++) {
+		_sinks[i](level, message);
+	}
+}
+
+const char *LogQueue::level_name(uint8_t level) {
+	switch (level) {
+		case LOG_LEVEL_ERROR:
+			return "ERROR";
+		case LOG_LEVEL_WARNING:
+			return "WARN";
+		case LOG_LEVEL_INFO:
+			return "INFO";
+		case LOG_LEVEL_DEBUG:
+			return "DEBUG";
+	}
+	return "?";
+}
+
+uint32_t LogQueue::dropped() {
+	return _dropped;
+}
+
+String LogQueue::stats() {
+	return "written=" + String(_written.load()) + " dropped=" + String(_dropped.load()) +
+		" truncated=" + String(_truncated.load()) + " queue high water=" + String(_high_water) + "/" + String(LOG_QUEUE_DEPTH);
+}
@@ -0,0 +1,101 @@
+#ifndef LOGQUEUE_H
+#define LOGQUEUE_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <mutex>
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARNING 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+// Messages above this level are compiled out, arguments and all.  Can be set in platformio.ini.
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+// Messages waiting for the sender.  When it falls behind, new messages are dropped and counted.
+#define LOG_QUEUE_DEPTH 16
+
+// Longer messages are cut off
+#define LOG_MESSAGE_BYTES 192
+
+#define LOG_MAX_SINKS 4
+
+// printf style; e.g. LOG_INFO("Turning fan on: %.2fF >= %.2fF", temp, max)
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(format, ...) LogQueue::write(LOG_LEVEL_ERROR, format, ##__VA_ARGS__)
+#else
+#define LOG_ERROR(format, ...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARNING
+#define LOG_WARNING(format, ...) LogQueue::write(LOG_LEVEL_WARNING, format, ##__VA_ARGS__)
+#else
+#define LOG_WARNING(format, ...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(format, ...) LogQueue::write(LOG_LEVEL_INFO, format, ##__VA_ARGS__)
+#else
+#define LOG_INFO(format, ...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(format, ...) LogQueue::write(LOG_LEVEL_DEBUG, format, ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(format, ...) do {} while (0)
+#endif
+
+// Delivers a message to one destination (syslog, Serial, WebSerial...)
+typedef void (*LogSink)(uint8_t level, const char *message);
+
+struct LogEntry {
+	uint8_t level;
+	char message[LOG_MESSAGE_BYTES];
+};
+
+// Logging front end that doesn't touch the heap.  Messages are formatted into a buffer on the
+// caller's stack and copied into a fixed ring; a background task calls flush() to hand them to
+// the sinks, so the control loop never waits on the network to log.
+//
+// Until set_wake() is called there is no background sender, and messages go straight to the
+// sinks from the caller.  That covers setup() and the native builds.
+class LogQueue {
+    private:
+	static LogEntry _entries[LOG_QUEUE_DEPTH];
+	static size_t _head;
+	static size_t _count;
+	static std::mutex _lock;
+
+	static LogSink _sinks[LOG_MAX_SINKS];
+	static uint8_t _sink_count;
+	static void (*_wake)();
+
+	static std::atomic<uint32_t> _written;
+	static std::atomic<uint32_t> _dropped;
+	static std::atomic<uint32_t> _truncated;
+	static size_t _high_water;
+
+	static void _dispatch(uint8_t level, const char *message);
+
+    public:
+	static void write(uint8_t level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+	static void add_sink(LogSink sink);
+
+	// Called after each message is queued, to wake the sender
+	static void set_wake(void (*wake)());
+
+	// Send up to `max` queued messages to the sinks; returns how many were sent
+	static size_t flush(size_t max = LOG_QUEUE_DEPTH);
+
+	static const char *level_name(uint8_t level);
+
+	static uint32_t dropped();
+	static String stats();
+};
+
+#endif
@@ -0,0 +1,173 @@
+#include "MetricBuffer.h"
+#include <LittleFS.h>
+
+MetricBuffer::MetricBuffer() {}
+
+bool MetricBuffer::begin(bool fs_mounted) {
+	_fs_ready = fs_mounted;
+	if (!_fs_ready) {
+		return false;
+	}
+
+	// Pick up anything left from before a restart
+	if (LittleFS.exists(METRIC_SPILL_PATH)) {
+		File file = LittleFS.open(METRIC_SPILL_PATH, "r");
+		_spill_size = file.size();
+		file.close();
+		LOG_INFO("Found %u bytes of unsent metrics on flash", (unsigned) _spill_size);
+	}
+
+	return true;
+}
+
+void MetricBuffer::push(const char *lines, size_t len) {
+	if (len > METRIC_RING_BYTES) {
+		_dropped_bytes += len;
+		return;
+	}
+
+	if (len > METRIC_RING_BYTES - _count && !_spill_ring()) {
+		// Nowhere to spill, so make room by giving up the oldest records
+		while (len > METRIC_RING_BYTES - _count) {
+			_drop_oldest_line();
+		}
+	}
+
+	_ring_append(lines, len);
+}
+
+size_t MetricBuffer::read_lines(char *out, size_t max) {
+	size_t len = 0;
+
+	if (_spill_offset < _spill_size) {
+		File file = LittleFS.open(METRIC_SPILL_PATH, "r");
+		if (file) {
+			file.seek(_spill_offset);
+			len = file.read((uint8_t *) out, max);
+			file.close();
+		}
+		_read_from_spill = true;
+	} else {
+		len = _ring_copy(out, max);
+		_read_from_spill = false;
+	}
+
+	// Only hand back whole lines
+	size_t whole = len;
+	while (whole > 0 && out[whole - 1] != '\n') {
+		whole--;
+	}
+
+	// A line longer than max can never be sent, so skip past it
+	if (whole == 0 && len == max) {
+		LOG_ERROR("Dropping oversized metric record from backlog");
+		_dropped_bytes += len;
+		consume(len);
+	}
+
+	return whole;
+}
+
+void MetricBuffer::consume(size_t len) {
+	if (_read_from_spill) {
+		_spill_offset += len;
+		if (_spill_offset >= _spill_size) {
+			// Fully drained, start the next spill from an empty file
+			LittleFS.remove(METRIC_SPILL_PATH);
+			_spill_offset = 0;
+			_spill_size = 0;
+		}
+		return;
+	}
+
+	if (len > _count) {
+		len = _count;
+	}
+	_head = (_head + len) % METRIC_RING_BYTES;
+	_count -= len;
+}
+
+bool MetricBuffer::empty() const {
+	return _count == 0 && _spill_offset >= _spill_size;
+}
+
+size_t MetricBuffer::pending_bytes() const {
+	return _count + (_spill_size - _spill_offset);
+}
+
+uint32_t MetricBuffer::spilled_bytes() const {
+	return _spilled_bytes;
+}
+
+uint32_t MetricBuffer::dropped_bytes() const {
+	return _dropped_bytes;
+}
+
+bool MetricBuffer::_spill_ring() {
+	if (!_fs_ready || _count == 0 || _spill_size + _count > METRIC_SPILL_MAX_BYTES) {
+		return false;
+	}
+
+	File file = LittleFS.open(METRIC_SPILL_PATH, "a");
+	if (!file) {
+		return false;
+	}
+
+	// The ring may wrap, so write it in up to two pieces
+	size_t first = METRIC_RING_BYTES - _head;
+	if (first > _count) {
+		first = _count;
+	}
+	size_t written = file.write((const uint8_t *) _ring + _head, first);
+	if (written == first && _count > first) {
+		written += file.write((const uint8_t *) _ring, _count - first);
+	}
+	file.close();
+
+	if (written != _count) {
+		// Reads stop at _spill_size so the partial tail is never sent, but appending after it
+		// would split a line.  Stop spilling; the ring contents are kept.
+		LOG_ERROR("Short write spilling metrics to flash, spilling disabled");
+		_fs_ready = false;
+		return false;
+	}
+
+	_spill_size += written;
+	_spilled_bytes += written;
+	_head = 0;
+	_count = 0;
+	return true;
+}
+
+void MetricBuffer::_drop_oldest_line() {
+	size_t len = 0;
+	while (len < _count && _ring[(_head + len) % METRIC_RING_BYTES] != '\n') {
+		len++;
+	}
+	if (len < _count) {
+		// Include the newline
+		len++;
+	}
+
+	_head = (_head + len) % METRIC_RING_BYTES;
+	_count -= len;
+	_dropped_bytes += len;
+}
+
+void MetricBuffer::_ring_append(const char *data, size_t len) {
+	size_t tail = (_head + _count) % METRIC_RING_BYTES;
+	for (size_t i = 0; i < len; i++) {
+		_ring[(tail + i) % METRIC_RING_BYTES] = data[i];
+	}
+	_count += len;
+}
+
+size_t MetricBuffer::_ring_copy(char *out, size_t len) const {
+	if (len > _count) {
+		len = _count;
+	}
+	for (size_t i = 0; i < len; i++) {
+		out[i] = _ring[(_head + i) % METRIC_RING_BYTES];
+	}
+	return len;
+}
@@ -0,0 +1,65 @@
+#ifndef METRICBUFFER_H
+#define METRICBUFFER_H
+
+#include <Arduino.h>
+
+#include "LogQueue.h"
+
+// Bytes of line protocol held in RAM while InfluxDB can't be reached, ~10 minutes of metrics
+#ifndef METRIC_RING_BYTES
+#define METRIC_RING_BYTES (8 * 1024)
+#endif
+
+// Once the RAM ring fills it is spilled to this file, up to this many bytes
+#define METRIC_SPILL_PATH "/influx-backlog.lp"
+#ifndef METRIC_SPILL_MAX_BYTES
+#define METRIC_SPILL_MAX_BYTES (256 * 1024)
+#endif
+
+// A bounded FIFO of newline terminated line protocol records.  New records go into a fixed RAM
+// ring; when the ring is full its contents are appended to a file on LittleFS.  Records are read
+// back oldest first (the file, then the ring) in whole lines.
+class MetricBuffer {
+    private:
+	char _ring[METRIC_RING_BYTES];
+	size_t _head = 0;
+	size_t _count = 0;
+
+	bool _fs_ready = false;
+	size_t _spill_size = 0;
+	size_t _spill_offset = 0;
+
+	// Where the last read_lines() came from, so consume() knows what to advance
+	bool _read_from_spill = false;
+
+	uint32_t _spilled_bytes = 0;
+	uint32_t _dropped_bytes = 0;
+
+	bool _spill_ring();
+	void _drop_oldest_line();
+	void _ring_append(const char *data, size_t len);
+	size_t _ring_copy(char *out, size_t len) const;
+
+    public:
+	MetricBuffer();
+
+	// Spill to LittleFS if it has been mounted, picking up what was left before a restart.
+	// Without it the buffer is RAM only.
+	bool begin(bool fs_mounted);
+
+	// Add one or more complete lines
+	void push(const char *lines, size_t len);
+
+	// Copy the oldest whole lines, up to max bytes, into out.  Returns the number of bytes copied.
+	size_t read_lines(char *out, size_t max);
+
+	// Drop len bytes returned by the last read_lines(), once they have been sent
+	void consume(size_t len);
+
+	bool empty() const;
+	size_t pending_bytes() const;
+	uint32_t spilled_bytes() const;
+	uint32_t dropped_bytes() const;
+};
+
+#endif
@@ -0,0 +1,429 @@
+#include "MetricStore.h"
+#include <time.h>
+
+MetricStore::MetricStore() {}
+
+String MetricStore::_segment_path(uint32_t id) {
+	return String(HISTORY_DIR "/" HISTORY_SEGMENT_PREFIX) + String(id);
+}
+
+bool MetricStore::begin(bool fs_mounted) {
+	_fs_ready = fs_mounted;
+	if (!_fs_ready) {
+		return false;
+	}
+	LittleFS.mkdir(HISTORY_DIR);
+
+	std::lock_guard<std::mutex> guard(_lock);
+	_load_series();
+	uint32_t next_sequence = _load_segments();
+	_load_active(next_sequence);
+	_last_checkpoint_ms = uptime_ms();
+
+	LOG_INFO("Metric history: %u series, %u segments, active block %u rows", (unsigned) _series_count.load(),
+		(unsigned) _segment_count, (unsigned) _active.header().rows);
+	return true;
+}
+
+void MetricStore::_load_series() {
+	File file = LittleFS.open(HISTORY_SERIES_PATH, "r");
+	if (!file) {
+		return;
+	}
+
+	uint8_t count = 0;
+	size_t len = 0;
+	int c;
+	while ((c = file.read()) >= 0 && count < GORILLA_MAX_SERIES) {
+		if (c == '\n') {
+			_series[count++][len] = '\0';
+			len = 0;
+		} else if (len < HISTORY_SERIES_NAME_LEN - 1) {
+			_series[count][len++] = c;
+		}
+	}
+	file.close();
+
+	_series_count.store(count, std::memory_order_release);
+}
+
+// Returns the id of the newest segment file in the history directory older than `newer_than`,
+// or -1 if there are none
+static int64_t find_segment_before(uint32_t newer_than) {
+	int64_t found = -1;
+
+	File dir = LittleFS.open(HISTORY_DIR, "r");
+	if (!dir || !dir.isDirectory()) {
+		return found;
+	}
+
+	File file;
+	while ((file = dir.openNextFile())) {
+		const char *name = file.name();
+		if (strncmp(name, HISTORY_SEGMENT_PREFIX, strlen(HISTORY_SEGMENT_PREFIX)) == 0) {
+			uint32_t id = strtoul(name + strlen(HISTORY_SEGMENT_PREFIX), nullptr, 10);
+			if (id < newer_than && id > found) {
+				found = id;
+			}
+		}
+		file.close();
+	}
+	dir.close();
+	return found;
+}
+
+uint32_t MetricStore::_load_segments() {
+	// Collect the newest HISTORY_MAX_SEGMENTS ids, newest first, by walking back from the top
+	uint32_t ids[HISTORY_MAX_SEGMENTS];
+	uint8_t count = 0;
+	int64_t id;
+	while (count < HISTORY_MAX_SEGMENTS && (id = find_segment_before(count == 0 ? UINT32_MAX : ids[count - 1])) >= 0) {
+		ids[count++] = id;
+	}
+
+	// Anything older is left over from a larger HISTORY_MAX_SEGMENTS
+	while (count == HISTORY_MAX_SEGMENTS && (id = find_segment_before(ids[count - 1])) >= 0) {
+		LittleFS.remove(_segment_path(id));
+	}
+
+	// Oldest first from here on
+	for (uint8_t i = 0; i < count / 2; i++) {
+		uint32_t swap = ids[i];
+		ids[i] = ids[count - 1 - i];
+		ids[count - 1 - i] = swap;
+	}
+
+	uint32_t next_sequence = 0;
+	_segment_count = 0;
+	for (uint8_t i = 0; i < count; i++) {
+		File file = LittleFS.open(_segment_path(ids[i]), "r");
+		if (!file) {
+			continue;
+		}
+
+		HistorySegment &segment = _segments[_segment_count];
+		segment.id = ids[i];
+		segment.blocks = 0;
+
+		GorillaBlockHeader header;
+		while (segment.blocks < HISTORY_BLOCKS_PER_SEGMENT && _read_block_header(file, segment.blocks, header)) {
+			if (segment.blocks == 0 || header.first_ts < segment.first_ts) {
+				segment.first_ts = header.first_ts;
+			}
+			if (segment.blocks == 0 || header.last_ts > segment.last_ts) {
+				segment.last_ts = header.last_ts;
+			}
+			next_sequence = header.sequence + 1;
+			segment.blocks++;
+		}
+		file.close();
+
+		if (segment.blocks > 0) {
+			_segment_count++;
+		}
+	}
+
+	return next_sequence;
+}
+
+void MetricStore::_load_active(uint32_t next_sequence) {
+	File file = LittleFS.open(HISTORY_ACTIVE_PATH, "r");
+	if (file) {
+		memset(_scratch, 0, sizeof(_scratch));
+		file.read(_scratch, sizeof(_scratch));
+		file.close();
+
+		// A block sealed just before a restart is also still in the checkpoint; start afresh
+		if (_active.load(_scratch) && _active.header().sequence >= next_sequence) {
+			return;
+		}
+	}
+
+	_active.reset(next_sequence);
+}
+
+bool MetricStore::_read_block_header(File &file, size_t index, GorillaBlockHeader &header) {
+	if (!file.seek(index * GORILLA_BLOCK_BYTES) || file.read((uint8_t *) &header, sizeof(header)) != sizeof(header)) {
+		return false;
+	}
+	return header.magic == GORILLA_MAGIC;
+}
+
+bool MetricStore::record(const char *sensor_id, const char *measurement, float value) {
+	HistorySample sample;
+	sample.timestamp = time(nullptr);
+	if (sample.timestamp < HISTORY_MIN_TIMESTAMP) {
+		return false;
+	}
+
+	snprintf(sample.series, sizeof(sample.series), "%s/%s", sensor_id, measurement);
+	sample.value = value;
+
+	if (!_queue.push(sample)) {
+		_queue_dropped++;
+		return false;
+	}
+	return true;
+}
+
+void MetricStore::flush() {
+	std::lock_guard<std::mutex> guard(_lock);
+
+	HistorySample sample;
+	while (_queue.pop(sample)) {
+		_add_sample(sample);
+	}
+	_commit_row();
+
+	if (_dirty && uptime_ms() - _last_checkpoint_ms >= HISTORY_CHECKPOINT_MS) {
+		_checkpoint();
+	}
+}
+
+int MetricStore::_series_id(const char *name) {
+	int id = find_series(name);
+	if (id >= 0) {
+		return id;
+	}
+
+	uint8_t count = _series_count.load(std::memory_order_relaxed);
+	if (count >= GORILLA_MAX_SERIES) {
+		return -1;
+	}
+
+	strlcpy(_series[count], name, HISTORY_SERIES_NAME_LEN);
+	if (_fs_ready) {
+		File file = LittleFS.open(HISTORY_SERIES_PATH, "a");
+		if (file) {
+			file.write((const uint8_t *) _series[count], strlen(_series[count]));
+			file.write('\n');
+			file.close();
+		}
+	}
+
+	// Publish the name before the count so readers never see an unfilled entry
+	_series_count.store(count + 1, std::memory_order_release);
+	return count;
+}
+
+void MetricStore::_add_sample(const HistorySample &sample) {
+	int series = _series_id(sample.series);
+	if (series < 0) {
+		_dropped++;
+		return;
+	}
+
+	uint32_t bit = 1UL << series;
+	if (_row_mask && (sample.timestamp != _row_ts || (_row_mask & bit))) {
+		_commit_row();
+	}
+
+	_row_ts = sample.timestamp;
+	_row_mask |= bit;
+	_row_values[series] = sample.value;
+	_samples++;
+}
+
+void MetricStore::_commit_row() {
+	if (_row_mask == 0) {
+		return;
+	}
+
+	if (!_active.append(_row_ts, _row_mask, _row_values)) {
+		_seal_block();
+		_active.append(_row_ts, _row_mask, _row_values);
+	}
+
+	_row_mask = 0;
+	_dirty = true;
+}
+
+void MetricStore::_seal_block() {
+	if (_fs_ready && !_write_block()) {
+		_write_failures++;
+		LOG_ERROR("Failed to write metric history block %u", (unsigned) _active.header().sequence);
+	}
+
+	// Without a filesystem the oldest history is simply dropped
+	_active.reset(_active.header().sequence + 1);
+}
+
+bool MetricStore::_write_block() {
+	const GorillaBlockHeader &header = _active.header();
+	uint32_t id = header.sequence / HISTORY_BLOCKS_PER_SEGMENT;
+	bool new_segment = _segment_count == 0 || _segments[_segment_count - 1].id != id;
+
+	// Write before rotating, so a failed write costs neither the oldest segment nor leaves an
+	// empty one listed.  The partition briefly holds one block past HISTORY_MAX_SEGMENTS.
+	File file = LittleFS.open(_segment_path(id), "a");
+	if (!file) {
+		return false;
+	}
+	size_t written = file.write(_active.raw(), GORILLA_BLOCK_BYTES);
+	file.close();
+
+	if (written != GORILLA_BLOCK_BYTES) {
+		if (new_segment) {
+			LittleFS.remove(_segment_path(id));
+		}
+		return false;
+	}
+
+	if (new_segment) {
+		if (_segment_count == HISTORY_MAX_SEGMENTS) {
+			LittleFS.remove(_segment_path(_segments[0].id));
+			memmove(_segments, _segments + 1, (_segment_count - 1) * sizeof(_segments[0]));
+			_segment_count--;
+		}
+
+		HistorySegment &segment = _segments[_segment_count++];
+		segment.id = id;
+		segment.first_ts = header.first_ts;
+		segment.last_ts = header.last_ts;
+		segment.blocks = 0;
+	}
+
+	HistorySegment &segment = _segments[_segment_count - 1];
+	if (header.first_ts < segment.first_ts) {
+		segment.first_ts = header.first_ts;
+	}
+	if (header.last_ts > segment.last_ts) {
+		segment.last_ts = header.last_ts;
+	}
+	segment.blocks++;
+	_blocks_written++;
+	return true;
+}
+
+void MetricStore::_checkpoint() {
+	_last_checkpoint_ms = uptime_ms();
+	_dirty = false;
+
+	if (!_fs_ready) {
+		return;
+	}
+
+	// Only the used part of the block; load() pads the rest.  Written aside and renamed into
+	// place so a restart part way through leaves the previous checkpoint intact.
+	size_t len = sizeof(GorillaBlockHeader) + (_active.header().bits + 7) / 8;
+	File file = LittleFS.open(HISTORY_ACTIVE_TMP_PATH, "w");
+	if (!file) {
+		_write_failures++;
+		return;
+	}
+	size_t written = file.write(_active.raw(), len);
+	file.close();
+
+	if (written != len || !LittleFS.rename(HISTORY_ACTIVE_TMP_PATH, HISTORY_ACTIVE_PATH)) {
+		_write_failures++;
+		LOG_ERROR("Failed to checkpoint metric history");
+	}
+}
+
+size_t MetricStore::_visit_block(const uint8_t *raw, uint32_t from, uint32_t to, uint32_t series_mask, const HistoryVisitor &visit, bool &stopped) {
+	GorillaReader reader(raw);
+	uint32_t ts;
+	uint32_t mask;
+	float values[GORILLA_MAX_SERIES];
+	size_t visited = 0;
+
+	while (reader.next(ts, mask, values)) {
+		if (ts < from || ts > to) {
+			continue;
+		}
+
+		uint32_t wanted = mask & series_mask;
+		for (uint8_t series = 0; wanted; series++, wanted >>= 1) {
+			if (!(wanted & 1)) {
+				continue;
+			}
+			visited++;
+			if (!visit(ts, series, values[series])) {
+				stopped = true;
+				return visited;
+			}
+		}
+	}
+
+	return visited;
+}
+
+size_t MetricStore::query(uint32_t from, uint32_t to, uint32_t series_mask, HistoryVisitor visit) {
+	std::lock_guard<std::mutex> guard(_lock);
+	size_t visited = 0;
+	bool stopped = false;
+
+	for (uint8_t i = 0; i < _segment_count && !stopped; i++) {
+		const HistorySegment &segment = _segments[i];
+		if (segment.last_ts < from || segment.first_ts > to) {
+			continue;
+		}
+
+		File file = LittleFS.open(_segment_path(segment.id), "r");
+		if (!file) {
+			continue;
+		}
+
+		// Check each block's header before reading the rest of it
+		GorillaBlockHeader header;
+		for (uint8_t block = 0; block < segment.blocks && !stopped; block++) {
+			if (!_read_block_header(file, block, header) || header.last_ts < from || header.first_ts > to) {
+				continue;
+			}
+
+			if (!file.seek(block * GORILLA_BLOCK_BYTES) || file.read(_scratch, GORILLA_BLOCK_BYTES) != GORILLA_BLOCK_BYTES) {
+				break;
+			}
+			visited += _visit_block(_scratch, from, to, series_mask, visit, stopped);
+		}
+		file.close();
+	}
+
+	if (!stopped && !_active.empty() && _active.header().last_ts >= from && _active.header().first_ts <= to) {
+		visited += _visit_block(_active.raw(), from, to, series_mask, visit, stopped);
+	}
+
+	return visited;
+}
+
+uint8_t MetricStore::series_count() const {
+	return _series_count.load(std::memory_order_acquire);
+}
+
+const char *MetricStore::series_name(uint8_t series) const {
+	return series < series_count() ? _series[series] : "";
+}
+
+int MetricStore::find_series(const char *name) const {
+	uint8_t count = series_count();
+	for (uint8_t i = 0; i < count; i++) {
+		if (strcmp(_series[i], name) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+uint32_t MetricStore::oldest() const {
+	std::lock_guard<std::mutex> guard(_lock);
+
+	if (_segment_count > 0) {
+		return _segments[0].first_ts;
+	}
+	return _active.empty() ? 0 : _active.header().first_ts;
+}
+
+String MetricStore::stats() const {
+	std::lock_guard<std::mutex> guard(_lock);
+
+	uint32_t blocks = 0;
+	for (uint8_t i = 0; i < _segment_count; i++) {
+		blocks += _segments[i].blocks;
+	}
+
+	return "series=" + String(series_count()) + ", segments=" + String(_segment_count) +
+		", blocks=" + String(blocks) + ", active=" + String(_active.header().rows) + " rows/" +
+		String(_active.fill_percent()) + "%, samples=" + String(_samples) +
+		", dropped=" + String(_dropped) + ", queue_dropped=" + String(_queue_dropped.load()) + ", written=" + String(_blocks_written) +
+		", write_failures=" + String(_write_failures);
+}
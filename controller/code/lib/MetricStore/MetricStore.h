@@ -0,0 +1,141 @@
+#ifndef METRICSTORE_H
+#define METRICSTORE_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <LittleFS.h>
+
+#include "LogQueue.h"
+#include "Clock.h"
+#include "GorillaBlock.h"
+#include "SpscQueue.h"
+
+#define HISTORY_DIR "/history"
+#define HISTORY_SERIES_PATH "/history/series"
+#define HISTORY_ACTIVE_PATH "/history/active"
+#define HISTORY_ACTIVE_TMP_PATH "/history/active.tmp"
+#define HISTORY_SEGMENT_PREFIX "seg-"
+
+// Sealed blocks are appended to segment files of this many blocks.  When there are more than
+// HISTORY_MAX_SEGMENTS the oldest file is deleted, so flash wear is spread over the whole
+// partition instead of rewriting the same sectors.
+#define HISTORY_BLOCKS_PER_SEGMENT 16
+
+// 768KB, four weeks or so of per-minute readings.  Shares the partition with the InfluxDB
+// backlog spill file.
+#ifndef HISTORY_MAX_SEGMENTS
+#define HISTORY_MAX_SEGMENTS 12
+#endif
+
+// The block being filled lives in RAM and is saved this often, so a restart loses at most
+// this much history
+#define HISTORY_CHECKPOINT_MS (15 * 60 * 1000)
+
+// Samples recorded by the control task waiting to be compressed by the network task
+#define HISTORY_QUEUE_DEPTH 32
+
+#define HISTORY_SERIES_NAME_LEN 48
+
+// Anything earlier means NTP hasn't synced yet, and the sample can't be placed in time
+#define HISTORY_MIN_TIMESTAMP 1600000000
+
+struct HistorySample {
+	uint32_t timestamp;
+	char series[HISTORY_SERIES_NAME_LEN];
+	float value;
+};
+
+struct HistorySegment {
+	uint32_t id;
+	uint32_t first_ts;
+	uint32_t last_ts;
+	uint8_t blocks;
+};
+
+// Called for each stored sample a query finds; return false to stop the query
+typedef std::function<bool(uint32_t timestamp, uint8_t series, float value)> HistoryVisitor;
+
+// An append-only store of sensor history on LittleFS.  Samples are grouped into rows by
+// timestamp and compressed into GorillaBlocks; full blocks are appended to segment files.
+// Series are named "<sensor_id>/<measurement>" and numbered in the order first seen.
+//
+// record() is called from the control task.  flush() is called from the network task and
+// does all the compression and flash writes.  query() may be called from any task.
+class MetricStore {
+    private:
+	GorillaBlock _active;
+	uint8_t _scratch[GORILLA_BLOCK_BYTES];
+
+	SpscQueue<HistorySample, HISTORY_QUEUE_DEPTH> _queue;
+
+	char _series[GORILLA_MAX_SERIES][HISTORY_SERIES_NAME_LEN];
+	std::atomic<uint8_t> _series_count{0};
+
+	// Oldest first
+	HistorySegment _segments[HISTORY_MAX_SEGMENTS];
+	uint8_t _segment_count = 0;
+
+	// The row being gathered from the samples of one collection
+	uint32_t _row_ts = 0;
+	uint32_t _row_mask = 0;
+	float _row_values[GORILLA_MAX_SERIES];
+
+	bool _fs_ready = false;
+	bool _dirty = false;
+	uint64_t _last_checkpoint_ms = 0;
+
+	// Held by flush() and query() so a query never sees a half written block
+	mutable std::mutex _lock;
+
+	uint32_t _samples = 0;
+	// Samples with no room for their series, and samples the queue had no room for
+	uint32_t _dropped = 0;
+	std::atomic<uint32_t> _queue_dropped{0};
+	uint32_t _blocks_written = 0;
+	uint32_t _write_failures = 0;
+
+	int _series_id(const char *name);
+	void _add_sample(const HistorySample &sample);
+	void _commit_row();
+	void _seal_block();
+	bool _write_block();
+	void _checkpoint();
+	void _load_series();
+	uint32_t _load_segments();
+	void _load_active(uint32_t next_sequence);
+	bool _read_block_header(File &file, size_t index, GorillaBlockHeader &header);
+	size_t _visit_block(const uint8_t *raw, uint32_t from, uint32_t to, uint32_t series_mask, const HistoryVisitor &visit, bool &stopped);
+
+	static String _segment_path(uint32_t id);
+
+    public:
+	MetricStore();
+
+	// Pick up the history already stored, if LittleFS has been mounted.  Without it, only what
+	// fits in the RAM block is kept.
+	bool begin(bool fs_mounted);
+
+	// Record a sample taken now.  Safe to call from the control task.
+	bool record(const char *sensor_id, const char *measurement, float value);
+
+	// Compress the samples recorded since the last flush and save what's due to flash
+	void flush();
+
+	// Visit every sample from `from` to `to` (inclusive, unix seconds) for the series set in
+	// `series_mask`, oldest first.  Returns the number of samples visited.
+	size_t query(uint32_t from, uint32_t to, uint32_t series_mask, HistoryVisitor visit);
+
+	uint8_t series_count() const;
+	const char *series_name(uint8_t series) const;
+	// Returns -1 if there is no series by that name
+	int find_series(const char *name) const;
+
+	// Timestamp of the oldest sample still stored, or 0 when empty
+	uint32_t oldest() const;
+
+	String stats() const;
+};
+
+#endif
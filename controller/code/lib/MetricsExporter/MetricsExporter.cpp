@@ -0,0 +1,202 @@
+#include "MetricsExporter.h"
+
+#include <stdarg.h>
+
+MetricsExporter::MetricsExporter(ClimateControl *climate, SensorObjects *sensors, ControlObjects *controls)
+	: _climate(climate), _sensors(sensors), _controls(controls) {
+}
+
+void MetricsExporter::set_probes(const LatencyProbe *probes, size_t count) {
+	_probes = probes;
+	_probe_count = count;
+}
+
+void MetricsExporter::add_gauge(const char *name, const char *help, std::function<double()> value) {
+	_add(name, help, false, value);
+}
+
+void MetricsExporter::add_counter(const char *name, const char *help, std::function<double()> value) {
+	_add(name, help, true, value);
+}
+
+void MetricsExporter::_add(const char *name, const char *help, bool counter, std::function<double()> value) {
+	if (_extra_count >= METRICS_MAX_EXTRA) {
+		LOG_ERROR("MetricsExporter: no room for %s", name);
+		return;
+	}
+	_extra[_extra_count++] = {name, help, counter, value};
+}
+
+bool MetricsExporter::acquire() {
+	bool expected = false;
+	return _busy.compare_exchange_strong(expected, true);
+}
+
+void MetricsExporter::release() {
+	_busy = false;
+}
+
+const char *MetricsExporter::buffer() const {
+	return _buffer;
+}
+
+// Once a line doesn't fit, the page is cut back to the last point _keep() marked and nothing
+// more is added, so a truncated page never ends part way through a metric family
+void MetricsExporter::_append(const char *format, ...) {
+	if (_overflow) {
+		return;
+	}
+
+	va_list args;
+	va_start(args, format);
+	int written = vsnprintf(_buffer + _length, METRICS_BUFFER_BYTES - _length, format, args);
+	va_end(args);
+
+	if (written < 0 || _length + written >= METRICS_BUFFER_BYTES) {
+		_length = _kept;
+		_buffer[_length] = '\0';
+		_overflow = true;
+		return;
+	}
+	_length += written;
+}
+
+void MetricsExporter::_keep() {
+	if (!_overflow) {
+		_kept = _length;
+	}
+}
+
+void MetricsExporter::_header(const char *name, const char *type, const char *help) {
+	// Each family starts with its header, so everything before it is complete
+	_keep();
+	_append("# HELP " METRICS_PREFIX "%s %s\n# TYPE " METRICS_PREFIX "%s %s\n", name, help, name, type);
+}
+
+void MetricsExporter::_value(const char *name, double value) {
+	// Counts keep every digit; readings come from floats, so 7 significant digits is all there is
+	if (value == (double) (int64_t) value) {
+		_append(METRICS_PREFIX "%s %lld\n", name, (long long) value);
+	} else {
+		_append(METRICS_PREFIX "%s %.7g\n", name, value);
+	}
+}
+
+size_t MetricsExporter::render() {
+	_length = 0;
+	_kept = 0;
+	_overflow = false;
+	_buffer[0] = '\0';
+	_renders++;
+
+	_render_sensors();
+	_render_controls();
+	_render_latency();
+	_render_system();
+
+	for (uint8_t i = 0; i < _extra_count; i++) {
+		const MetricsEntry &entry = _extra[i];
+		_header(entry.name, entry.counter ? "counter" : "gauge", entry.help);
+		_value(entry.name, entry.value());
+	}
+
+	if (_overflow) {
+		// Only say so the first time; stats() keeps the count
+		if (_truncated++ == 0) {
+			LOG_ERROR("MetricsExporter: page truncated at %u bytes, raise METRICS_BUFFER_BYTES", (unsigned) _length);
+		}
+	}
+	return _length;
+}
+
+void MetricsExporter::_render_sensors() {
+	const SensorSnapshot &snapshot = _climate->snapshot();
+
+	// Leave out readings we have never had, rather than reporting zeros
+	if (snapshot.has_sample()) {
+		_header("temperature_fahrenheit", "gauge", "Air temperature from the lead sensor");
+		_value("temperature_fahrenheit", snapshot.temperature);
+		_header("humidity_percent", "gauge", "Relative humidity from the lead sensor");
+		_value("humidity_percent", snapshot.humidity);
+		_header("reading_age_seconds", "gauge", "Time since the lead sensor was read");
+		_value("reading_age_seconds", snapshot.age_ms() / 1000.0);
+	}
+
+	_header("reading_valid", "gauge", "Whether the last read of each sensor succeeded");
+	_append(METRICS_PREFIX "reading_valid{sensor=\"dht22\"} %d\n", snapshot.valid);
+	_append(METRICS_PREFIX "reading_valid{sensor=\"probes\"} %d\n", snapshot.probes_valid);
+	_append(METRICS_PREFIX "reading_valid{sensor=\"light\"} %d\n", snapshot.light_valid);
+
+	if (!_sensors->temp->sensors.empty()) {
+		_header("probe_temperature_celsius", "gauge", "One-wire probe temperatures");
+		for (const Sensor &sensor : _sensors->temp->sensors) {
+			if (!sensor.valid) {
+				continue;
+			}
+			const byte *a = sensor.address;
+			_append(METRICS_PREFIX "probe_temperature_celsius{address=\"%02x%02x%02x%02x%02x%02x%02x%02x\"} %.2f\n",
+					a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], sensor.temp);
+		}
+	}
+
+	if (snapshot.light_taken_ms > 0) {
+		_header("light_lux", "gauge", "Illuminance from the light sensor");
+		_value("light_lux", snapshot.lux);
+		_header("light_raw", "gauge", "Raw light sensor channels");
+		_append(METRICS_PREFIX "light_raw{channel=\"full\"} %u\n", snapshot.full_luminosity);
+		_append(METRICS_PREFIX "light_raw{channel=\"ir\"} %u\n", snapshot.ir);
+		_append(METRICS_PREFIX "light_raw{channel=\"visible\"} %u\n", snapshot.visible);
+	}
+}
+
+void MetricsExporter::_render_controls() {
+	_header("fan_on", "gauge", "Whether the fan is running");
+	_value("fan_on", _controls->fan->is_on());
+	_header("window_open", "gauge", "Whether the window is open, or opening");
+	_value("window_open", _controls->window->is_open());
+	_header("window_moving", "gauge", "Whether the window motor is running");
+	_value("window_moving", _controls->window->is_moving());
+	_header("mist_on", "gauge", "Whether the mister is running");
+	_value("mist_on", _controls->mist->is_on());
+}
+
+void MetricsExporter::_render_latency() {
+	if (_probe_count == 0) {
+		return;
+	}
+
+	_header("latency_seconds", "histogram", "Time spent in each subsystem");
+	for (size_t i = 0; i < _probe_count; i++) {
+		const char *probe = _probes[i].name;
+		const LatencyHistogram &histogram = *_probes[i].histogram;
+
+		for (uint8_t bit = METRICS_LATENCY_FIRST_BIT; bit <= METRICS_LATENCY_LAST_BIT; bit += 2) {
+			_append(METRICS_PREFIX "latency_seconds_bucket{probe=\"%s\",le=\"%.8g\"} %u\n", probe,
+					(1UL << bit) / 1000000.0, histogram.count_below(1UL << bit));
+		}
+		_append(METRICS_PREFIX "latency_seconds_bucket{probe=\"%s\",le=\"+Inf\"} %u\n", probe, histogram.count());
+		_append(METRICS_PREFIX "latency_seconds_sum{probe=\"%s\"} %.6f\n", probe, histogram.sum_us() / 1000000.0);
+		_append(METRICS_PREFIX "latency_seconds_count{probe=\"%s\"} %u\n", probe, histogram.count());
+		// A probe's buckets, sum and count go together; the probes before it can stay
+		_keep();
+	}
+}
+
+void MetricsExporter::_render_system() {
+	_header("uptime_seconds", "counter", "Time since the controller started");
+	_value("uptime_seconds", uptime_ms() / 1000);
+	_header("heap_free_bytes", "gauge", "Free heap");
+	_value("heap_free_bytes", ESP.getFreeHeap());
+	_header("heap_min_free_bytes", "gauge", "Lowest free heap since the controller started");
+	_value("heap_min_free_bytes", ESP.getMinFreeHeap());
+	_header("heap_max_alloc_bytes", "gauge", "Largest block the heap can currently allocate");
+	_value("heap_max_alloc_bytes", ESP.getMaxAllocHeap());
+	_header("sensor_timeouts_total", "counter", "Sensor acquisitions that gave up waiting on a sensor");
+	_value("sensor_timeouts_total", _climate->acquisition().timeouts());
+	_header("scrapes_total", "counter", "Times this page has been rendered");
+	_value("scrapes_total", _renders);
+}
+
+String MetricsExporter::stats() const {
+	return "scrapes=" + String(_renders) + " bytes=" + String(_length) + " truncated=" + String(_truncated);
+}
@@ -0,0 +1,97 @@
+#ifndef METRICSEXPORTER_H
+#define METRICSEXPORTER_H
+
+#include <Arduino.h>
+#include <functional>
+#include <atomic>
+
+#include "LogQueue.h"
+#include "Clock.h"
+#include "monitor.h"
+#include "ClimateControl.h"
+#include "LatencyHistogram.h"
+
+// Room for the whole page.  The controller's page, with every latency probe, is about 8.5KB.
+#ifndef METRICS_BUFFER_BYTES
+#define METRICS_BUFFER_BYTES (12 * 1024)
+#endif
+
+// Values registered with add_gauge() / add_counter()
+#define METRICS_MAX_EXTRA 16
+
+#define METRICS_PREFIX "greenhouse_"
+#define METRICS_CONTENT_TYPE "text/plain; version=0.0.4"
+
+// Latency histogram buckets are reported at every power of four microseconds from
+// 2^METRICS_LATENCY_FIRST_BIT (256us) up to 2^METRICS_LATENCY_LAST_BIT (about 17s)
+#define METRICS_LATENCY_FIRST_BIT 8
+#define METRICS_LATENCY_LAST_BIT 24
+
+struct MetricsEntry {
+	const char *name;
+	const char *help;
+	bool counter;
+	std::function<double()> value;
+};
+
+// Renders the current readings, actuator states, latency histograms, heap and any registered
+// values in the Prometheus text format, so a scraper can pull them at its own rate instead of
+// the controller pushing on a timer.  The page is written with snprintf into a buffer that is
+// part of the exporter, so serving it doesn't allocate.
+//
+// The latency histograms count from boot, as Prometheus expects of a histogram.
+class MetricsExporter {
+    private:
+	ClimateControl *_climate;
+	SensorObjects *_sensors;
+	ControlObjects *_controls;
+
+	const LatencyProbe *_probes = nullptr;
+	size_t _probe_count = 0;
+
+	MetricsEntry _extra[METRICS_MAX_EXTRA];
+	uint8_t _extra_count = 0;
+
+	char _buffer[METRICS_BUFFER_BYTES];
+	size_t _length = 0;
+	// Where the page is cut back to if it overflows
+	size_t _kept = 0;
+	bool _overflow = false;
+	std::atomic<bool> _busy{false};
+
+	uint32_t _renders = 0;
+	uint32_t _truncated = 0;
+
+	void _append(const char *format, ...) __attribute__((format(printf, 2, 3)));
+	void _keep();
+	void _header(const char *name, const char *type, const char *help);
+	void _value(const char *name, double value);
+	void _render_sensors();
+	void _render_controls();
+	void _render_latency();
+	void _render_system();
+	void _add(const char *name, const char *help, bool counter, std::function<double()> value);
+
+    public:
+	MetricsExporter(ClimateControl *climate, SensorObjects *sensors, ControlObjects *controls);
+
+	void set_probes(const LatencyProbe *probes, size_t count);
+
+	// Report another value under METRICS_PREFIX + name; `value` is called on each scrape,
+	// from the web server's task
+	void add_gauge(const char *name, const char *help, std::function<double()> value);
+	void add_counter(const char *name, const char *help, std::function<double()> value);
+
+	// The buffer is shared, so only one page can be rendered and sent at a time.  Call
+	// release() once the response built from buffer() has gone out.
+	bool acquire();
+	void release();
+
+	// Fill buffer() with the current page and return its length
+	size_t render();
+	const char *buffer() const;
+
+	String stats() const;
+};
+
+#endif
@@ -1,9 +1,7 @@
 #include <MistControl.h>
 
-extern Logger *LOGGER;
-
 MistControl::MistControl(uint8_t pin) : _control_pin(pin) {
-    LOGGER->log("Initializing MistControl");
+    LOG_INFO("Initializing MistControl");
     pinMode(_control_pin, OUTPUT);
     turn_off();
 }
@@ -11,13 +9,13 @@ MistControl::MistControl(uint8_t pin) : _control_pin(pin) {
 void MistControl::turn_on() {
     digitalWrite(_control_pin, HIGH);
     _is_on = true;
-    LOGGER->log("Misters turned on");
+    LOG_INFO("Misters turned on");
 }
 
 void MistControl::turn_off() {
     digitalWrite(_control_pin, LOW);
     _is_on = false;
-    LOGGER->log("Misters turned off");
+    LOG_INFO("Misters turned off");
 }
 
 bool MistControl::is_on() const {
@@ -3,7 +3,7 @@
 
 #include <Arduino.h>
 
-#include "Logger.h"
+#include "LogQueue.h"
 
 class MistControl {
     private:
@@ -0,0 +1,109 @@
+#include "PowerManager.h"
+
+#if __has_include(<esp_pm.h>)
+#include <esp_pm.h>
+#include <esp_idf_version.h>
+#include <sdkconfig.h>
+#endif
+
+void PowerManager::begin() {
+	_active_mhz = getCpuFrequencyMhz();
+
+	// Modem sleep: the radio sleeps between beacons but the AP keeps us associated
+	WiFi.setSleep(true);
+
+	_auto_power = _configure_auto_power();
+	if (_auto_power) {
+		LOG_INFO("Power management: automatic frequency scaling%s, %d-%dMHz", _light_sleep ? " and light sleep" : "",
+			IDLE_CPU_MHZ, (int) _active_mhz);
+	} else {
+		LOG_INFO("Power management: clocking down to %dMHz when idle", IDLE_CPU_MHZ);
+	}
+
+	reset_stats();
+}
+
+bool PowerManager::_configure_auto_power() {
+#if defined(CONFIG_PM_ENABLE)
+	// The power management driver scales the clock and sleeps on its own whenever every task is
+	// blocked, which also covers the network task's idle time
+#if ESP_IDF_VERSION_MAJOR >= 5
+	esp_pm_config_t config;
+#elif CONFIG_IDF_TARGET_ESP32C3
+	esp_pm_config_esp32c3_t config;
+#else
+	esp_pm_config_esp32_t config;
+#endif
+	config.max_freq_mhz = _active_mhz;
+	config.min_freq_mhz = IDLE_CPU_MHZ;
+	// Light sleep needs tickless idle, which the stock Arduino framework isn't built with
+#if defined(CONFIG_FREERTOS_USE_TICKLESS_IDLE)
+	config.light_sleep_enable = ENABLE_LIGHT_SLEEP;
+#else
+	config.light_sleep_enable = false;
+#endif
+	_light_sleep = config.light_sleep_enable;
+	return esp_pm_configure(&config) == ESP_OK;
+#else
+	return false;
+#endif
+}
+
+void PowerManager::idle(uint32_t ms) {
+	if (ms == 0) {
+		return;
+	}
+
+	uint64_t start_us = uptime_us();
+
+	// Without the driver, drop the clock by hand for the length of the wait.  The clock is shared
+	// by both cores, so a network request running meanwhile on the other core is slowed to
+	// IDLE_CPU_MHZ too, for most of each second.  Building with CONFIG_PM_ENABLE avoids that, as
+	// the driver only scales down once every task is blocked.
+	bool downclock = !_auto_power && ms >= IDLE_DOWNCLOCK_MIN_MS && _active_mhz > IDLE_CPU_MHZ;
+	if (downclock) {
+		setCpuFrequencyMhz(IDLE_CPU_MHZ);
+		_downclocks++;
+	}
+
+	// Blocks only this task; the idle task halts the CPU until the next interrupt
+	delay(ms);
+
+	if (downclock) {
+		setCpuFrequencyMhz(_active_mhz);
+	}
+
+	_idle_us += uptime_us() - start_us;
+	_idles++;
+}
+
+float PowerManager::duty_cycle() const {
+	uint64_t elapsed_us = uptime_us() - _period_start_us;
+	if (elapsed_us == 0) {
+		return 0;
+	}
+	return 1.0 - (float) std::min(_idle_us, elapsed_us) / elapsed_us;
+}
+
+uint32_t PowerManager::active_mhz() const {
+	return _active_mhz;
+}
+
+bool PowerManager::auto_power() const {
+	return _auto_power;
+}
+
+void PowerManager::reset_stats() {
+	_period_start_us = uptime_us();
+	_idle_us = 0;
+	_idles = 0;
+	_downclocks = 0;
+}
+
+String PowerManager::stats() const {
+	return "loop duty=" + String(duty_cycle() * 100, 2) + "%" +
+		" idles=" + String(_idles) +
+		" downclocks=" + String(_downclocks) +
+		" cpu=" + String(getCpuFrequencyMhz()) + "MHz" +
+		" mode=" + String(_auto_power ? "auto" : "manual");
+}
@@ -0,0 +1,58 @@
+#ifndef POWERMANAGER_H
+#define POWERMANAGER_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+#include "LogQueue.h"
+#include "Clock.h"
+
+// Clock the CPU down to this while the loop has nothing to do.  80MHz is the lowest frequency
+// that keeps the WiFi running.
+#ifndef IDLE_CPU_MHZ
+#define IDLE_CPU_MHZ 80
+#endif
+
+// Switching frequency isn't free, so don't bother for shorter idle periods
+#define IDLE_DOWNCLOCK_MIN_MS 20
+
+// Let the chip light sleep between FreeRTOS ticks when the framework was built with power
+// management and tickless idle; WiFi stays associated through modem sleep either way
+#ifndef ENABLE_LIGHT_SLEEP
+#define ENABLE_LIGHT_SLEEP true
+#endif
+
+// Puts the controller into its lowest power state that still keeps the WiFi and admin interface
+// responsive while the loop waits for the next scheduled job, and measures how much of the time
+// the loop is busy.  Only the loop task is measured: the network, log and web server tasks do
+// their work while the loop idles, and that time counts as idle.
+class PowerManager {
+    private:
+	uint32_t _active_mhz = 0;
+	bool _auto_power = false;
+	// What the power management driver was actually configured with
+	bool _light_sleep = false;
+
+	uint64_t _period_start_us = 0;
+	uint64_t _idle_us = 0;
+	uint32_t _idles = 0;
+	uint32_t _downclocks = 0;
+
+	bool _configure_auto_power();
+
+    public:
+	void begin();
+
+	// Wait `ms` in low power, returning early on nothing; call with the time to the next deadline
+	void idle(uint32_t ms);
+
+	// Share of the time since reset_stats() the loop task spent running rather than idling, 0-1
+	float duty_cycle() const;
+	uint32_t active_mhz() const;
+	bool auto_power() const;
+
+	void reset_stats();
+	String stats() const;
+};
+
+#endif
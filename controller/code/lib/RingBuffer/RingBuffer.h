@@ -0,0 +1,58 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <stddef.h>
+
+// A fixed capacity history that overwrites its oldest entry once full.  Storage is part of the
+// object, so it never touches the heap.
+template <typename T, size_t N>
+class RingBuffer {
+	static_assert(N > 0, "RingBuffer capacity must be positive");
+
+    private:
+	T _items[N];
+	size_t _next = 0;
+	size_t _count = 0;
+
+    public:
+	void push(const T &item) {
+		_items[_next] = item;
+		_next = (_next + 1) % N;
+		if (_count < N) {
+			_count++;
+		}
+	}
+
+	void clear() {
+		_next = 0;
+		_count = 0;
+	}
+
+	size_t size() const {
+		return _count;
+	}
+
+	static constexpr size_t capacity() {
+		return N;
+	}
+
+	bool empty() const {
+		return _count == 0;
+	}
+
+	bool full() const {
+		return _count == N;
+	}
+
+	// Entry 'age' pushes ago, where 0 is the newest.  age must be less than size().
+	const T &back(size_t age = 0) const {
+		return _items[(_next + N - 1 - age) % N];
+	}
+
+	// Entry i counting from the oldest.  i must be less than size().
+	const T &operator[](size_t i) const {
+		return _items[(_next + N - _count + i) % N];
+	}
+};
+
+#endif
@@ -0,0 +1,241 @@
+#include "Scheduler.h"
+
+uint32_t SchedulerJob::mean_late_ms() const {
+	return runs ? total_late_ms / runs : 0;
+}
+
+uint32_t SchedulerJob::mean_run_us() const {
+	return runs ? total_run_us / runs : 0;
+}
+
+void SchedulerJob::reset_stats() {
+	runs = 0;
+	skipped = 0;
+	overruns = 0;
+	last_late_ms = 0;
+	max_late_ms = 0;
+	total_late_ms = 0;
+	last_run_us = 0;
+	max_run_us = 0;
+	total_run_us = 0;
+}
+
+bool Scheduler::_earlier(uint8_t a, uint8_t b) const {
+	return _jobs[_heap[a]].due_ms < _jobs[_heap[b]].due_ms;
+}
+
+void Scheduler::_swap(uint8_t a, uint8_t b) {
+	uint8_t id = _heap[a];
+	_heap[a] = _heap[b];
+	_heap[b] = id;
+}
+
+void Scheduler::_sift_up(uint8_t pos) {
+	while (pos > 0) {
+		uint8_t parent = (pos - 1) / 2;
+		if (!_earlier(pos, parent)) {
+			break;
+		}
+		_swap(pos, parent);
+		pos = parent;
+	}
+}
+
+void Scheduler::_sift_down(uint8_t pos) {
+	while (true) {
+		uint8_t smallest = pos;
+		uint8_t left = 2 * pos + 1;
+		uint8_t right = left + 1;
+
+		if (left < _heap_size && _earlier(left, smallest)) {
+			smallest = left;
+		}
+		if (right < _heap_size && _earlier(right, smallest)) {
+			smallest = right;
+		}
+		if (smallest == pos) {
+			break;
+		}
+		_swap(pos, smallest);
+		pos = smallest;
+	}
+}
+
+void Scheduler::_push(uint8_t id) {
+	_heap[_heap_size] = id;
+	_sift_up(_heap_size++);
+}
+
+void Scheduler::_remove(uint8_t id) {
+	for (uint8_t pos = 0; pos < _heap_size; pos++) {
+		if (_heap[pos] != id) {
+			continue;
+		}
+
+		_heap[pos] = _heap[--_heap_size];
+		if (pos < _heap_size) {
+			_sift_down(pos);
+			_sift_up(pos);
+		}
+		return;
+	}
+}
+
+int Scheduler::_add(const char *name, uint32_t period_ms, uint32_t delay_ms, std::function<void()> run) {
+	for (int id = 0; id < SCHEDULER_MAX_JOBS; id++) {
+		if (_jobs[id].name) {
+			continue;
+		}
+
+		SchedulerJob &job = _jobs[id];
+		job.name = name;
+		job.run = run;
+		job.period_ms = period_ms;
+		job.due_ms = uptime_ms() + delay_ms;
+		job.active = true;
+		_push(id);
+		return id;
+	}
+
+	LOG_ERROR("Scheduler is full, can't add job %s", name);
+	return -1;
+}
+
+int Scheduler::every(const char *name, uint32_t period_ms, std::function<void()> run, uint32_t delay_ms) {
+	return _add(name, period_ms, delay_ms, run);
+}
+
+int Scheduler::after(const char *name, uint32_t delay_ms, std::function<void()> run) {
+	return _add(name, 0, delay_ms, run);
+}
+
+void Scheduler::reschedule(int id, uint32_t delay_ms) {
+	if (id < 0 || id >= SCHEDULER_MAX_JOBS || !_jobs[id].name) {
+		return;
+	}
+
+	if (_jobs[id].active) {
+		_remove(id);
+	}
+	_jobs[id].due_ms = uptime_ms() + delay_ms;
+	_jobs[id].active = true;
+	_push(id);
+}
+
+void Scheduler::cancel(int id) {
+	if (id < 0 || id >= SCHEDULER_MAX_JOBS || !_jobs[id].active) {
+		return;
+	}
+
+	_remove(id);
+	_jobs[id].active = false;
+}
+
+void Scheduler::_run(uint8_t id, uint64_t now_ms) {
+	SchedulerJob &job = _jobs[id];
+
+	uint32_t late_ms = now_ms - job.due_ms;
+	job.last_late_ms = late_ms;
+	job.max_late_ms = std::max(job.max_late_ms, late_ms);
+	job.total_late_ms += late_ms;
+
+	// A one-shot job is off the heap now, so it may arm itself again while it runs
+	if (job.period_ms == 0) {
+		job.active = false;
+	}
+
+	uint64_t start_us = uptime_us();
+	job.run();
+	uint32_t run_us = uptime_us() - start_us;
+
+	job.runs++;
+	job.last_run_us = run_us;
+	job.max_run_us = std::max(job.max_run_us, run_us);
+	job.total_run_us += run_us;
+
+	if (job.period_ms == 0) {
+		return;
+	}
+
+	if (run_us > job.period_ms * 1000ULL) {
+		job.overruns++;
+	}
+
+	// Keep the cadence, but don't queue up a burst of runs after a stall
+	job.due_ms += job.period_ms;
+	uint64_t finished_ms = uptime_ms();
+	if (finished_ms > job.due_ms + job.period_ms * SCHEDULER_MAX_CATCH_UP) {
+		uint32_t missed = (finished_ms - job.due_ms) / job.period_ms;
+		job.skipped += missed;
+		job.due_ms += (uint64_t) missed * job.period_ms;
+	}
+	_push(id);
+}
+
+uint32_t Scheduler::run_due() {
+	uint64_t now_ms = uptime_ms();
+
+	// Only run what was due on entry so a job that is always late can't starve the loop
+	uint8_t count = _heap_size;
+	while (count-- > 0 && _heap_size > 0 && _jobs[_heap[0]].due_ms <= now_ms) {
+		uint8_t id = _heap[0];
+		_heap[0] = _heap[--_heap_size];
+		_sift_down(0);
+
+		_run(id, uptime_ms());
+	}
+
+	return ms_until_next();
+}
+
+uint32_t Scheduler::ms_until_next() const {
+	if (_heap_size == 0) {
+		return UINT32_MAX;
+	}
+
+	uint64_t now_ms = uptime_ms();
+	uint64_t due_ms = _jobs[_heap[0]].due_ms;
+	return due_ms > now_ms ? due_ms - now_ms : 0;
+}
+
+size_t Scheduler::size() const {
+	size_t count = 0;
+	for (const auto &job : _jobs) {
+		count += job.name != nullptr;
+	}
+	return count;
+}
+
+const SchedulerJob &Scheduler::job(int id) const {
+	return _jobs[id];
+}
+
+void Scheduler::reset_stats() {
+	for (auto &job : _jobs) {
+		job.reset_stats();
+	}
+}
+
+String Scheduler::stats() const {
+	String stats = "";
+	for (const auto &job : _jobs) {
+		if (!job.name || job.runs == 0) {
+			continue;
+		}
+
+		if (stats.length() > 0) {
+			stats += ", ";
+		}
+		stats += String(job.name) + "(runs=" + String(job.runs) +
+			" late=" + String(job.mean_late_ms()) + "/" + String(job.max_late_ms) + "ms" +
+			" run=" + String(job.mean_run_us()) + "/" + String(job.max_run_us) + "us";
+		if (job.overruns) {
+			stats += " overruns=" + String(job.overruns);
+		}
+		if (job.skipped) {
+			stats += " skipped=" + String(job.skipped);
+		}
+		stats += ")";
+	}
+	return stats;
+}
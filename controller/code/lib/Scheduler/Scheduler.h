@@ -0,0 +1,84 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+#include <functional>
+
+#include "LogQueue.h"
+#include "Clock.h"
+
+#define SCHEDULER_MAX_JOBS 16
+
+// A job that is late by more than this many periods skips the runs it missed rather than
+// running them back to back
+#define SCHEDULER_MAX_CATCH_UP 1
+
+struct SchedulerJob {
+	const char *name = nullptr;
+	std::function<void()> run;
+	// 0 for a one-shot job
+	uint32_t period_ms = 0;
+	uint64_t due_ms = 0;
+	bool active = false;
+
+	// How late each run started, and how long it took
+	uint32_t runs = 0;
+	uint32_t skipped = 0;
+	uint32_t overruns = 0;
+	uint32_t last_late_ms = 0;
+	uint32_t max_late_ms = 0;
+	uint64_t total_late_ms = 0;
+	uint32_t last_run_us = 0;
+	uint32_t max_run_us = 0;
+	uint64_t total_run_us = 0;
+
+	uint32_t mean_late_ms() const;
+	uint32_t mean_run_us() const;
+	void reset_stats();
+};
+
+// Runs periodic and one-shot jobs from the loop in deadline order.  Pending jobs are kept in a
+// binary min-heap on their due time, so finding the next one is O(1) and rescheduling O(log n).
+// Periodic jobs keep their cadence: the next run is due one period after the last was due, not
+// after it finished.  A run that takes longer than its period is counted as an overrun.
+class Scheduler {
+    private:
+	SchedulerJob _jobs[SCHEDULER_MAX_JOBS];
+	uint8_t _heap[SCHEDULER_MAX_JOBS];
+	uint8_t _heap_size = 0;
+
+	bool _earlier(uint8_t a, uint8_t b) const;
+	void _swap(uint8_t a, uint8_t b);
+	void _sift_up(uint8_t pos);
+	void _sift_down(uint8_t pos);
+	void _push(uint8_t id);
+	void _remove(uint8_t id);
+	int _add(const char *name, uint32_t period_ms, uint32_t delay_ms, std::function<void()> run);
+	void _run(uint8_t id, uint64_t now_ms);
+
+    public:
+	// Run `run` every `period_ms`, the first time after `delay_ms`.  Returns the job id, or -1
+	// when there is no room.
+	int every(const char *name, uint32_t period_ms, std::function<void()> run, uint32_t delay_ms = 0);
+
+	// Run `run` once after `delay_ms`.  The job keeps its slot once it has run so it can be
+	// armed again with reschedule().
+	int after(const char *name, uint32_t delay_ms, std::function<void()> run);
+
+	// Move a job's next run to `delay_ms` from now, re-arming a finished one-shot job
+	void reschedule(int id, uint32_t delay_ms);
+	void cancel(int id);
+
+	// Run every job that is due, then return how long until the next one is
+	uint32_t run_due();
+	uint32_t ms_until_next() const;
+
+	size_t size() const;
+	const SchedulerJob &job(int id) const;
+	void reset_stats();
+
+	// One line summary of every job, for the heartbeat
+	String stats() const;
+};
+
+#endif
@@ -0,0 +1,141 @@
+#include "SensorAcquisition.h"
+
+void SensorLatency::record(uint32_t us) {
+	samples++;
+	last_us = us;
+	total_us += us;
+	if (us > max_us) {
+		max_us = us;
+	}
+}
+
+uint32_t SensorLatency::mean_us() const {
+	return samples ? total_us / samples : 0;
+}
+
+SensorAcquisition::SensorAcquisition(SensorObjects *sensors, SensorSnapshot *snapshot)
+	: _sensors(sensors), _snapshot(snapshot) {}
+
+void SensorAcquisition::start() {
+	if (busy()) {
+		// Decisions always need a fresh lead sensor reading, even if the others are behind
+		_snapshot->sample_climate(_sensors->temphumid);
+		return;
+	}
+
+	_start_us = uptime_us();
+
+	// Kick off the sensors that convert on their own first ...
+	if (!_sensors->temp->sensors.empty()) {
+		_sensors->temp->start_conversion();
+		_probes_pending = true;
+		_probes_due_us = _start_us + _sensors->temp->conversion_time_ms() * 1000UL;
+	}
+
+	if (_sensors->light->is_initialized()) {
+		_sensors->light->start_read();
+		_light_pending = true;
+		_light_due_us = _start_us + _sensors->light->integration_time_ms() * 1000UL;
+	}
+
+	// ... then do the blocking DHT22 read while they run
+	_snapshot->sample_climate(_sensors->temphumid);
+	_dht_latency.record(uptime_us() - _start_us);
+
+	_complete_if_done();
+	_arm_poll();
+}
+
+void SensorAcquisition::set_poll_timer(std::function<void(uint32_t)> poll_timer) {
+	_poll_timer = poll_timer;
+}
+
+void SensorAcquisition::poll() {
+	if (_probes_pending && _sensors->temp->conversion_ready()) {
+		_sensors->temp->collect_readings();
+		_snapshot->record_probes(_sensors->temp);
+		_probe_latency.record(uptime_us() - _start_us);
+		_probes_pending = false;
+		_complete_if_done();
+	}
+
+	if (_light_pending && _sensors->light->read_ready()) {
+		bool read_ok = _sensors->light->finish_read();
+		if (!read_ok) {
+			LOG_ERROR("Failed to read the light sensor's result");
+		}
+		_snapshot->record_light(_sensors->light, read_ok);
+		_light_latency.record(uptime_us() - _start_us);
+		_light_pending = false;
+		_complete_if_done();
+	}
+
+	_check_timeout();
+	_arm_poll();
+}
+
+void SensorAcquisition::_arm_poll() {
+	if (!busy() || !_poll_timer) {
+		return;
+	}
+
+	// When the first pending sensor is due, but no later than the timeout
+	uint64_t due_us = _start_us + ACQUISITION_TIMEOUT_MS * 1000UL;
+	if (_probes_pending) {
+		due_us = std::min(due_us, _probes_due_us);
+	}
+	if (_light_pending) {
+		due_us = std::min(due_us, _light_due_us);
+	}
+
+	// A sensor that's late gets looked at again shortly
+	uint64_t now_us = uptime_us();
+	_poll_timer(due_us > now_us ? (due_us - now_us + 999) / 1000 : ACQUISITION_RETRY_MS);
+}
+
+void SensorAcquisition::_check_timeout() {
+	if (!busy() || uptime_us() - _start_us < ACQUISITION_TIMEOUT_MS * 1000UL) {
+		return;
+	}
+
+	if (_probes_pending) {
+		LOG_ERROR("Timed out waiting for one-wire temperature conversion");
+		_probes_pending = false;
+	}
+	if (_light_pending) {
+		LOG_ERROR("Timed out waiting for light sensor integration");
+		_sensors->light->cancel_read();
+		_light_pending = false;
+	}
+	_timeouts++;
+}
+
+void SensorAcquisition::_complete_if_done() {
+	if (!busy()) {
+		_cycle_latency.record(uptime_us() - _start_us);
+	}
+}
+
+bool SensorAcquisition::busy() const {
+	return _probes_pending || _light_pending;
+}
+
+const SensorLatency &SensorAcquisition::cycle_latency() const {
+	return _cycle_latency;
+}
+
+const SensorLatency &SensorAcquisition::dht_latency() const {
+	return _dht_latency;
+}
+
+const SensorLatency &SensorAcquisition::probe_latency() const {
+	return _probe_latency;
+}
+
+const SensorLatency &SensorAcquisition::light_latency() const {
+	return _light_latency;
+}
+
+uint32_t SensorAcquisition::timeouts() const {
+	return _timeouts;
+}
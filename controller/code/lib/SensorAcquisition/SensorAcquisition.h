@@ -0,0 +1,80 @@
+#ifndef SENSORACQUISITION_H
+#define SENSORACQUISITION_H
+
+#include <Arduino.h>
+#include <functional>
+
+#include "LogQueue.h"
+#include "Clock.h"
+#include "monitor.h"
+#include "SensorSnapshot.h"
+
+// Give up on a sensor that hasn't produced a result in this long
+#define ACQUISITION_TIMEOUT_MS 2000
+
+// How soon to look again for a sensor that wasn't ready when it should have been
+#define ACQUISITION_RETRY_MS 10
+
+// Running latency figures for one sensor, from trigger to result, in microseconds
+struct SensorLatency {
+	uint32_t samples = 0;
+	uint32_t last_us = 0;
+	uint32_t max_us = 0;
+	uint64_t total_us = 0;
+
+	void record(uint32_t us);
+	uint32_t mean_us() const;
+};
+
+// Reads every sensor in parallel.  start() triggers the one-wire conversion and the light sensor
+// integration, both of which run on their own, then reads the DHT22 while they work.  poll()
+// collects each of the slow sensors as soon as it is ready, so a full acquisition takes as long
+// as the slowest sensor rather than the sum of all of them.
+//
+// Rather than being polled all the time, it asks through set_poll_timer() for poll() to be run
+// once when the next sensor should be ready, so the loop can sleep in between.
+class SensorAcquisition {
+    private:
+	SensorObjects *_sensors;
+	SensorSnapshot *_snapshot;
+	std::function<void(uint32_t)> _poll_timer;
+
+	uint64_t _start_us = 0;
+	bool _probes_pending = false;
+	bool _light_pending = false;
+	uint64_t _probes_due_us = 0;
+	uint64_t _light_due_us = 0;
+
+	SensorLatency _cycle_latency;
+	SensorLatency _dht_latency;
+	SensorLatency _probe_latency;
+	SensorLatency _light_latency;
+	uint32_t _timeouts = 0;
+
+	void _complete_if_done();
+	void _check_timeout();
+	void _arm_poll();
+
+    public:
+	SensorAcquisition(SensorObjects *sensors, SensorSnapshot *snapshot);
+
+	// Trigger all sensors and take the lead sensor reading.  If the last acquisition is still
+	// running only the lead sensor is read.
+	void start();
+
+	// Called with the delay in ms after which poll() should run, whenever sensors are pending
+	void set_poll_timer(std::function<void(uint32_t)> poll_timer);
+
+	// Collect any sensor that has finished.  Cheap, so it can also be called on every loop pass.
+	void poll();
+
+	bool busy() const;
+
+	const SensorLatency &cycle_latency() const;
+	const SensorLatency &dht_latency() const;
+	const SensorLatency &probe_latency() const;
+	const SensorLatency &light_latency() const;
+	uint32_t timeouts() const;
+};
+
+#endif
@@ -0,0 +1,36 @@
+#include "SensorSnapshot.h"
+
+void SensorSnapshot::sample_climate(TempHumiditySensor *temphumid) {
+	// The sensor falls back to its last good value on a failed read, so keep the value
+	// either way but record whether it is fresh.
+	temperature = temphumid->current_temperature();
+	temperature_valid = temphumid->temperature_valid();
+
+	humidity = temphumid->current_humidity();
+	humidity_valid = temphumid->humidity_valid();
+
+	valid = temperature_valid && humidity_valid;
+	taken_ms = uptime_ms();
+}
+
+void SensorSnapshot::record_probes(SensorHandler *temp) {
+	probes_valid = temp->has_readings() && !temp->sensors.empty();
+	probes_taken_ms = uptime_ms();
+}
+
+void SensorSnapshot::record_light(LightSensor *light, bool read_ok) {
+	light_valid = read_ok;
+	full_luminosity = light->getFullLuminosity();
+	ir = light->getIR();
+	visible = light->getVisible();
+	lux = light_valid ? light->getLux() : 0;
+	light_taken_ms = uptime_ms();
+}
+
+bool SensorSnapshot::has_sample() const {
+	return taken_ms != 0;
+}
+
+uint64_t SensorSnapshot::age_ms() const {
+	return uptime_ms() - taken_ms;
+}
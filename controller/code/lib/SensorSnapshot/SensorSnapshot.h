@@ -0,0 +1,46 @@
+#ifndef SENSORSNAPSHOT_H
+#define SENSORSNAPSHOT_H
+
+#include <Arduino.h>
+
+#include "LogQueue.h"
+#include "Clock.h"
+#include "monitor.h"
+
+// A single, consistent set of sensor readings.  Each sensor is read once when the snapshot is
+// taken and every decision and report made for that tick works from these values, rather than
+// going back to the hardware (the DHT22 in particular is bit-banged with interrupts disabled).
+class SensorSnapshot {
+    public:
+	// When the lead (DHT22) sensor was last sampled, and whether both of its reads succeeded
+	uint64_t taken_ms = 0;
+	bool valid = false;
+
+	float temperature = 0;
+	float humidity = 0;
+	bool temperature_valid = false;
+	bool humidity_valid = false;
+
+	// The one-wire probes and light sensor take hundreds of ms to convert, so they are
+	// recorded as each one finishes (see SensorAcquisition).  Probe readings live on the
+	// SensorHandler's sensors.
+	uint64_t probes_taken_ms = 0;
+	uint64_t light_taken_ms = 0;
+	bool probes_valid = false;
+	bool light_valid = false;
+
+	uint32_t full_luminosity = 0;
+	uint16_t ir = 0;
+	uint32_t visible = 0;
+	float lux = 0;
+
+	void sample_climate(TempHumiditySensor *temphumid);
+	void record_probes(SensorHandler *temp);
+	// `read_ok` is whether the light sensor's result was read back; see LightSensor::finish_read()
+	void record_light(LightSensor *light, bool read_ok);
+
+	bool has_sample() const;
+	uint64_t age_ms() const;
+};
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <stddef.h>
+
+// A fixed size, lock-free queue for handing items from exactly one producer task to exactly one
+// consumer task.  Neither side ever blocks: push() fails when full and pop() fails when empty.
+template <typename T, size_t N>
+class SpscQueue {
+	static_assert(N > 0 && (N & (N - 1)) == 0, "SpscQueue size must be a power of two");
+
+    private:
+	T _items[N];
+
+	// Free running counters; only the consumer writes _head and only the producer writes _tail
+	std::atomic<size_t> _head{0};
+	std::atomic<size_t> _tail{0};
+
+    public:
+	// Producer side
+	bool push(const T &item) {
+		size_t tail = _tail.load(std::memory_order_relaxed);
+		if (tail - _head.load(std::memory_order_acquire) == N) {
+			return false;
+		}
+
+		_items[tail & (N - 1)] = item;
+		_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer side
+	bool pop(T &item) {
+		size_t head = _head.load(std::memory_order_relaxed);
+		if (head == _tail.load(std::memory_order_acquire)) {
+			return false;
+		}
+
+		item = _items[head & (N - 1)];
+		_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Approximate when called from the other side while it is active
+	size_t size() const {
+		return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire);
+	}
+
+	bool empty() const {
+		return size() == 0;
+	}
+};
+
+#endif
@@ -1,9 +1,7 @@
 #include <TempHumiditySensor.h>
 
-extern Logger *LOGGER;
-
 TempHumiditySensor::TempHumiditySensor(uint8_t pin) {
-    LOGGER->log("Initializing SensorControl");
+    LOG_INFO("Initializing SensorControl");
     _sensor = new DHT(pin, DHT_TYPE);
     _sensor->begin();
 }
@@ -11,7 +9,7 @@ TempHumiditySensor::TempHumiditySensor(uint8_t pin) {
 float TempHumiditySensor::current_temperature() {
     float t = _sensor->readTemperature(USE_FAHRENHEIT);
     if (std::isnan(t)) {
-        LOGGER->log_error("Failed to read temperature from LEAD sensor, using last valid temperature");
+        LOG_ERROR("Failed to read temperature from LEAD sensor, using last valid temperature");
         _last_temperature_read_valid = false;
         // Use the last valid temperature if the read failed
         t = _last_temperature;
@@ -26,7 +24,7 @@ float TempHumiditySensor::current_temperature() {
 float TempHumiditySensor::current_humidity() {
     float h = _sensor->readHumidity();
     if (std::isnan(h)) {
-        LOGGER->log_error("Failed to read humidity from LEAD sensor, using last valid humidity");
+        LOG_ERROR("Failed to read humidity from LEAD sensor, using last valid humidity");
         _last_humidity_read_valid = false;
         // Use the last valid humidity if the read failed
         h = _last_humidity;
@@ -35,4 +33,12 @@ float TempHumiditySensor::current_humidity() {
         _last_humidity = h;
     }
     return h;
+}
+
+bool TempHumiditySensor::temperature_valid() const {
+    return _last_temperature_read_valid;
+}
+
+bool TempHumiditySensor::humidity_valid() const {
+    return _last_humidity_read_valid;
 }
\ No newline at end of file
@@ -4,7 +4,7 @@
 #include <Arduino.h>
 #include <DHT.h>
 
-#include "Logger.h"
+#include "LogQueue.h"
 
 #define DHT_TYPE DHT22
 #define USE_FAHRENHEIT true
@@ -24,6 +24,10 @@ class TempHumiditySensor {
     float current_temperature();
     float current_humidity();
 
+    // Whether the most recent read succeeded, or fell back to the last valid value
+    bool temperature_valid() const;
+    bool humidity_valid() const;
+
 
 };
 
@@ -1,7 +1,5 @@
 #include "TempSensor.h"
 
-extern Logger *LOGGER;
-
 Sensor::Sensor(byte addr[8]) {
 	for (int i = 0; i < 8; i++) {
 		address[i] = addr[i];
@@ -13,19 +11,25 @@ String Sensor::get_address_string() const {
 }
 
 String Sensor::byteArrayToString(const byte address[8]) {
-    String address_string = "";
-    for (int i = 0; i < 8; i++) {
-        if (address[i] < 16) address_string += "0";
-        address_string += String(address[i], HEX);
-    }
-    return address_string;
+    char address_string[SENSOR_ADDRESS_CHARS];
+    format_address(address, address_string);
+    return String(address_string);
+}
+
+void Sensor::format_address(const byte address[8], char out[SENSOR_ADDRESS_CHARS]) {
+    snprintf(out, SENSOR_ADDRESS_CHARS, "%02x%02x%02x%02x%02x%02x%02x%02x",
+             address[0], address[1], address[2], address[3], address[4], address[5], address[6], address[7]);
 }
 
-SensorHandler::SensorHandler(): _one_wire(ONE_WIRE_BUS_PIN), _sensor_interface(&_one_wire) {
+SensorHandler::SensorHandler(uint8_t resolution): _one_wire(ONE_WIRE_BUS_PIN), _sensor_interface(&_one_wire) {
 	// Start up the library
 	_sensor_interface.begin();
 
+	// We time the conversions ourselves rather than have the library block on them
+	_sensor_interface.setWaitForConversion(false);
+
 	scan();
+	set_resolution(resolution);
 }
 
 void SensorHandler::scan() {
@@ -33,10 +37,10 @@ void SensorHandler::scan() {
 	sensors.clear();
 
 	byte address[8];
+	char address_string[SENSOR_ADDRESS_CHARS];
 	while (_one_wire.search(address)) {
-		Serial.printf("Found device with address: %s\n",
-			Sensor::byteArrayToString(address).c_str());
-		LOGGER->log("Found temperature device with address: " + Sensor::byteArrayToString(address));
+		Sensor::format_address(address, address_string);
+		LOG_INFO("Found temperature device with address: %s", address_string);
 
 		sensors.push_back(Sensor(address));
 	}
@@ -44,15 +48,86 @@ void SensorHandler::scan() {
 	// Reset search for next loop
 	_one_wire.reset_search();
 
-	Serial.printf("Found %d devices.\n", sensors.size());
+	LOG_INFO("Found %d devices.", (int) sensors.size());
 }
 
-void SensorHandler::load_readings() {
+void SensorHandler::set_resolution(uint8_t resolution) {
+	if (resolution < 9) {
+		resolution = 9;
+	} else if (resolution > 12) {
+		resolution = 12;
+	}
+
+	_resolution = resolution;
+	_sensor_interface.setResolution(_resolution);
+	_conversion_time_ms = _sensor_interface.millisToWaitForConversion(_resolution);
+
+	// A conversion already running was started at the old resolution
+	_converting = false;
+}
+
+uint8_t SensorHandler::get_resolution() const {
+	return _resolution;
+}
+
+unsigned long SensorHandler::conversion_time_ms() const {
+	return _conversion_time_ms;
+}
+
+void SensorHandler::start_conversion() {
 	_sensor_interface.requestTemperatures();
-	delay(ONE_WIRE_SETTLE_MILLIS);
+	_conversion_start_ms = uptime_ms();
+	_converting = true;
+}
+
+bool SensorHandler::conversion_ready() const {
+	return _converting && uptime_ms() - _conversion_start_ms >= _conversion_time_ms;
+}
 
+bool SensorHandler::poll() {
+	if (!_converting) {
+		start_conversion();
+		return false;
+	}
+
+	if (!conversion_ready()) {
+		return false;
+	}
+
+	collect_readings();
+
+	// Start the next one straight away so a fresh reading is waiting for the next poll
+	start_conversion();
+	return true;
+}
+
+bool SensorHandler::has_readings() const {
+	return _has_readings;
+}
+
+uint64_t SensorHandler::last_reading_ms() const {
+	return _last_reading_ms;
+}
+
+void SensorHandler::load_readings() {
+	start_conversion();
+	delay(conversion_time_ms());
+	collect_readings();
+}
+
+void SensorHandler::collect_readings() {
+	_converting = false;
+
+	char address_string[SENSOR_ADDRESS_CHARS];
 	for (auto &sensor : sensors) {
 		sensor.temp = _sensor_interface.getTempC(sensor.address);
-		Serial.printf("Sensor %s: %f\n", sensor.get_address_string().c_str(), sensor.temp);
+		sensor.valid = sensor.temp != DEVICE_DISCONNECTED_C;
+		if (LOG_LEVEL >= LOG_LEVEL_DEBUG) {
+			Sensor::format_address(sensor.address, address_string);
+			LOG_DEBUG("Sensor %s: %.2f", address_string, sensor.temp);
+		}
 	}
+
+	_last_reading_ms = uptime_ms();
+	_has_readings = true;
 }
@@ -5,21 +5,32 @@
 #include <DallasTemperature.h>
 #include <vector>
 
-#include "Logger.h"
+#include "LogQueue.h"
+#include "Clock.h"
 
-#define ONE_WIRE_SETTLE_MILLIS 500
+// DS18B20 resolution, 9-12 bits.  Each bit halves the step size (0.5C down to 0.0625C) and
+// doubles the conversion time (94ms up to 750ms).
+#ifndef ONE_WIRE_RESOLUTION
+#define ONE_WIRE_RESOLUTION 12
+#endif
+
+// Hex digits of a one-wire address and the terminator
+#define SENSOR_ADDRESS_CHARS 17
 
 class Sensor {
     private:
 
     public:
 	float temp;
+	// False if the sensor didn't answer on the last read
+	bool valid = false;
 	byte address[8];
 
     Sensor(byte addr[8]);
 	String get_address_string() const;
 
 	static String byteArrayToString(const byte address[8]);
+	static void format_address(const byte address[8], char out[SENSOR_ADDRESS_CHARS]);
 };
 
 class SensorHandler {
@@ -27,11 +38,34 @@ class SensorHandler {
 	OneWire _one_wire;
 	DallasTemperature _sensor_interface;
 
+	uint8_t _resolution;
+	unsigned long _conversion_time_ms;
+	bool _converting = false;
+	uint64_t _conversion_start_ms = 0;
+	uint64_t _last_reading_ms = 0;
+	bool _has_readings = false;
+
     public:
 	std::vector<Sensor> sensors;
 
-    SensorHandler();
+    SensorHandler(uint8_t resolution = ONE_WIRE_RESOLUTION);
 	void scan();
+
+	void set_resolution(uint8_t resolution);
+	uint8_t get_resolution() const;
+	unsigned long conversion_time_ms() const;
+
+	// Non-blocking reads: start a conversion, then collect once it has had time to finish.
+	// poll() does both and can be called every tick; it returns true when new readings arrived.
+	void start_conversion();
+	bool conversion_ready() const;
+	void collect_readings();
+	bool poll();
+
+	bool has_readings() const;
+	uint64_t last_reading_ms() const;
+
+	// Blocking read, waits out the full conversion
 	void load_readings();
 };
 
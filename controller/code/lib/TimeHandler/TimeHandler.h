@@ -3,7 +3,7 @@
 
 #include <Arduino.h>
 
-#include "Logger.h"
+#include "LogQueue.h"
 
 // From https://github.com/esp8266/Arduino/blob/master/cores/esp8266/TZ.h
 #define TIME_ZONE "PST8PDT,M3.2.0,M11.1.0"
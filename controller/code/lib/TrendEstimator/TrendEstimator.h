@@ -0,0 +1,140 @@
+#ifndef TRENDESTIMATOR_H
+#define TRENDESTIMATOR_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "RingBuffer.h"
+
+// A trend needs at least this many samples before it can be trusted
+#define TREND_MIN_SAMPLES 5
+
+// How many standard errors the slope must be from zero to count as a real trend
+#define TREND_MIN_T 2.0
+
+struct TrendEstimate {
+	// Least squares slope, in units per minute, and its standard error
+	float rate_per_min = 0;
+	float stderr_per_min = 0;
+	// Fraction of the variance the line explains, 0-1
+	float r_squared = 0;
+	uint16_t samples = 0;
+
+	bool is_significant() const {
+		return samples >= TREND_MIN_SAMPLES && fabsf(rate_per_min) >= TREND_MIN_T * stderr_per_min;
+	}
+
+	// Change over the period if the current rate holds
+	float change_over(uint32_t seconds) const {
+		return rate_per_min * seconds / 60.0f;
+	}
+};
+
+// Least squares slope over the most recent 'window' samples, updated in O(1) per sample by
+// keeping running sums and subtracting the sample that drops out.  The sums are rebuilt from
+// the stored samples every N additions so float error can't accumulate.
+template <size_t N>
+class TrendEstimator {
+    private:
+	// One extra slot so the sample leaving the window is still available
+	RingBuffer<float, N + 1> _history;
+	float _period_s;
+	size_t _window = N;
+
+	// Sums over the window with x = 0 for the oldest sample
+	size_t _n = 0;
+	double _sum_y = 0;
+	double _sum_xy = 0;
+	double _sum_yy = 0;
+	size_t _since_rebuild = 0;
+
+	void _rebuild() {
+		_n = 0;
+		_sum_y = 0;
+		_sum_xy = 0;
+		_sum_yy = 0;
+
+		size_t count = _history.size() < _window ? _history.size() : _window;
+		for (size_t age = count; age > 0; age--) {
+			_append(_history.back(age - 1));
+		}
+		_since_rebuild = 0;
+	}
+
+	void _append(double y) {
+		_sum_xy += _n * y;
+		_sum_y += y;
+		_sum_yy += y * y;
+		_n++;
+	}
+
+    public:
+	TrendEstimator(float sample_period_s) : _period_s(sample_period_s) {}
+
+	// Number of samples the slope is fitted over, clamped to 3..N
+	void set_window(size_t samples) {
+		if (samples < 3) {
+			samples = 3;
+		} else if (samples > N) {
+			samples = N;
+		}
+
+		if (samples != _window) {
+			_window = samples;
+			_rebuild();
+		}
+	}
+
+	size_t window() const {
+		return _window;
+	}
+
+	void add(float y) {
+		_history.push(y);
+
+		if (_n == _window) {
+			// Drop the oldest sample and shift everyone's x down by one
+			double oldest = _history.back(_window);
+			_sum_xy -= _sum_y - oldest;
+			_sum_y -= oldest;
+			_sum_yy -= oldest * oldest;
+			_n--;
+		}
+		_append(y);
+
+		if (++_since_rebuild >= N) {
+			_rebuild();
+		}
+	}
+
+	TrendEstimate estimate() const {
+		TrendEstimate result;
+		result.samples = _n;
+		if (_n < 3) {
+			return result;
+		}
+
+		double n = _n;
+		double sum_x = n * (n - 1) / 2;
+		double sum_xx = (n - 1) * n * (2 * n - 1) / 6;
+
+		double sxx = sum_xx - sum_x * sum_x / n;
+		double sxy = _sum_xy - sum_x * _sum_y / n;
+		double syy = _sum_yy - _sum_y * _sum_y / n;
+
+		double slope = sxy / sxx;
+		double sse = syy - slope * sxy;
+		if (sse < 0) {
+			sse = 0;
+		}
+
+		double per_min = 60.0 / _period_s;
+		result.rate_per_min = slope * per_min;
+		result.stderr_per_min = sqrt(sse / (n - 2) / sxx) * per_min;
+		result.r_squared = syy > 0 ? slope * sxy / syy : 0;
+		return result;
+	}
+};
+
+#endif
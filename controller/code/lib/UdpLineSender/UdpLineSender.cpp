@@ -0,0 +1,71 @@
+#include "UdpLineSender.h"
+
+UdpLineSender::UdpLineSender(const char *device) {
+	LineEncoder prefix(_sequence_prefix, sizeof(_sequence_prefix));
+	prefix.begin("udp_packets");
+	prefix.tag("device", device);
+	_sequence_prefix_len = prefix.overflowed() ? 0 : prefix.length();
+}
+
+void UdpLineSender::set_destination(const String &host, uint16_t port) {
+	_host = host;
+	_port = port;
+}
+
+char *UdpLineSender::line_buffer() {
+	return _packet + _packet_len;
+}
+
+size_t UdpLineSender::line_capacity() const {
+	return UDP_PACKET_BYTES - UDP_SEQUENCE_LINE_BYTES - _packet_len;
+}
+
+void UdpLineSender::commit_line(size_t len) {
+	_packet_len += len;
+	_packet_lines++;
+}
+
+bool UdpLineSender::empty() const {
+	return _packet_lines == 0;
+}
+
+bool UdpLineSender::flush() {
+	if (_packet_lines == 0) {
+		return true;
+	}
+
+	// Numbered whether or not it goes out, so a packet that couldn't be sent shows as lost
+	_sequence++;
+
+	size_t len = _packet_len;
+	if (_sequence_prefix_len > 0) {
+		LineEncoder line(_packet + len, UDP_PACKET_BYTES - len);
+		line.begin(_sequence_prefix, _sequence_prefix_len);
+		line.field("sequence", (int32_t) _sequence);
+		line.field("lines", (int32_t) _packet_lines);
+		if (line.end()) {
+			len += line.length();
+		}
+	}
+
+	bool sent = _port > 0 && _udp.beginPacket(_host.c_str(), _port) &&
+		_udp.write((const uint8_t *) _packet, len) == len && _udp.endPacket();
+
+	if (sent) {
+		_packets_sent++;
+		_lines_sent += _packet_lines;
+		_bytes_sent += len;
+	} else {
+		_send_failures++;
+		_lines_dropped += _packet_lines;
+	}
+
+	_packet_len = 0;
+	_packet_lines = 0;
+	return sent;
+}
+
+String UdpLineSender::stats() const {
+	return "packets=" + String(_packets_sent) + ", lines=" + String(_lines_sent) + ", bytes=" + String(_bytes_sent) +
+		", failures=" + String(_send_failures) + ", dropped=" + String(_lines_dropped) + ", sequence=" + String(_sequence);
+}
@@ -0,0 +1,77 @@
+#ifndef UDPLINESENDER_H
+#define UDPLINESENDER_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiUdp.h>
+
+#include "LineEncoder.h"
+
+// Largest datagram sent.  Kept under the 1472 bytes a 1500 byte Ethernet/WiFi MTU leaves for
+// UDP so packets are never fragmented, where losing any fragment loses the whole packet.
+#ifndef UDP_PACKET_BYTES
+#define UDP_PACKET_BYTES 1400
+#endif
+
+// Room kept at the end of each packet for its sequence line
+#define UDP_SEQUENCE_LINE_BYTES 128
+
+// Sends line protocol to InfluxDB's UDP listener, fire and forget.  Lines are packed into
+// datagrams up to UDP_PACKET_BYTES, and each datagram ends with a line of its own,
+//
+//   udp_packets,device=<device> sequence=<n>i,lines=<lines in the packet>i
+//
+// so the receiver can measure loss from gaps in the sequence.  The sequence restarts at 1 when
+// the controller boots.  That line has no timestamp, so it records when the packet arrived.
+//
+// The listener must be set up with precision = "s" to match the timestamps on the lines, e.g.
+//
+//   [[udp]]
+//     enabled = true
+//     bind-address = ":8089"
+//     database = "greenhouse"
+//     precision = "s"
+//
+// Only used from the network task, so there is no locking.
+class UdpLineSender {
+    private:
+	WiFiUDP _udp;
+	String _host;
+	uint16_t _port = 0;
+
+	char _sequence_prefix[LINE_PREFIX_BYTES];
+	size_t _sequence_prefix_len = 0;
+	uint32_t _sequence = 0;
+
+	char _packet[UDP_PACKET_BYTES];
+	size_t _packet_len = 0;
+	uint16_t _packet_lines = 0;
+
+	uint32_t _packets_sent = 0;
+	uint32_t _lines_sent = 0;
+	uint32_t _bytes_sent = 0;
+	uint32_t _send_failures = 0;
+	uint32_t _lines_dropped = 0;
+
+    public:
+	// `device` must outlive the sender
+	UdpLineSender(const char *device);
+
+	void set_destination(const String &host, uint16_t port);
+
+	// Where to encode the next line, and how much room is left for it in the current packet
+	char *line_buffer();
+	size_t line_capacity() const;
+	// Add the line just encoded at line_buffer() to the packet
+	void commit_line(size_t len);
+
+	bool empty() const;
+
+	// Send the current packet, if it has any lines.  False if it couldn't be sent, in which case
+	// its lines are dropped and counted.
+	bool flush();
+
+	String stats() const;
+};
+
+#endif
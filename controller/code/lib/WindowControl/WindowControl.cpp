@@ -1,10 +1,8 @@
 #include <WindowControl.h>
 
-extern Logger *LOGGER;
-
 WindowControl::WindowControl(uint8_t open_pin, uint8_t close_pin)
     : _control_pin_open(open_pin), _control_pin_close(close_pin) {
-    LOGGER->log("Initializing WindowControl");
+    LOG_INFO("Initializing WindowControl");
 
     pinMode(_control_pin_open, OUTPUT);
     digitalWrite(_control_pin_open, LOW);
@@ -26,13 +24,13 @@ void WindowControl::monitor() {
     }
 
     // If WINDOW_MOVE_TIME_MS has elapsed, then set all control pins to low to stop everything
-    if (millis() >= move_start_ms + WINDOW_MOVE_TIME_MS) {
+    if (uptime_ms() - move_start_ms >= WINDOW_MOVE_TIME_MS) {
         digitalWrite(_control_pin_open, LOW);
         digitalWrite(_control_pin_close, LOW);
         _is_moving = false;
 
         Serial.println("<< Window has finished moving >>");
-        LOGGER->log("Window has finished moving");
+        LOG_INFO("Window has finished moving");
     }
 }
 
@@ -41,13 +39,13 @@ void WindowControl::open() {
     digitalWrite(_control_pin_close, LOW);
 
     digitalWrite(_control_pin_open, HIGH);
-    move_start_ms = millis();
+    move_start_ms = uptime_ms();
     _is_moving = true;
 
     _is_open = true;
-    last_open_time_ms = millis();
+    last_open_time_ms = move_start_ms;
 
-    LOGGER->log("Window open started");
+    LOG_INFO("Window open started");
 }
 
 void WindowControl::close() {
@@ -55,12 +53,12 @@ void WindowControl::close() {
     digitalWrite(_control_pin_open, LOW);
 
     digitalWrite(_control_pin_close, HIGH);
-    move_start_ms = millis();
+    move_start_ms = uptime_ms();
     _is_moving = true;
 
     _is_open = false;
 
-    LOGGER->log("Window close started");
+    LOG_INFO("Window close started");
 }
 
 bool WindowControl::is_open() {
@@ -77,4 +75,12 @@ bool WindowControl::is_moving() {
 
 bool WindowControl::is_stopped() {
     return !_is_moving;
+}
+
+uint32_t WindowControl::ms_until_stopped() {
+    uint64_t elapsed_ms = uptime_ms() - move_start_ms;
+    if (!_is_moving || elapsed_ms >= WINDOW_MOVE_TIME_MS) {
+        return 0;
+    }
+    return WINDOW_MOVE_TIME_MS - elapsed_ms;
 }
\ No newline at end of file
@@ -3,7 +3,8 @@
 
 #include <Arduino.h>
 
-#include "Logger.h"
+#include "LogQueue.h"
+#include "Clock.h"
 
 // Time in seconds to wait for window to close
 #define WINDOW_MOVE_TIME_S 20
@@ -17,21 +18,24 @@ class WindowControl {
     bool _is_moving = false;
 
     public:
-    long move_start_ms = 0;
-    long last_open_time_ms = 0;
+    uint64_t move_start_ms = 0;
+    uint64_t last_open_time_ms = 0;
 
 
     WindowControl(uint8_t open_pin, uint8_t close_pin);
     void open();
     void close();
     void monitor();
-    long millis_since_open();
-    long seconds_since_open();
+    uint64_t millis_since_open();
+    uint64_t seconds_since_open();
 
     bool is_open();
     bool is_closed();
     bool is_moving();
     bool is_stopped();
+
+    // Time left before monitor() will stop the motor, 0 when it isn't moving
+    uint32_t ms_until_stopped();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,140 @@
+//----------------------------------------------------
+// Runs the climate control, settings and InfluxDB code on the host against the NativeHal fakes.
+// The greenhouse warms through the morning and cools in the afternoon while the program prints
+// what the controls do and what would have been sent to InfluxDB.
+//
+//   pio run -e native && .pio/build/native/program
+
+#include <Arduino.h>
+#include <monitor.h>
+#include <HTTPClient.h>
+#include <NativeHal.h>
+
+#include "Logger.h"
+#include "LogQueue.h"
+#include "ClimateControl.h"
+#include "ExternalSettings.h"
+#include "InfluxDBHandler.h"
+
+// How long to run, in simulated time
+#ifndef NATIVE_RUN_HOURS
+#define NATIVE_RUN_HOURS 8
+#endif
+
+// Time that passes between passes through the loop
+#define NATIVE_LOOP_STEP_MS 100
+
+Logger *LOGGER = nullptr;
+
+const char *SETTINGS_JSON = "{\"target_temp_f\": 72, \"max_temp_f\": 82, \"min_temp_f\": 62, "
+                            "\"target_humidity\": 60, \"mist_on_s\": 30, \"mist_off_s\": 120}";
+
+// Rises 20F over the first half of the run then falls back, in Celsius like the DHT22
+float greenhouse_temp_c(unsigned long elapsed_s) {
+    float half = NATIVE_RUN_HOURS * 3600 / 2.0;
+    float progress = elapsed_s < half ? elapsed_s / half : 2 - elapsed_s / half;
+    float temp_f = 64 + 20 * progress;
+    return (temp_f - 32) / 1.8;
+}
+
+int main() {
+    NativeHal::reset();
+    NativeHal::set_echo(false, true);
+
+    NativeHal::set_http_handler([](const NativeHal::HttpRequest &request) {
+        NativeHal::HttpResponse response;
+        response.code = HTTP_CODE_OK;
+        response.headers["ETag"] = "\"v1\"";
+        response.body = SETTINGS_JSON;
+
+        if (request.headers.count("If-None-Match") && request.headers.at("If-None-Match") == "\"v1\"") {
+            response.code = HTTP_CODE_NOT_MODIFIED;
+            response.body.clear();
+        }
+        return response;
+    });
+
+    const uint8_t probe[8] = {0x28, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07};
+    NativeHal::add_onewire_device(probe, 20);
+    NativeHal::set_light(1200, 300);
+
+    LOGGER = new Logger();
+    LOGGER->init(SYSLOG_SERVER, SYSLOG_PORT, HOSTNAME, APP_NAME);
+    // There's no log task here, so LogQueue hands each message straight to this
+    LogQueue::add_sink([](uint8_t level, const char *message) {
+        level == LOG_LEVEL_ERROR ? LOGGER->log_error(message) : LOGGER->log_info(message);
+    });
+
+    ExternalSettings *settings = new ExternalSettings(SETTINGS_HOST, SETTINGS_PORT, SETTINGS_PATH);
+    settings->monitor();
+
+    ControlObjects *controls = new ControlObjects();
+    controls->fan = new FanControl(FAN_CONTROL_PIN);
+    controls->window = new WindowControl(WINDOW_OPEN_PIN, WINDOW_CLOSE_PIN);
+    controls->mist = new MistControl(MIST_CONTROL_PIN);
+
+    SensorObjects *sensors = new SensorObjects();
+    sensors->temphumid = new TempHumiditySensor(DT22_PIN);
+    sensors->temp = new SensorHandler();
+    sensors->light = new LightSensor();
+
+    ClimateControl *climate = new ClimateControl(settings, sensors, controls);
+    InfluxDBHandler *influx = new InfluxDBHandler(INFLUXDB_URL, INFLUXDB_DB, DEVICE);
+    influx->set_compression_level(INFLUX_GZIP_LEVEL);
+    climate->enable_influx_collection(influx);
+
+    uint64_t start_ms = uptime_ms();
+    uint64_t last_collection_ms = start_ms - COLLECTION_PERIOD_MS;
+    uint64_t last_monitor_ms = start_ms - MONITOR_PERIOD_MS;
+
+    bool fan_on = false;
+    bool window_open = false;
+    bool mist_on = false;
+
+    while (uptime_ms() - start_ms < NATIVE_RUN_HOURS * 3600UL * 1000) {
+        unsigned long elapsed_s = (uptime_ms() - start_ms) / 1000;
+        float temp_c = greenhouse_temp_c(elapsed_s);
+        NativeHal::set_dht(temp_c, 65);
+        NativeHal::set_onewire_temp(0, temp_c - 1);
+
+        if (uptime_ms() - last_collection_ms >= COLLECTION_PERIOD_MS) {
+            climate->report_metrics();
+
+            // The network task's work, done in line
+            settings->monitor();
+            influx->flush();
+
+            last_collection_ms = uptime_ms();
+        }
+
+        if (uptime_ms() - last_monitor_ms >= MONITOR_PERIOD_MS) {
+            climate->monitor();
+            last_monitor_ms = uptime_ms();
+        }
+
+        climate->poll_sensors();
+
+        if (controls->fan->is_on() != fan_on || controls->window->is_open() != window_open || controls->mist->is_on() != mist_on) {
+            fan_on = controls->fan->is_on();
+            window_open = controls->window->is_open();
+            mist_on = controls->mist->is_on();
+            printf("%02lu:%02lu  %.1fF  fan=%s window=%s mist=%s\n", elapsed_s / 3600, (elapsed_s / 60) % 60,
+                   temp_c * 1.8 + 32, fan_on ? "on" : "off", window_open ? "open" : "closed", mist_on ? "on" : "off");
+        }
+
+        delay(NATIVE_LOOP_STEP_MS);
+    }
+
+    size_t lines = 0;
+    for (const auto &write : NativeHal::state().influx_writes) {
+        lines += std::count(write.begin(), write.end(), '\n');
+    }
+
+    printf("InfluxDB: %zu requests, %zu lines (%s)\n", NativeHal::state().influx_writes.size(), lines, influx->stats().c_str());
+    printf("InfluxDB wire bytes: %llu, %u requests gzipped\n", (unsigned long long) NativeHal::state().influx_wire_bytes,
+           NativeHal::state().influx_gzip_writes);
+    printf("Settings requests: %u\n", NativeHal::state().http_requests);
+    printf("Connections opened: %u, %s %s\n", NativeHal::state().http_connects,
+           settings->connection().stats().c_str(), influx->connection().stats().c_str());
+    return 0;
+}
@@ -0,0 +1,159 @@
+//----------------------------------------------------
+// Measures what gzip saves on InfluxDB writes, on the host.  A day of the readings the
+// controller reports each collection period is written through InfluxDBHandler at each
+// compression level, to the NativeHal stand-in for InfluxDB, which decompresses and checks every
+// gzip body.  Reports the bytes that went over the wire and an estimate of the airtime they
+// take on a weak link.  Compression time is host CPU time, so only the ratio between levels
+// means much for the ESP32.
+//
+//   pio run -e native-gzip-bench && .pio/build/native-gzip-bench/program
+
+#include <Arduino.h>
+#include <monitor.h>
+#include <NativeHal.h>
+#include <chrono>
+
+#include "Logger.h"
+#include "LogQueue.h"
+#include "GzipEncoder.h"
+#include "InfluxDBHandler.h"
+
+#define BENCH_PERIODS (24 * 3600 / COLLECTION_PERIOD_S)
+
+// Roughly what a request's headers take, which compression doesn't touch
+#define BENCH_REQUEST_HEADER_BYTES 200
+
+// TCP payload per segment
+#define BENCH_MSS_BYTES 1436
+// IP, TCP, LLC and 802.11 MAC headers added to each segment
+#define BENCH_FRAME_OVERHEAD_BYTES 82
+
+// A link at the edge of range: the rate the payload goes at, and the fixed cost of each frame
+// in preamble, interframe spaces and the ACK
+struct BenchLink {
+    const char *name;
+    float mbps;
+    float frame_us;
+};
+
+static const BenchLink LINKS[] = {
+    {"1 Mbps DSSS", 1, 192 + 10 + 304 + 50},
+    {"6.5 Mbps MCS0", 6.5, 36 + 16 + 44 + 34},
+};
+
+Logger *LOGGER = nullptr;
+
+static const char *PROBES[] = {"28FF641E8C160468", "28FF1A2B3C4D5E6F", "28FF0B9D21170355", "28FF73C4A1160524"};
+
+// What ClimateControl::report_metrics() and the heartbeat record each period, with some noise
+static void record_period(InfluxDBHandler *influx, uint32_t period) {
+    float day = (period % BENCH_PERIODS) / (float) BENCH_PERIODS;
+    float temp_c = 18 + 10 * sin(day * 2 * M_PI) + (period * 7 % 13) / 10.0;
+
+    influx->write_sensor_metric("DHT22", "temperature", temp_c);
+    influx->write_sensor_metric("DHT22", "humidity", 60 + (period * 11 % 17) / 3.0);
+    for (uint8_t i = 0; i < 4; i++) {
+        influx->write_sensor_metric(PROBES[i], "temperature", temp_c - 1 + i * 0.25 + (period * 3 % 7) / 8.0);
+    }
+    influx->write_sensor_metric("light", "full_luminosity", 1200 + period % 400);
+    influx->write_sensor_metric("light", "ir", 300 + period % 90);
+    influx->write_sensor_metric("light", "visible", 900 + period % 310);
+    influx->write_sensor_metric("light", "lux", 180.5 + (period % 200) / 3.0);
+    influx->write_sensor_metric("controller", "loop_duty_cycle", 2 + (period % 9) / 7.0);
+
+    if (period % 20 == 0) {
+        influx->event_fan_on("Over max temp");
+    } else if (period % 20 == 5) {
+        influx->event_fan_off("Short term temperature drop");
+    }
+}
+
+struct BenchResult {
+    size_t requests;
+    uint64_t raw_bytes;
+    uint64_t wire_bytes;
+    uint32_t gzip_requests;
+    double airtime_ms[2];
+    double compress_us;
+};
+
+static size_t segments(size_t bytes) {
+    return (bytes + BENCH_MSS_BYTES - 1) / BENCH_MSS_BYTES;
+}
+
+static BenchResult run(uint8_t level) {
+    NativeHal::reset();
+    NativeHal::set_echo(false, false);
+
+    InfluxDBHandler *influx = new InfluxDBHandler(INFLUXDB_URL, INFLUXDB_DB, DEVICE);
+    influx->set_compression_level(level);
+
+    for (uint32_t period = 0; period < BENCH_PERIODS; period++) {
+        record_period(influx, period);
+        influx->flush();
+        delay(COLLECTION_PERIOD_MS);
+    }
+
+    BenchResult result = {};
+    NativeHal::State &hal = NativeHal::state();
+    result.requests = hal.influx_writes.size();
+    result.wire_bytes = hal.influx_wire_bytes;
+    result.gzip_requests = hal.influx_gzip_writes;
+
+    // The server has to have ended up with every line, compressed or not
+    for (const auto &write : hal.influx_writes) {
+        result.raw_bytes += write.size();
+    }
+
+    // Airtime for the request bodies, which are the only thing compression changes, and the
+    // headers sent with them.  Each write's body size isn't kept, so the average is used.
+    double body_bytes = (double) result.wire_bytes / result.requests;
+    size_t frames = segments(BENCH_REQUEST_HEADER_BYTES + body_bytes);
+    for (int i = 0; i < 2; i++) {
+        double bits = (BENCH_REQUEST_HEADER_BYTES + body_bytes + frames * BENCH_FRAME_OVERHEAD_BYTES) * 8;
+        result.airtime_ms[i] = result.requests * (frames * LINKS[i].frame_us + bits / LINKS[i].mbps) / 1000;
+    }
+
+    // Time to compress one day's worth of bodies again, outside of the handler
+    GzipEncoder gzip(level ? level : 1);
+    static uint8_t out[INFLUX_BATCH_BYTES];
+    auto start = std::chrono::steady_clock::now();
+    for (const auto &write : hal.influx_writes) {
+        gzip.compress((const uint8_t *) write.data(), write.size(), out, sizeof(out));
+    }
+    auto end = std::chrono::steady_clock::now();
+    result.compress_us = level ? std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / 1000.0 / result.requests : 0;
+
+    delete influx;
+    return result;
+}
+
+int main() {
+    LOGGER = new Logger();
+    LOGGER->init(SYSLOG_SERVER, SYSLOG_PORT, HOSTNAME, APP_NAME);
+    LogQueue::add_sink([](uint8_t level, const char *message) {
+        if (level == LOG_LEVEL_ERROR) {
+            printf("%s\n", message);
+        }
+    });
+
+    BenchResult plain = run(0);
+    printf("%u collection periods, %zu requests, %llu bytes of line protocol\n\n", BENCH_PERIODS, plain.requests,
+           (unsigned long long) plain.raw_bytes);
+    printf("level  wire bytes  ratio  gzip  us/request  airtime %s  airtime %s\n", LINKS[0].name, LINKS[1].name);
+
+    for (uint8_t level = 0; level <= GZIP_MAX_LEVEL; level++) {
+        BenchResult result = level ? run(level) : plain;
+        if (result.raw_bytes != plain.raw_bytes) {
+            printf("Level %u: server got %llu bytes, expected %llu\n", level, (unsigned long long) result.raw_bytes,
+                   (unsigned long long) plain.raw_bytes);
+            return 1;
+        }
+
+        printf("%5u  %10llu  %5.2f  %4u  %10.1f  %8.0f ms (%3.0f%%)  %8.0f ms (%3.0f%%)\n", level,
+               (unsigned long long) result.wire_bytes, (double) result.wire_bytes / plain.wire_bytes, result.gzip_requests,
+               result.compress_us, result.airtime_ms[0], 100 * result.airtime_ms[0] / plain.airtime_ms[0],
+               result.airtime_ms[1], 100 * result.airtime_ms[1] / plain.airtime_ms[1]);
+    }
+    return 0;
+}
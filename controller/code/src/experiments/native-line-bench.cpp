@@ -0,0 +1,149 @@
+//----------------------------------------------------
+// Compares encoding a sensor reading as line protocol through Point + toLineProtocol() against
+// LineEncoder with a cached tag prefix, on the host.  Heap traffic is counted by replacing
+// operator new and delete.  The native Point is the stand-in from hal/NativeHal, which allocates
+// less than the real client library does, so the Point figures are a lower bound.
+//
+//   pio run -e native-line-bench && .pio/build/native-line-bench/program
+
+#include <Arduino.h>
+#include <monitor.h>
+#include <NativeHal.h>
+#include <AllocationCounter.h>
+#include <InfluxDbClient.h>
+#include <chrono>
+
+#include "Logger.h"
+#include "LineEncoder.h"
+
+#define BENCH_LINES 200000
+#define BENCH_TIMESTAMP 1750000000
+
+Logger *LOGGER = nullptr;
+
+static const char *SENSORS[] = {"DHT22", "TSL2591", "28FF641E8C160468", "28FF1A2B3C4D5E6F"};
+static const char *FIELDS[] = {"temperature", "humidity", "lux", "probe_temperature"};
+
+// Lines are copied here as a batch would be, and the batch emptied when full
+static char BATCH[4 * 1024];
+static size_t BATCH_LEN = 0;
+static size_t BATCH_BYTES = 0;
+
+static void to_batch(const char *line, size_t len) {
+    if (BATCH_LEN + len + 1 > sizeof(BATCH)) {
+        BATCH_LEN = 0;
+    }
+    memcpy(BATCH + BATCH_LEN, line, len);
+    BATCH_LEN += len;
+    BATCH[BATCH_LEN++] = '\n';
+    BATCH_BYTES += len + 1;
+}
+
+struct BenchResult {
+    double ns_per_line;
+    double allocations_per_line;
+    double bytes_per_line;
+};
+
+template <typename F>
+BenchResult run(F encode) {
+    size_t allocations = ALLOCATIONS;
+    size_t bytes = ALLOCATED_BYTES;
+    BATCH_LEN = 0;
+    BATCH_BYTES = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < BENCH_LINES; i++) {
+        encode(SENSORS[i % 4], FIELDS[i % 4], 60 + (i % 1000) / 37.0f);
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    return {ns / BENCH_LINES, (double) (ALLOCATIONS - allocations) / BENCH_LINES,
+            (double) (ALLOCATED_BYTES - bytes) / BENCH_LINES};
+}
+
+void report(const char *name, const BenchResult &result) {
+    printf("%-30s %8.1f ns %10.0f lines/s %8.2f allocations %8.1f bytes  (%zu bytes of lines)\n", name,
+           result.ns_per_line, 1e9 / result.ns_per_line, result.allocations_per_line, result.bytes_per_line,
+           BATCH_BYTES);
+}
+
+int main() {
+    NativeHal::reset();
+    NativeHal::set_echo(false, false);
+
+    LOGGER = new Logger();
+    LOGGER->init(SYSLOG_SERVER, SYSLOG_PORT, HOSTNAME, APP_NAME);
+
+    // Both encoders must produce the same bytes
+    for (int i = 0; i < 4; i++) {
+        Point point("weather");
+        point.addTag("device", HOSTNAME);
+        point.addTag("sensor_id", SENSORS[i]);
+        point.addField(FIELDS[i], -12.345f * i);
+        point.setTime(BENCH_TIMESTAMP);
+        String expected = point.toLineProtocol() + "\n";
+
+        char line[128];
+        LineEncoder encoder(line, sizeof(line));
+        encoder.begin("weather");
+        encoder.tag("device", HOSTNAME);
+        encoder.tag("sensor_id", SENSORS[i]);
+        encoder.field(FIELDS[i], -12.345f * i);
+        encoder.timestamp(BENCH_TIMESTAMP);
+        encoder.end();
+
+        if (expected != String(line).substring(0, encoder.length())) {
+            printf("Mismatch:\n  Point:       %s  LineEncoder: %.*s", expected.c_str(), (int) encoder.length(), line);
+            return 1;
+        }
+    }
+
+    printf("Per line, over %d lines:\n", BENCH_LINES);
+
+    report("Point + toLineProtocol()", run([](const char *sensor_id, const char *field, float value) {
+        Point point("weather");
+        point.addTag("device", HOSTNAME);
+        point.addTag("sensor_id", sensor_id);
+        point.addField(field, value);
+        point.setTime(BENCH_TIMESTAMP);
+        String line = point.toLineProtocol();
+        to_batch(line.c_str(), line.length());
+    }));
+
+    report("LineEncoder, escaping tags", run([](const char *sensor_id, const char *field, float value) {
+        if (BATCH_LEN + 128 > sizeof(BATCH)) {
+            BATCH_LEN = 0;
+        }
+        LineEncoder line(BATCH + BATCH_LEN, sizeof(BATCH) - BATCH_LEN);
+        line.begin("weather");
+        line.tag("device", HOSTNAME);
+        line.tag("sensor_id", sensor_id);
+        line.field(field, value);
+        line.timestamp(BENCH_TIMESTAMP);
+        if (line.end()) {
+            BATCH_LEN += line.length();
+            BATCH_BYTES += line.length();
+        }
+    }));
+
+    static LinePrefixCache prefixes("weather", HOSTNAME, "sensor_id");
+    report("LineEncoder, cached prefix", run([](const char *sensor_id, const char *field, float value) {
+        if (BATCH_LEN + 128 > sizeof(BATCH)) {
+            BATCH_LEN = 0;
+        }
+        const LinePrefix *prefix = prefixes.get(sensor_id);
+        LineEncoder line(BATCH + BATCH_LEN, sizeof(BATCH) - BATCH_LEN);
+        line.begin(prefix->prefix, prefix->length);
+        line.field(field, value);
+        line.timestamp(BENCH_TIMESTAMP);
+        if (line.end()) {
+            BATCH_LEN += line.length();
+            BATCH_BYTES += line.length();
+        }
+    }));
+
+    printf("Prefix cache: %u hits, %u misses\n", prefixes.hits(), prefixes.misses());
+    return 0;
+}
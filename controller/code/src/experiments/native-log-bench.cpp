@@ -0,0 +1,92 @@
+//----------------------------------------------------
+// Compares the cost of a log line built with String concatenation and sent through
+// LOGGER->log_info() against the same line through LogQueue's LOG_INFO(), on the host.  Heap
+// traffic is counted by replacing operator new and delete; times are host wall clock, so only
+// the ratio between the two means much for the ESP32.
+//
+//   pio run -e native-log-bench && .pio/build/native-log-bench/program
+
+#include <Arduino.h>
+#include <monitor.h>
+#include <NativeHal.h>
+#include <AllocationCounter.h>
+#include <chrono>
+
+#include "Logger.h"
+#include "LogQueue.h"
+
+#define BENCH_MESSAGES 200000
+
+Logger *LOGGER = nullptr;
+
+// Stands in for the sender; the lines go nowhere in either case
+static size_t SENT = 0;
+void count_sink(uint8_t level, const char *message) {
+    SENT++;
+}
+
+struct BenchResult {
+    double ns_per_message;
+    double allocations_per_message;
+    double bytes_per_message;
+};
+
+template <typename F>
+BenchResult run(F log_line) {
+    float temperature = 81.37;
+    float max_temp_f = 80;
+
+    size_t allocations = ALLOCATIONS;
+    size_t bytes = ALLOCATED_BYTES;
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < BENCH_MESSAGES; i++) {
+        log_line(temperature + (i % 100) / 100.0, max_temp_f);
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    return {ns / BENCH_MESSAGES, (double) (ALLOCATIONS - allocations) / BENCH_MESSAGES,
+            (double) (ALLOCATED_BYTES - bytes) / BENCH_MESSAGES};
+}
+
+void report(const char *name, const BenchResult &result) {
+    printf("%-34s %8.1f ns %8.2f allocations %8.1f bytes\n", name, result.ns_per_message,
+           result.allocations_per_message, result.bytes_per_message);
+}
+
+int main() {
+    NativeHal::reset();
+    // Neither path should pay for printing
+    NativeHal::set_echo(false, false);
+
+    LOGGER = new Logger();
+    LOGGER->init(SYSLOG_SERVER, SYSLOG_PORT, HOSTNAME, APP_NAME);
+    LogQueue::add_sink(count_sink);
+
+    printf("Per message, over %d messages:\n", BENCH_MESSAGES);
+
+    report("String + LOGGER->log_info()", run([](float temperature, float max_temp_f) {
+        LOGGER->log_info("Turning fan on (absolute): " + String(temperature) + "F >= " + String(max_temp_f) + "F");
+    }));
+
+    // Formatted and dispatched in place, as in setup() or the native builds
+    report("LOG_INFO(), direct to sinks", run([](float temperature, float max_temp_f) {
+        LOG_INFO("Turning fan on (absolute): %.2fF >= %.2fF", temperature, max_temp_f);
+    }));
+
+    // Queued for a sender that drains the queue whenever it fills, as the log task would
+    LogQueue::set_wake([]() {});
+    report("LOG_INFO(), queued + flushed", run([](float temperature, float max_temp_f) {
+        LOG_INFO("Turning fan on (absolute): %.2fF >= %.2fF", temperature, max_temp_f);
+        static int queued = 0;
+        if (++queued == LOG_QUEUE_DEPTH) {
+            LogQueue::flush();
+            queued = 0;
+        }
+    }));
+    LogQueue::flush();
+
+    printf("Sent %zu, %s\n", SENT, LogQueue::stats().c_str());
+    return 0;
+}
@@ -0,0 +1,130 @@
+//----------------------------------------------------
+// Compares what the control loop pays to read its settings on each tick: looking every value
+// up in the JSON document by String key, as ExternalSettings used to, against one copy of the
+// compiled Settings through ExternalSettings::current().  The copy is then timed again with
+// another thread reloading the settings as fast as it can, which is when the sequence counter
+// makes readers retry, and every copy is checked for a torn update.  Times are host wall clock,
+// so only the ratios mean much for the ESP32.
+//
+//   pio run -e native-settings-bench && .pio/build/native-settings-bench/program
+
+#include <Arduino.h>
+#include <monitor.h>
+#include <HTTPClient.h>
+#include <NativeHal.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "Logger.h"
+#include "LogQueue.h"
+#include "ExternalSettings.h"
+
+#define BENCH_TICKS 1000000
+
+Logger *LOGGER = nullptr;
+
+// The two documents the server alternates between.  Both keep min, target and max 10F apart, so
+// a copy mixing the two shows up.
+const char *SETTINGS_JSON[] = {
+    "{\"target_temp_f\": 72, \"max_temp_f\": 82, \"min_temp_f\": 62, "
+    "\"target_humidity\": 60, \"mist_on_s\": 30, \"mist_off_s\": 120}",
+    "{\"target_temp_f\": 68, \"max_temp_f\": 78, \"min_temp_f\": 58, "
+    "\"target_humidity\": 65, \"mist_on_s\": 20, \"mist_off_s\": 90}",
+};
+
+// Keeps the compiler from dropping reads whose results aren't otherwise used
+static volatile float SINK = 0;
+
+// A settings lookup as it was made before the document was compiled into a struct
+template <typename T>
+T lookup(JsonDocument &doc, const String &key, T default_value) {
+    if (doc.isNull() || doc[key].isNull()) {
+        return default_value;
+    }
+    return doc[key].as<T>();
+}
+
+template <typename F>
+double ns_per_tick(F tick) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < BENCH_TICKS; i++) {
+        tick();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return (double) std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / BENCH_TICKS;
+}
+
+void report(const char *name, double ns) {
+    printf("%-40s %8.1f ns\n", name, ns);
+}
+
+int main() {
+    NativeHal::reset();
+    NativeHal::set_echo(false, false);
+
+    // Every request gets the other document, so each fetch is a reload
+    static std::atomic<uint32_t> served{0};
+    NativeHal::set_http_handler([](const NativeHal::HttpRequest &request) {
+        uint32_t version = served++;
+        NativeHal::HttpResponse response;
+        response.code = HTTP_CODE_OK;
+        response.headers["ETag"] = "\"v" + std::to_string(version) + "\"";
+        response.body = SETTINGS_JSON[version % 2];
+        return response;
+    });
+
+    LOGGER = new Logger();
+    LOGGER->init(SYSLOG_SERVER, SYSLOG_PORT, HOSTNAME, APP_NAME);
+
+    ExternalSettings *settings = new ExternalSettings(SETTINGS_HOST, SETTINGS_PORT, SETTINGS_PATH);
+    settings->monitor();
+
+    JsonDocument doc;
+    String json = SETTINGS_JSON[0];
+    deserializeJson(doc, json);
+
+    printf("Per control tick, reading each setting once, over %d ticks:\n", BENCH_TICKS);
+
+    report("JSON lookups by String key", ns_per_tick([&doc]() {
+        SINK = lookup<float>(doc, "target_temp_f", DEFAULT_TARGET_TEMP_F) +
+               lookup<float>(doc, "max_temp_f", DEFAULT_MAX_TEMP_F) +
+               lookup<float>(doc, "min_temp_f", DEFAULT_MIN_TEMP_F) +
+               lookup<int>(doc, "temp_long_detla_s", DEFAULT_TEMP_LONG_DETLA_S) +
+               lookup<int>(doc, "temp_short_detla_s", DEFAULT_TEMP_SHORT_DETLA_S) +
+               lookup<float>(doc, "target_humidity", DEFAULT_TARGET_HUMIDITY) +
+               lookup<int>(doc, "mist_on_s", DEFAULT_MIST_ON_S) * 1000 +
+               lookup<int>(doc, "mist_off_s", DEFAULT_MIST_OFF_S) * 1000;
+    }));
+
+    auto read_settings = [settings]() {
+        Settings config = settings->current();
+        SINK = config.target_temp_f + config.max_temp_f + config.min_temp_f +
+               config.temp_long_delta_s + config.temp_short_delta_s + config.target_humidity +
+               config.mist_on_ms + config.mist_off_ms;
+    };
+    report("Settings copy, idle", ns_per_tick(read_settings));
+
+    // Reload continuously from another thread while the copies are timed
+    std::atomic<bool> stop{false};
+    uint32_t served_before = served;
+    std::thread writer([settings, &stop]() {
+        while (!stop.load()) {
+            settings->monitor();
+        }
+    });
+
+    uint32_t torn = 0;
+    report("Settings copy, reloading meanwhile", ns_per_tick([settings, &torn]() {
+        Settings config = settings->current();
+        if (config.max_temp_f - config.target_temp_f != 10 || config.target_temp_f - config.min_temp_f != 10) {
+            torn++;
+        }
+    }));
+
+    stop = true;
+    writer.join();
+
+    printf("%u reloads during the run, %u torn copies\n", served - served_before, torn);
+    return torn ? 1 : 0;
+}
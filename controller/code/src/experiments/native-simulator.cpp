@@ -0,0 +1,164 @@
+//----------------------------------------------------
+// Runs ClimateControl against the GreenhouseSim model under the virtual clock, then reports how
+// often the actuators cycled and how long the greenhouse spent out of band.  Policy settings are
+// served to ExternalSettings the same way the settings server does, so changes can be compared
+// without touching the real greenhouse:
+//
+//   pio run -e native-simulator
+//   .pio/build/native-simulator/program --days 7 --short-delta 300
+//   .pio/build/native-simulator/program --days 7 --short-delta 600 --max 85
+
+#include <Arduino.h>
+#include <monitor.h>
+#include <getopt.h>
+#include <HTTPClient.h>
+#include <NativeHal.h>
+
+#include "Logger.h"
+#include "LogQueue.h"
+#include "ClimateControl.h"
+#include "ExternalSettings.h"
+#include "GreenhouseSim.h"
+
+// Time that passes between passes through the loop
+#define SIM_LOOP_STEP_MS 100
+
+Logger *LOGGER = nullptr;
+
+void usage() {
+    printf("usage: program [options]\n"
+           "  --days N            simulated days to run (7)\n"
+           "  --target F          target_temp_f\n"
+           "  --max F             max_temp_f\n"
+           "  --min F             min_temp_f\n"
+           "  --short-delta S     temp_short_detla_s\n"
+           "  --long-delta S      temp_long_detla_s\n"
+           "  --humidity H        target_humidity\n"
+           "  --mist-on S         mist_on_s\n"
+           "  --mist-off S        mist_off_s\n"
+           "  --outside C         mean outside temperature\n"
+           "  --cloudiness X      0 (clear) to 1 (overcast)\n"
+           "  --seed N            weather seed\n"
+           "  --verbose           show the controller's log\n");
+}
+
+int main(int argc, char **argv) {
+    Settings settings = Settings::defaults();
+    SimWeather weather;
+    float days = 7;
+    bool verbose = false;
+
+    static struct option options[] = {
+        {"days", required_argument, nullptr, 'd'},
+        {"target", required_argument, nullptr, 't'},
+        {"max", required_argument, nullptr, 'x'},
+        {"min", required_argument, nullptr, 'n'},
+        {"short-delta", required_argument, nullptr, 's'},
+        {"long-delta", required_argument, nullptr, 'l'},
+        {"humidity", required_argument, nullptr, 'h'},
+        {"mist-on", required_argument, nullptr, 'm'},
+        {"mist-off", required_argument, nullptr, 'f'},
+        {"outside", required_argument, nullptr, 'o'},
+        {"cloudiness", required_argument, nullptr, 'c'},
+        {"seed", required_argument, nullptr, 'r'},
+        {"verbose", no_argument, nullptr, 'v'},
+        {nullptr, 0, nullptr, 0},
+    };
+
+    int option;
+    while ((option = getopt_long(argc, argv, "", options, nullptr)) != -1) {
+        switch (option) {
+            case 'd': days = atof(optarg); break;
+            case 't': settings.target_temp_f = atof(optarg); break;
+            case 'x': settings.max_temp_f = atof(optarg); break;
+            case 'n': settings.min_temp_f = atof(optarg); break;
+            case 's': settings.temp_short_delta_s = atoi(optarg); break;
+            case 'l': settings.temp_long_delta_s = atoi(optarg); break;
+            case 'h': settings.target_humidity = atof(optarg); break;
+            case 'm': settings.mist_on_s = atoi(optarg); break;
+            case 'f': settings.mist_off_s = atoi(optarg); break;
+            case 'o': weather.outside_mean_c = atof(optarg); break;
+            case 'c': weather.cloudiness = atof(optarg); break;
+            case 'r': weather.seed = atoi(optarg); break;
+            case 'v': verbose = true; break;
+            default: usage(); return 1;
+        }
+    }
+
+    const char *problem = settings.validate();
+    if (problem) {
+        printf("Invalid settings: %s\n", problem);
+        return 1;
+    }
+
+    NativeHal::reset();
+    NativeHal::set_echo(false, verbose);
+
+    char settings_json[512];
+    snprintf(settings_json, sizeof(settings_json),
+             "{\"target_temp_f\": %g, \"max_temp_f\": %g, \"min_temp_f\": %g, "
+             "\"temp_short_detla_s\": %d, \"temp_long_detla_s\": %d, "
+             "\"target_humidity\": %g, \"mist_on_s\": %d, \"mist_off_s\": %d}",
+             settings.target_temp_f, settings.max_temp_f, settings.min_temp_f,
+             (int) settings.temp_short_delta_s, (int) settings.temp_long_delta_s,
+             settings.target_humidity, (int) settings.mist_on_s, (int) settings.mist_off_s);
+    std::string settings_body = settings_json;
+
+    NativeHal::set_http_handler([&settings_body](const NativeHal::HttpRequest &request) {
+        NativeHal::HttpResponse response;
+        response.code = HTTP_CODE_OK;
+        response.headers["ETag"] = "\"sim\"";
+        response.body = settings_body;
+        return response;
+    });
+
+    const uint8_t probe[8] = {0x28, 0x53, 0x49, 0x4d, 0x00, 0x00, 0x00, 0x01};
+    NativeHal::add_onewire_device(probe, 20);
+
+    // Start at midnight
+    NativeHal::set_millis(0);
+    GreenhouseSim sim(SimParams(), weather, {FAN_CONTROL_PIN, WINDOW_OPEN_PIN, WINDOW_CLOSE_PIN, MIST_CONTROL_PIN});
+    sim.set_band(settings.target_temp_f, settings.min_temp_f, settings.max_temp_f, settings.target_humidity);
+
+    LOGGER = new Logger();
+    LOGGER->init(SYSLOG_SERVER, SYSLOG_PORT, HOSTNAME, APP_NAME);
+    // There's no log task here, so LogQueue hands each message straight to this
+    LogQueue::add_sink([](uint8_t level, const char *message) {
+        level == LOG_LEVEL_ERROR ? LOGGER->log_error(message) : LOGGER->log_info(message);
+    });
+
+    ExternalSettings *external = new ExternalSettings(SETTINGS_HOST, SETTINGS_PORT, SETTINGS_PATH);
+    external->monitor();
+
+    ControlObjects *controls = new ControlObjects();
+    controls->fan = new FanControl(FAN_CONTROL_PIN);
+    controls->window = new WindowControl(WINDOW_OPEN_PIN, WINDOW_CLOSE_PIN);
+    controls->mist = new MistControl(MIST_CONTROL_PIN);
+
+    SensorObjects *sensors = new SensorObjects();
+    sensors->temphumid = new TempHumiditySensor(DT22_PIN);
+    sensors->temp = new SensorHandler();
+    sensors->light = new LightSensor();
+
+    ClimateControl *climate = new ClimateControl(external, sensors, controls);
+
+    uint64_t end_us = NativeHal::now_us() + (uint64_t) (days * 24 * 3600) * 1000000;
+    uint64_t last_monitor_ms = uptime_ms();
+
+    while (NativeHal::now_us() < end_us) {
+        sim.update();
+
+        if (uptime_ms() - last_monitor_ms >= MONITOR_PERIOD_MS) {
+            climate->monitor();
+            last_monitor_ms = uptime_ms();
+        }
+
+        climate->poll_sensors();
+
+        delay(SIM_LOOP_STEP_MS);
+    }
+
+    printf("settings: %s\n", settings_json);
+    printf("%s", sim.report().c_str());
+    return 0;
+}
@@ -0,0 +1,150 @@
+//----------------------------------------------------
+// Runs the climate control with INFLUX_UDP's fast samples on the host: the DHT22 and light
+// sensor are reported every FAST_SAMPLE_PERIOD_MS and sent over UDP, while events still go
+// through the fake InfluxDB's HTTP API.  Some datagrams are lost on the way, and the program
+// then does what the receiver would, working out the loss from the packets' sequence lines.
+//
+//   pio run -e native-udp && .pio/build/native-udp/program
+
+#include <Arduino.h>
+#include <monitor.h>
+#include <HTTPClient.h>
+#include <NativeHal.h>
+
+#include "Logger.h"
+#include "LogQueue.h"
+#include "ClimateControl.h"
+#include "ExternalSettings.h"
+#include "InfluxDBHandler.h"
+
+#define NATIVE_RUN_HOURS 2
+#define NATIVE_LOOP_STEP_MS 100
+
+// One datagram in this many goes missing
+#define NATIVE_UDP_DROP_EVERY 25
+
+Logger *LOGGER = nullptr;
+
+const char *SETTINGS_JSON = "{\"target_temp_f\": 72, \"max_temp_f\": 82, \"min_temp_f\": 62, "
+                            "\"target_humidity\": 60, \"mist_on_s\": 30, \"mist_off_s\": 120}";
+
+// Warms 20F and back over the run, so the fan and window come on and off again
+float greenhouse_temp_c(unsigned long elapsed_s) {
+    float half = NATIVE_RUN_HOURS * 3600 / 2.0;
+    float progress = elapsed_s < half ? elapsed_s / half : 2 - elapsed_s / half;
+    return (64 + 20 * progress - 32) / 1.8;
+}
+
+static size_t count_lines(const std::string &text, const char *prefix) {
+    size_t count = 0;
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find('\n', start);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        if (text.compare(start, strlen(prefix), prefix) == 0) {
+            count++;
+        }
+        start = end + 1;
+    }
+    return count;
+}
+
+int main() {
+    NativeHal::reset();
+    NativeHal::set_echo(false, false);
+    NativeHal::set_udp_drop_every(NATIVE_UDP_DROP_EVERY);
+
+    NativeHal::set_http_handler([](const NativeHal::HttpRequest &request) {
+        NativeHal::HttpResponse response;
+        response.code = HTTP_CODE_OK;
+        response.body = SETTINGS_JSON;
+        return response;
+    });
+    NativeHal::set_light(1200, 300);
+
+    LOGGER = new Logger();
+    LOGGER->init(SYSLOG_SERVER, SYSLOG_PORT, HOSTNAME, APP_NAME);
+    LogQueue::add_sink([](uint8_t level, const char *message) {
+        printf("%s\n", message);
+    });
+
+    ExternalSettings *settings = new ExternalSettings(SETTINGS_HOST, SETTINGS_PORT, SETTINGS_PATH);
+    settings->monitor();
+
+    ControlObjects *controls = new ControlObjects();
+    controls->fan = new FanControl(FAN_CONTROL_PIN);
+    controls->window = new WindowControl(WINDOW_OPEN_PIN, WINDOW_CLOSE_PIN);
+    controls->mist = new MistControl(MIST_CONTROL_PIN);
+
+    SensorObjects *sensors = new SensorObjects();
+    sensors->temphumid = new TempHumiditySensor(DT22_PIN);
+    sensors->temp = new SensorHandler();
+    sensors->light = new LightSensor();
+
+    ClimateControl *climate = new ClimateControl(settings, sensors, controls);
+    InfluxDBHandler *influx = new InfluxDBHandler(INFLUXDB_URL, INFLUXDB_DB, DEVICE);
+    influx->enable_udp(INFLUXDB_UDP_PORT);
+    climate->enable_influx_collection(influx);
+
+    uint64_t start_ms = uptime_ms();
+    uint64_t last_collection_ms = start_ms - COLLECTION_PERIOD_MS;
+    uint64_t last_monitor_ms = start_ms - MONITOR_PERIOD_MS;
+    uint64_t last_sample_ms = start_ms;
+
+    // The loop and the network task's work, done in line as in native-climate
+    while (uptime_ms() - start_ms < NATIVE_RUN_HOURS * 3600UL * 1000) {
+        NativeHal::set_dht(greenhouse_temp_c((uptime_ms() - start_ms) / 1000), 65);
+
+        if (uptime_ms() - last_collection_ms >= COLLECTION_PERIOD_MS) {
+            climate->report_metrics();
+            influx->flush();
+            last_collection_ms = uptime_ms();
+        } else if (uptime_ms() - last_sample_ms >= FAST_SAMPLE_PERIOD_MS) {
+            climate->report_fast_metrics();
+            influx->send_samples();
+            last_sample_ms = uptime_ms();
+        }
+
+        if (uptime_ms() - last_monitor_ms >= MONITOR_PERIOD_MS) {
+            climate->monitor();
+            last_monitor_ms = uptime_ms();
+        }
+        climate->poll_sensors();
+        delay(NATIVE_LOOP_STEP_MS);
+    }
+    influx->flush();
+
+    // The receiver's side: the sequence line ends each packet
+    const NativeHal::State &hal = NativeHal::state();
+    uint32_t max_sequence = 0;
+    size_t weather_lines = 0;
+    size_t largest = 0;
+    for (const auto &packet : hal.udp_packets) {
+        size_t at = packet.body.rfind("sequence=");
+        uint32_t sequence = at == std::string::npos ? 0 : strtoul(packet.body.c_str() + at + 9, nullptr, 10);
+        max_sequence = std::max(max_sequence, sequence);
+        weather_lines += count_lines(packet.body, "weather,");
+        largest = std::max(largest, packet.body.size());
+    }
+
+    size_t http_weather = 0;
+    size_t http_events = 0;
+    for (const auto &write : hal.influx_writes) {
+        http_weather += count_lines(write, "weather,");
+        http_events += count_lines(write, "events,");
+    }
+
+    printf("UDP: %zu of %u packets received, loss %.1f%% (sent %u), %zu weather lines, largest %zu bytes\n",
+           hal.udp_packets.size(), max_sequence, 100.0 * (max_sequence - hal.udp_packets.size()) / max_sequence,
+           hal.udp_sent, weather_lines, largest);
+    printf("HTTP: %zu requests, %zu events, %zu weather lines\n", hal.influx_writes.size(), http_events, http_weather);
+    printf("InfluxDB writer: %s\n", influx->stats().c_str());
+
+    if (http_weather > 0 || http_events == 0 || largest > UDP_PACKET_BYTES) {
+        printf("Expected events only over HTTP, and packets of at most %d bytes\n", UDP_PACKET_BYTES);
+        return 1;
+    }
+    return 0;
+}
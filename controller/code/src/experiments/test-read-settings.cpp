@@ -12,9 +12,17 @@
 #include "Logger.h"
 #include "ExternalSettings.h"
 
+// Override these in platformio.ini to point at a local stand-in server, e.g. a
+// `python3 -m http.server` serving a settings.json, to watch the 200/304 behaviour
+#ifndef SETTINGS_HOST
 #define SETTINGS_HOST "tigerbackup.local"
+#endif
+#ifndef SETTINGS_PORT
 #define SETTINGS_PORT 80
+#endif
+#ifndef SETTINGS_PATH
 #define SETTINGS_PATH "/greenhouse/settings.json"
+#endif
 #define SETTINGS_URL String(SETTINGS_HOST) + String(SETTINGS_PATH)
 
 //----------------------------------------------------
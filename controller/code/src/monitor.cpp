@@ -8,16 +8,26 @@
 #include <time.h>
 #include <string>
 #include <WebSerial.h>
+#include <LittleFS.h>
 #include <esp_task_wdt.h>
 #include "esp_system.h"
 
 #include <Logger.h>
-
+#include "LogQueue.h"
+
+#include "Clock.h"
+#include "Scheduler.h"
+#include "LatencyHistogram.h"
+#include "PowerManager.h"
+#include "HeapMonitor.h"
+#include "HostResolver.h"
 #include "ClimateControl.h"
 #include "WirelessControl.h"
 #include "AdminAccess.h"
 #include "TimeHandler.h"
 #include "InfluxDBHandler.h"
+#include "MetricStore.h"
+#include "MetricsExporter.h"
 #include "Telemetry.h"
 #include "ExternalSettings.h"
 
@@ -35,92 +45,424 @@ InfluxDBHandler *INFLUX = nullptr;
 Telemetry *TELEMETRY = nullptr;
 Logger *LOGGER = nullptr;
 ExternalSettings *SETTINGS = nullptr;
-
-long last_heartbeat_ms = millis();
+MetricStore *HISTORY = nullptr;
+MetricsExporter *METRICS = nullptr;
+
+Scheduler *SCHEDULER = new Scheduler();
+PowerManager *POWER = new PowerManager();
+HeapMonitor *HEAP = new HeapMonitor();
+HostResolver *RESOLVER = new HostResolver();
+int COLLECTION_JOB = -1;
+int WINDOW_STOP_JOB = -1;
+int SENSOR_POLL_JOB = -1;
+
+// Time spent in each subsystem, reported at each heartbeat and by the 'timing' admin command.
+// Each one is only written by the task that times into it; the heartbeat reports the difference
+// from the copy it kept last time.
+LatencyHistogram LOOP_LATENCY;
+LatencyHistogram WIFI_LATENCY;
+LatencyHistogram SETTINGS_LATENCY;
+LatencyHistogram FLUSH_LATENCY;
+LatencyHistogram REPORT_LATENCY;
+LatencyHistogram CLIMATE_LATENCY;
+LatencyHistogram ADMIN_LATENCY;
+
+#define LATENCY_PROBE_COUNT 7
+LatencyHistogram LATENCY_BASELINES[LATENCY_PROBE_COUNT];
+
+LatencyProbe LATENCY_PROBES[LATENCY_PROBE_COUNT] = {
+    {"loop", &LOOP_LATENCY, &LATENCY_BASELINES[0]},
+    {"wifi", &WIFI_LATENCY, &LATENCY_BASELINES[1]},
+    {"settings", &SETTINGS_LATENCY, &LATENCY_BASELINES[2]},
+    {"influx flush", &FLUSH_LATENCY, &LATENCY_BASELINES[3]},
+    {"report metrics", &REPORT_LATENCY, &LATENCY_BASELINES[4]},
+    {"climate", &CLIMATE_LATENCY, &LATENCY_BASELINES[5]},
+    {"admin", &ADMIN_LATENCY, &LATENCY_BASELINES[6]},
+};
+
+TaskHandle_t NETWORK_TASK = nullptr;
+TaskHandle_t LOG_TASK = nullptr;
+
+// What the network task is woken to send
+#define NETWORK_COLLECTION_READY (1 << 0)
+#define NETWORK_SAMPLES_READY (1 << 1)
 
 //----------------------------------------------------
 // Functions
 
+// Where LogQueue sends messages; see start_log_task()
+void log_to_serial(uint8_t level, const char *message) {
+    Serial.println(message);
+}
+
+// Syslog sends through one UDP socket inside LOGGER, so only one task may use it at a time.  The
+// log task holds this while sending, and the network task while WirelessControl and telemetry
+// run; see network_task().
+std::mutex SYSLOG_LOCK;
+
+void log_to_syslog(uint8_t level, const char *message) {
+    std::lock_guard<std::mutex> lock(SYSLOG_LOCK);
+    switch (level) {
+        case LOG_LEVEL_ERROR:
+            LOGGER->log_error(message);
+            break;
+        case LOG_LEVEL_WARNING:
+            LOGGER->log_warning(message);
+            break;
+        case LOG_LEVEL_DEBUG:
+            LOGGER->log_debug(message);
+            break;
+        default:
+            LOGGER->log_info(message);
+    }
+}
+
+void log_to_webserial(uint8_t level, const char *message) {
+    WebSerial.println(message);
+}
+
 void register_admin_commands() {
     ADMIN->register_command("status", []() { ADMIN->print_status(); } );
     ADMIN->register_command("delta", []() { ADMIN->print_delta(); } );
+    ADMIN->register_command("latency", []() { ADMIN->print_sensor_latency(); } );
+    ADMIN->register_command("jobs", []() { ADMIN->print_jobs(SCHEDULER); } );
+    ADMIN->register_command("timing", []() { ADMIN->print_timing(LATENCY_PROBES, LATENCY_PROBE_COUNT); } );
+    ADMIN->register_command("history", []() { ADMIN->print_history(HISTORY); } );
+    ADMIN->register_command("heap", []() { ADMIN->print_heap(HEAP); } );
     ADMIN->register_command("fan on", []() { CONTROLS->fan->turn_on(); } );
     ADMIN->register_command("fan off", []() { CONTROLS->fan->turn_off(); } );
     ADMIN->register_command("open", []() { CONTROLS->window->open(); } );
     ADMIN->register_command("close", []() { CONTROLS->window->close(); } );
     ADMIN->register_command("enable logging", []() { CLIMATE->enable_influx_collection(INFLUX); });
     ADMIN->register_command("disable logging", []() { CLIMATE->disable_influx_collection(); });
+    ADMIN->register_command("enable compression", []() { if (INFLUX) INFLUX->set_compression_level(INFLUX_GZIP_LEVEL ? INFLUX_GZIP_LEVEL : GZIP_DEFAULT_LEVEL); });
+    ADMIN->register_command("disable compression", []() { if (INFLUX) INFLUX->set_compression_level(0); });
+    ADMIN->register_command("enable telemetry", []() { TELEMETRY->enable(); });
+    ADMIN->register_command("disable telemetry", []() { TELEMETRY->disable(); });
     ADMIN->register_command("help", []() { ADMIN->print_help(); });
 }
 
+// Values from outside the climate control to serve at /metrics, on top of what MetricsExporter reads itself
+void register_metrics() {
+    METRICS->set_probes(LATENCY_PROBES, LATENCY_PROBE_COUNT);
+    METRICS->add_gauge("loop_duty_cycle_ratio", "Share of the last collection period the loop task spent awake; other tasks aren't counted", []() { return POWER->duty_cycle(); });
+    METRICS->add_gauge("cpu_mhz", "CPU frequency while the loop is busy", []() { return POWER->active_mhz(); });
+    METRICS->add_counter("http_requests_total", "HTTP requests made for settings and metrics", []() {
+        return SETTINGS->connection().requests() + (INFLUX ? INFLUX->connection().requests() : 0);
+    });
+    METRICS->add_counter("http_reused_total", "HTTP requests sent on an already open connection", []() {
+        return SETTINGS->connection().reuses() + (INFLUX ? INFLUX->connection().reuses() : 0);
+    });
+    METRICS->add_counter("http_connects_total", "HTTP connections opened", []() {
+        return SETTINGS->connection().connects() + (INFLUX ? INFLUX->connection().connects() : 0);
+    });
+    if (COUNT_ALLOCATIONS) {
+        METRICS->add_counter("allocations_total", "Heap allocations made by any task", []() { return (double) HeapMonitor::allocations(); });
+    }
+}
+
 void check_for_reset() {
     esp_reset_reason_t reason = esp_reset_reason();
 
     // Log the reset reason, or nothing if no reset was detected
     switch(reason) {
         case ESP_RST_UNKNOWN:
-            LOGGER->log_error("Reset reason: Unknown");
+            LOG_ERROR("Reset reason: Unknown");
             break;
         case ESP_RST_POWERON:
-            LOGGER->log_error("Reset reason: Power on");
+            LOG_ERROR("Reset reason: Power on");
             break;
         case ESP_RST_EXT:
-            LOGGER->log_error("Reset reason: External pin");
+            LOG_ERROR("Reset reason: External pin");
             break;
         case ESP_RST_SW:    
-            LOGGER->log_error("Reset reason: Software reset");
+            LOG_ERROR("Reset reason: Software reset");
             break;
         case ESP_RST_PANIC:
-            LOGGER->log_error("Reset reason: Panic");
+            LOG_ERROR("Reset reason: Panic");
             break;
         case ESP_RST_INT_WDT:
-            LOGGER->log_error("Reset reason: Interrupt watchdog");
+            LOG_ERROR("Reset reason: Interrupt watchdog");
             break;
         case ESP_RST_TASK_WDT:
-            LOGGER->log_error("Reset reason: Task watchdog");
+            LOG_ERROR("Reset reason: Task watchdog");
             break;
         case ESP_RST_WDT:
-            LOGGER->log_error("Reset reason: Other watchdog");
+            LOG_ERROR("Reset reason: Other watchdog");
             break;
         case ESP_RST_DEEPSLEEP:
-            LOGGER->log_error("Reset reason: Deep sleep");
+            LOG_ERROR("Reset reason: Deep sleep");
             break;
         case ESP_RST_BROWNOUT:
-            LOGGER->log_error("Reset reason: Brownout");
+            LOG_ERROR("Reset reason: Brownout");
             break;
         case ESP_RST_SDIO:
-            LOGGER->log_error("Reset reason: SDIO");
+            LOG_ERROR("Reset reason: SDIO");
             break;
     }
 }
 
-uint32_t loop_time_buckets[WDT_TIMEOUT_S];
-void clear_loop_buckets() {
-    for (int i = 0; i < WDT_TIMEOUT_S; i++) {
-        loop_time_buckets[i] = 0;
+// Record a new reading, then hand off to the network task to send it
+void collect_metrics() {
+    {
+        ScopedLatency timer(REPORT_LATENCY);
+        CLIMATE->report_metrics();
     }
-}   
+
+    // How much of the last collection period the loop spent awake
+    if (INFLUX) {
+        INFLUX->write_sensor_metric("controller", "loop_duty_cycle", POWER->duty_cycle() * 100);
+
+        // Running totals of HTTP requests and how many went out on an already open connection
+        const HttpConnection &settings = SETTINGS->connection();
+        const HttpConnection &influx = INFLUX->connection();
+        INFLUX->write_sensor_metric("controller", "http_requests", settings.requests() + influx.requests());
+        INFLUX->write_sensor_metric("controller", "http_reused", settings.reuses() + influx.reuses());
+    }
+    POWER->reset_stats();
+    xTaskNotify(NETWORK_TASK, NETWORK_COLLECTION_READY, eSetBits);
+}
+
+// Record the fast changing readings between collections, for the network task to send over UDP
+void sample_fast() {
+    CLIMATE->report_fast_metrics();
+    xTaskNotify(NETWORK_TASK, NETWORK_SAMPLES_READY, eSetBits);
+}
+
+// The window motor runs for a fixed time; stop it when that time is up rather than on the next climate tick
+void schedule_window_stop() {
+    if (CONTROLS->window->is_moving()) {
+        SCHEDULER->reschedule(WINDOW_STOP_JOB, CONTROLS->window->ms_until_stopped());
+    }
+}
+
+// Make decisions on fan and window control based on current temperature and humidity
+void climate_tick() {
+    {
+        ScopedLatency timer(CLIMATE_LATENCY);
+        CLIMATE->monitor();
+    }
+    schedule_window_stop();
+}
+
+void admin_poll() {
+    {
+        ScopedLatency timer(ADMIN_LATENCY);
+        ADMIN->handle_commands();
+    }
+
+    // The open and close commands start the window moving too
+    schedule_window_stop();
+}
+
+// Log one of the heartbeat's stats lines, which can run past LOG_MESSAGE_BYTES, split between
+// words over as many messages as it takes
+void log_stats(const char *label, const String &stats) {
+    // Room for the label and the ": " or " ...: " in front
+    const size_t room = LOG_MESSAGE_BYTES - strlen(label) - 8;
+    const char *text = stats.c_str();
+    bool first = true;
+
+    while (*text) {
+        size_t len = strlen(text);
+        if (len > room) {
+            len = room;
+            while (len > 0 && text[len] != ' ') {
+                len--;
+            }
+            if (len == 0) {
+                len = room;
+            }
+        }
+        LOG_DEBUG("%s%s: %.*s", label, first ? "" : " ...", (int) len, text);
+        first = false;
+
+        text += len;
+        while (*text == ' ') {
+            text++;
+        }
+    }
+}
+
+void heartbeat() {
+    // Report each period on its own.  The histograms belong to the tasks timing into them and
+    // are exported as counters, so rather than resetting them, keep a copy to measure the next
+    // period from.
+    for (auto &probe : LATENCY_PROBES) {
+        LatencyHistogram current = *probe.histogram;
+        log_stats((String("Timing ") + probe.name).c_str(), current.since(*probe.baseline).summary());
+        *probe.baseline = current;
+    }
+
+    log_stats("Scheduler jobs", SCHEDULER->stats());
+    SCHEDULER->reset_stats();
+
+    if (INFLUX) {
+        log_stats("InfluxDB writer", INFLUX->stats());
+        log_stats("InfluxDB connection", INFLUX->connection().stats());
+    }
+    log_stats("Settings connection", SETTINGS->connection().stats());
+
+    if (HISTORY) {
+        log_stats("History", HISTORY->stats());
+    }
+
+    if (METRICS) {
+        log_stats("Metrics endpoint", METRICS->stats());
+    }
+
+    log_stats("Heap", HEAP->stats());
+    HEAP->reset_stats();
+
+    log_stats("Log queue", LogQueue::stats());
+    log_stats("Power", POWER->stats());
+    log_stats("Resolver", RESOLVER->stats());
+
+    LOG_INFO("Greenhouse monitor running: last collection=%ldms late", long(SCHEDULER->job(COLLECTION_JOB).last_late_ms));
+}
+
+void schedule_jobs() {
+    // Make sure we start with an immediate reading
+    COLLECTION_JOB = SCHEDULER->every("collect", COLLECTION_PERIOD_MS, collect_metrics);
+    SCHEDULER->every("climate", MONITOR_PERIOD_MS, climate_tick);
+    if (INFLUX_UDP && INFLUX) {
+        SCHEDULER->every("fast sample", FAST_SAMPLE_PERIOD_MS, sample_fast, FAST_SAMPLE_PERIOD_MS);
+    }
+
+    // Pick up the slower sensors when their conversions should be done.  Armed by the
+    // acquisition each time it starts, so the loop isn't woken to look in between.
+    SENSOR_POLL_JOB = SCHEDULER->after("sensors", 0, []() { CLIMATE->poll_sensors(); });
+    CLIMATE->set_sensor_poll_timer([](uint32_t delay_ms) { SCHEDULER->reschedule(SENSOR_POLL_JOB, delay_ms); });
+
+    // Check for webserial commands
+    SCHEDULER->every("admin", ADMIN_POLL_PERIOD_MS, admin_poll);
+    SCHEDULER->every("heartbeat", HEARTBEAT_PERIOD_MS, heartbeat, HEARTBEAT_PERIOD_MS);
+
+    // Armed by schedule_window_stop() whenever the window starts moving
+    WINDOW_STOP_JOB = SCHEDULER->after("window", WINDOW_MOVE_TIME_MS, []() { CONTROLS->window->monitor(); });
+}
+
+// All network I/O runs here so a slow or unreachable server can't hold up the control loop.
+// The control task records metrics into INFLUX's queue and wakes this task once per collection
+// period, and with INFLUX_UDP after each fast sample; settings are published back through
+// ExternalSettings.
+//
+// Each step can block on a slow server for seconds, so the watchdog is fed between them, and by
+// INFLUX between requests, rather than once per pass.
+void network_task(void *params) {
+    esp_task_wdt_add(NULL);
+
+    while (true) {
+        // Wake when the control loop has recorded a collection, or check the WiFi once in a while regardless
+        uint32_t ready = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &ready, pdMS_TO_TICKS(NETWORK_IDLE_PERIOD_MS));
+        bool collection_ready = ready & NETWORK_COLLECTION_READY;
+
+        // Make sure we still have a wifi connection.  WirelessControl comes from embedded-shared and
+        // logs through LOGGER, so it shares the syslog socket like telemetry below.
+        {
+            ScopedLatency timer(WIFI_LATENCY);
+            std::lock_guard<std::mutex> lock(SYSLOG_LOCK);
+            WirelessControl::monitor();
+        }
+
+        // Look up any cached names about to expire, so the requests below don't wait on DNS/mDNS
+        RESOLVER->refresh();
+        esp_task_wdt_reset();
+
+        if (collection_ready) {
+            // Check and load new settings if they've changed
+            {
+                ScopedLatency timer(SETTINGS_LATENCY);
+                SETTINGS->monitor();
+            }
+            esp_task_wdt_reset();
+
+            // Send readings and events recorded since the last collection, and any backlog
+            if (INFLUX) {
+                ScopedLatency timer(FLUSH_LATENCY);
+                INFLUX->flush();
+            }
+            esp_task_wdt_reset();
+
+            // Compress this collection into the on-device history
+            if (HISTORY) {
+                HISTORY->flush();
+            }
+
+            // Report back the state of our host device.  Telemetry comes from embedded-shared and
+            // may log through LOGGER itself rather than LogQueue, so it shares the syslog socket.
+            // The lock is held through its HTTP write, and through any WiFi reconnect above, so
+            // the log task can't send until they finish, and anything past LOG_QUEUE_DEPTH
+            // messages logged meanwhile is dropped.
+            {
+                std::lock_guard<std::mutex> lock(SYSLOG_LOCK);
+                TELEMETRY->report_metrics();
+            }
+        } else if ((ready & NETWORK_SAMPLES_READY) && INFLUX) {
+            // Fire and forget over UDP; events wait for the next collection
+            INFLUX->send_samples();
+        }
+
+        esp_task_wdt_reset();
+    }
+}
+
+// Sends queued log messages to syslog, Serial and WebSerial, so logging never waits on the network
+void log_task(void *params) {
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        LogQueue::flush();
+    }
+}
+
+void start_log_task() {
+    xTaskCreatePinnedToCore(log_task, "log", LOG_TASK_STACK_BYTES, nullptr,
+                            LOG_TASK_PRIORITY, &LOG_TASK, NETWORK_TASK_CORE);
+
+    HEAP->watch_task("log", LOG_TASK);
+
+    // Anything logged from here on is queued for the log task
+    LogQueue::set_wake([]() { xTaskNotifyGive(LOG_TASK); });
+}
+
+void start_network_task() {
+    xTaskCreatePinnedToCore(network_task, "network", NETWORK_TASK_STACK_BYTES, nullptr,
+                            NETWORK_TASK_PRIORITY, &NETWORK_TASK, NETWORK_TASK_CORE);
+    HEAP->watch_task("network", NETWORK_TASK);
+}
 
 void setup() {
     // Start serial communication
     Serial.begin(SERIAL_SPEED);
 
+    // Watch the loop task's stack and allocations from the start
+    HEAP->begin();
+
 	// Initialize the logger so WirelessControl can use it, but LOGGER should not be used
 	// until after the init_wifi() returns
     LOGGER = new Logger();
     LOGGER->init(SYSLOG_SERVER, SYSLOG_PORT, HOSTNAME, APP_NAME);
 
+    LogQueue::add_sink(log_to_serial);
+    if (LOG_TO_SYSLOG) {
+        LogQueue::add_sink(log_to_syslog);
+    }
+
     WirelessControl::init_wifi(WIFI_SSID, WIFI_PASSWORD, HOSTNAME);
     // Give the WiFi time to connect
     delay(3000); 
 
     // See if there is a reset reason for the last restart
     check_for_reset();
-	LOGGER->log("Greenhouse monitor power cycled, starting up ...");
+	LOG_INFO("Greenhouse monitor power cycled, starting up ...");
 
     TimeHandler::init_ntp();
 
+    POWER->begin();
+
     SETTINGS = new ExternalSettings(SETTINGS_HOST, SETTINGS_PORT, SETTINGS_PATH);
+    SETTINGS->set_resolver(RESOLVER);
     SETTINGS->monitor();
 
     CONTROLS->fan = new FanControl(FAN_CONTROL_PIN);
@@ -133,13 +475,41 @@ void setup() {
 
     CLIMATE = new ClimateControl(SETTINGS, SENSORS, CONTROLS);
     ADMIN = new AdminAccess(SETTINGS, CONTROLS, SENSORS, CLIMATE);
+    LogQueue::add_sink(log_to_webserial);
     TELEMETRY = new Telemetry(INFLUXDB_URL, TELEMETRY_DB, HOSTNAME);
 
+    // Mount the flash filesystem once, for the metric backlog and history.  If it won't mount it
+    // is left alone rather than formatted, since the fault may pass and formatting would lose
+    // the history; both keep to RAM until the next restart.
+    bool fs_mounted = LittleFS.begin(false);
+    if (!fs_mounted) {
+        LOG_ERROR("Could not mount LittleFS, metric backlog and history are limited to RAM");
+    }
+
     if (LOG_TO_INFLUX) {
         INFLUX = new InfluxDBHandler(INFLUXDB_URL, INFLUXDB_DB, DEVICE);
+        INFLUX->enable_spill(fs_mounted);
+        INFLUX->set_resolver(RESOLVER);
+        INFLUX->set_compression_level(INFLUX_GZIP_LEVEL);
+        if (INFLUX_UDP) {
+            INFLUX->enable_udp(INFLUXDB_UDP_PORT);
+        }
         CLIMATE->enable_influx_collection(INFLUX);
     }
 
+    if (KEEP_HISTORY) {
+        HISTORY = new MetricStore();
+        HISTORY->begin(fs_mounted);
+        CLIMATE->enable_history(HISTORY);
+        ADMIN->serve_history(HISTORY);
+    }
+
+    if (SERVE_METRICS) {
+        METRICS = new MetricsExporter(CLIMATE, SENSORS, CONTROLS);
+        register_metrics();
+        ADMIN->serve_metrics(METRICS);
+    }
+
     if (LOG_TELEMETRY) {
         TELEMETRY->enable();
     } else {
@@ -148,62 +518,28 @@ void setup() {
 
     register_admin_commands();
 
-    clear_loop_buckets();
-
     // Initialize the Watchdog Timer
     esp_task_wdt_init(WDT_TIMEOUT_S, true);
     // Add the current task to the Watchdog Timer, (the behavior when the task handler == NULL)
     esp_task_wdt_add(NULL);
-}
 
-// Make sure we start with an immediate reading
-unsigned long last_collection_ms = millis() - COLLECTION_PERIOD_MS;
-unsigned long last_monitor_ms = millis() - MONITOR_PERIOD_MS;
+    schedule_jobs();
+    start_log_task();
+    start_network_task();
+}
 
 void loop() {
-    unsigned long loop_start_ms = millis();
-
-    // Make sure we still have a wifi connection
-    WirelessControl::monitor();
+    uint32_t idle_ms;
 
-    // Determine when we're done waiting
-    if (millis() >= last_collection_ms + COLLECTION_PERIOD_MS) {
-        // Check and load new settings if they've changed
-        SETTINGS->monitor();
-
-        // Send a new reading to InfluxDB
-        CLIMATE->report_metrics();
-
-        // Report back the state of our host device
-        TELEMETRY->report_metrics();
-
-        last_collection_ms = millis();
-    }
-
-    if (millis() >= last_monitor_ms + MONITOR_PERIOD_MS) {
-        // Make decisions on fan and window control based on current temperature and humidity
-        CLIMATE->monitor();
-        last_monitor_ms = millis();
+    // Run whatever is due; everything the loop does is a job on SCHEDULER (see schedule_jobs())
+    {
+        ScopedLatency timer(LOOP_LATENCY);
+        idle_ms = SCHEDULER->run_due();
     }
-
-    // While we are between collection periods, check for webserial commands and monitor the window
-    ADMIN->handle_commands();
-
-	if (millis() > last_heartbeat_ms + HEARTBEAT_PERIOD_MS) {
-        String loop_time_buckets_str = "";
-        for (int i = 0; i < WDT_TIMEOUT_S; i++) {
-            loop_time_buckets_str += String(i) + ":" + String(loop_time_buckets[i]) + ", ";
-        }
-        LOGGER->log_debug("Loop time buckets: " + loop_time_buckets_str);
-        clear_loop_buckets();
-
-        float temp = temperatureRead();
-		LOGGER->log("Greenhouse monitor running: last collection=" + String(long(millis() - last_collection_ms)) + "ms");
-		last_heartbeat_ms = millis();
-	}
-
-    int loop_seconds = (millis() - loop_start_ms) / 1000;
-    loop_time_buckets[loop_seconds]++;
+    HEAP->end_loop();
 
     esp_task_wdt_reset();
+
+    // Sleep until the next deadline.  Only this task blocks, so the network task and WebSerial carry on meanwhile.
+    POWER->idle(std::min(idle_ms, (uint32_t) LOOP_MAX_SLEEP_MS));
 }
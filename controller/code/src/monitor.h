@@ -93,6 +93,32 @@ struct SensorObjects {
 #define LOG_TO_INFLUX true
 #endif
 
+// gzip level for InfluxDB writes, 1 (fastest) to 9 (smallest), or 0 to send plain line protocol.
+// Can be controlled via platformio.ini
+#ifndef INFLUX_GZIP_LEVEL
+#define INFLUX_GZIP_LEVEL 6
+#endif
+
+// Send sensor metrics to InfluxDB's UDP listener rather than POSTing them, and sample the DHT22
+// and light sensor every FAST_SAMPLE_PERIOD_MS in between collections.  Events are still
+// POSTed.  The listener needs setting up, see UdpLineSender.  Can be controlled via platformio.ini
+#ifndef INFLUX_UDP
+#define INFLUX_UDP false
+#endif
+#define INFLUXDB_UDP_PORT 8089
+#define FAST_SAMPLE_PERIOD_MS (5 * 1000)
+
+// Keep sensor history on flash, see MetricStore.  Can be controlled via platformio.ini
+#ifndef KEEP_HISTORY
+#define KEEP_HISTORY true
+#endif
+
+// Serve current readings at /metrics for a Prometheus style scraper.  With a scraper in place,
+// LOG_TO_INFLUX and LOG_TELEMETRY can be turned off so the controller doesn't push on a timer.
+#ifndef SERVE_METRICS
+#define SERVE_METRICS true
+#endif
+
 // Quickly enable/disable telemetry logging via syslog.  Can be controlled via platformio.ini
 #ifndef LOG_TELEMETRY
 #define LOG_TELEMETRY true
@@ -119,6 +145,12 @@ struct SensorObjects {
 #define MONITOR_PERIOD_S (1 * 5)
 #define MONITOR_PERIOD_MS (1000 * MONITOR_PERIOD_S)
 
+// How often to check for admin commands; they are typed by hand, so this can be slow
+#define ADMIN_POLL_PERIOD_MS 500
+
+// The loop sleeps until the next job is due, but wakes at least this often to feed the watchdog
+#define LOOP_MAX_SLEEP_MS 1000
+
 // Send a heartbeat every 10 minutes to the logger
 #define HEARTBEAT_PERIOD_S (10 * 60)
 #define HEARTBEAT_PERIOD_MS (1000 * HEARTBEAT_PERIOD_S)
@@ -126,4 +158,16 @@ struct SensorObjects {
 // Set a short watchdog timer
 #define WDT_TIMEOUT_S 15
 
+// The network task runs on the protocol core, leaving the Arduino loop's core to the controls.
+// Single core boards (e.g. the ESP32-C3) just share core 0.
+#define NETWORK_TASK_STACK_BYTES (8 * 1024)
+#define NETWORK_TASK_PRIORITY 1
+#define NETWORK_TASK_CORE 0
+// How often the network task wakes to check WiFi when it isn't sending a collection
+#define NETWORK_IDLE_PERIOD_MS (5 * 1000)
+
+// Sends queued log messages, on the network task's core; see LogQueue
+#define LOG_TASK_STACK_BYTES (4 * 1024)
+#define LOG_TASK_PRIORITY 1
+
 #endif
\ No newline at end of file